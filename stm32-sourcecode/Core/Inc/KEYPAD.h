@@ -16,6 +16,22 @@ void Keypad_Init(Keypad_HandleTypeDef* KEYPAD, char KEYMAP[NUMROWS][NUMCOLS],
 										GPIO_TypeDef* ROW3_PORT, uint32_t ROW3_PIN,
 										GPIO_TypeDef* ROW4_PORT, uint32_t ROW4_PIN);
 
+#define KEYPAD_KEY_BIT(row, col)	(1u << ((row) * NUMCOLS + (col)))
+
+/* Scans the whole matrix, returns the pressed keys as KEYPAD_KEY_BIT bits */
+uint16_t Keypad_Scan(Keypad_HandleTypeDef* KEYPAD);
 char Keypad_Readkey(Keypad_HandleTypeDef* KEYPAD);
 
+/* Scans, then queues one event per key that changed since the last
+ * accepted state. Scans where a pressed key may be a ghost (three keys at
+ * the corners of a rectangle make the fourth look pressed) are ignored.
+ */
+void Keypad_Update(Keypad_HandleTypeDef* KEYPAD);
+
+/* Same as Keypad_Update for a bitmap scanned (and debounced) elsewhere */
+void Keypad_Update_Keys(Keypad_HandleTypeDef* KEYPAD, uint16_t keys);
+
+/* Pops the oldest event, returns 0 if there is none */
+uint8_t Keypad_Get_Event(Keypad_HandleTypeDef* KEYPAD, KeypadEvent_t* event);
+
 #endif /* __KEYPAD_H__ */
@@ -0,0 +1,63 @@
+/*
+ * atomic_bits.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ */
+
+#ifndef INC_ATOMIC_BITS_H_
+#define INC_ATOMIC_BITS_H_
+
+/**
+ * @file atomic_bits.h
+ * @brief Lock-free set / consume of bits shared between ISRs and the main loop.
+ *
+ * Notes:
+ * - Cortex-M3: LDREX/STREX retry loops, no interrupt masking needed.
+ * - Host build: C11 atomics, so the same code can be exercised from threads.
+ */
+
+#include <stdint.h>
+
+#if defined(__arm__)
+#include "main.h" // CMSIS __LDREXW / __STREXW
+
+typedef volatile uint32_t atomic_bits_t;
+
+/* *word |= bits */
+static inline void Atomic_Set_Bits(atomic_bits_t *word, uint32_t bits)
+{
+	uint32_t value;
+	do {
+		value = __LDREXW(word) | bits;
+	} while (__STREXW(value, word) != 0);
+}
+
+/* Clears 'bits' in *word and returns which of them were set */
+static inline uint32_t Atomic_Consume_Bits(atomic_bits_t *word, uint32_t bits)
+{
+	uint32_t value;
+	do {
+		value = __LDREXW(word);
+	} while (__STREXW(value & ~bits, word) != 0);
+	return value & bits;
+}
+
+#else
+#include <stdatomic.h>
+
+typedef _Atomic uint32_t atomic_bits_t;
+
+static inline void Atomic_Set_Bits(atomic_bits_t *word, uint32_t bits)
+{
+	atomic_fetch_or(word, bits);
+}
+
+static inline uint32_t Atomic_Consume_Bits(atomic_bits_t *word, uint32_t bits)
+{
+	return atomic_fetch_and(word, ~bits) & bits;
+}
+
+#endif
+
+#endif /* INC_ATOMIC_BITS_H_ */
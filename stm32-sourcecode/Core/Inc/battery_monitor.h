@@ -0,0 +1,91 @@
+/*
+ * battery_monitor.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ */
+
+#ifndef INC_BATTERY_MONITOR_H_
+#define INC_BATTERY_MONITOR_H_
+
+/**
+ * @file battery_monitor.h
+ * @brief Background battery measurement: ADC1 + DMA, filtered in software.
+ *
+ * Notes:
+ * - TIM3 TRGO starts one ADC1 scan every BATTERY_SAMPLE_MS: VREFINT
+ *   (channel 17), then the battery divider when BATTERY_DIVIDER_CHANNEL is
+ *   defined. DMA1 channel 1 stores the results in a circular buffer of
+ *   BATTERY_OVERSAMPLE scans; the CPU does nothing between conversions.
+ * - Without a divider the board runs from the battery and the monitor
+ *   measures VDDA: VDDA = 1.20 V * 4095 / VREFINT reading. With one, the
+ *   divider input is scaled by the same VREFINT reading, so the result does
+ *   not depend on VDDA. The divider pin must be set as analog input.
+ * - Every BATTERY_UPDATE_MS, Battery_Monitor_Process sums the whole buffer
+ *   (oversampling and decimation) and feeds the filter: a short moving
+ *   average, then hysteresis (BATTERY_LOW_MV / BATTERY_OK_MV) confirmed
+ *   over BATTERY_CONFIRM_READINGS readings.
+ * - While the solenoid is energised, and for the next reading (the buffer
+ *   still holds samples of the dip), readings are blanked.
+ * - Input_Process is frozen in scheduler standby while ADC1 and DMA keep
+ *   running. On wake-up Battery_Monitor_Wake seeds the filter from the
+ *   fresh buffer, so a battery that ran down during a long sleep reports
+ *   batteryLow on the first pass instead of three readings later.
+ * - Battery_Decimate_mV and Battery_Filter_* do not touch the hardware and
+ *   can be run on host with synthetic buffers and voltage curves.
+ */
+
+#include <stdint.h>
+
+#define BATTERY_SAMPLE_MS			10		// TIM3 trigger period, one scan per trigger
+#define BATTERY_OVERSAMPLE			64		// Scans per reading (buffer length)
+#define BATTERY_UPDATE_MS			1000	// > BATTERY_OVERSAMPLE * BATTERY_SAMPLE_MS
+#define BATTERY_VREFINT_MV			1200	// Typical, 1.16 - 1.24 V
+#ifndef BATTERY_LOW_MV
+#define BATTERY_LOW_MV				2500	// batteryLow set below this
+#endif
+#ifndef BATTERY_OK_MV
+#define BATTERY_OK_MV				2600	// and cleared from this up
+#endif
+#define BATTERY_CONFIRM_READINGS	3		// Consecutive readings past a threshold
+#define BATTERY_RECOVERY_READINGS	1		// Readings blanked after the load is off
+
+/* Optional external divider, e.g. -DBATTERY_DIVIDER_CHANNEL=8 (PB0) with
+ * BATTERY_DIVIDER_RATIO = (Rtop + Rbottom) / Rbottom
+ */
+#ifdef BATTERY_DIVIDER_CHANNEL
+#define BATTERY_ADC_CHANNELS		2
+#ifndef BATTERY_DIVIDER_RATIO
+#define BATTERY_DIVIDER_RATIO		2
+#endif
+#else
+#define BATTERY_ADC_CHANNELS		1
+#endif
+
+typedef struct {
+	uint32_t averageX4;		// Moving average, mV * 4
+	uint16_t mV;			// Last filtered level
+	uint8_t primed;			// First reading taken
+	uint8_t low;			// Debounced batteryLow
+	uint8_t confirm;		// Readings past the threshold so far
+	uint8_t holdOff;		// Readings still blanked after a load
+} BatteryFilter_t;
+
+/* 'scans' ADC scans of BATTERY_ADC_CHANNELS results each (VREFINT first),
+ * returns the battery voltage in mV, 0 if the buffer is not valid
+ */
+uint16_t Battery_Decimate_mV(const uint16_t *buffer, uint16_t scans);
+void Battery_Filter_Init(BatteryFilter_t *filter);
+/* One reading, 'loaded' = taken while the solenoid drew current; returns batteryLow */
+uint8_t Battery_Filter_Update(BatteryFilter_t *filter, uint16_t mV, uint8_t loaded);
+/* Restarts the filter from one settled, unloaded reading: no moving average
+ * history and no confirmation, only the hysteresis. Returns batteryLow.
+ */
+uint8_t Battery_Filter_Seed(BatteryFilter_t *filter, uint16_t mV);
+
+void Battery_Monitor_Init(void);
+uint8_t Battery_Monitor_Process(void);	// From Input_Process every tick, returns batteryLow
+uint16_t Battery_Monitor_mV(void);		// Filtered level, 0 before the first reading
+void Battery_Monitor_Wake(void);		// Leaving scheduler standby (keypad_wake.c)
+
+#endif /* INC_BATTERY_MONITOR_H_ */
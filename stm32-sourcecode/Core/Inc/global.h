@@ -19,6 +19,14 @@
 // Key mapping: Matrix 4x4
 extern char KEYMAP[NUMROWS][NUMCOLS];
 
+#define KEYPAD_EVENT_QUEUE 8	// Power of two
+
+typedef struct {
+	char key;				// Character from the key map
+	uint8_t index;			// Bit of the key in the scan bitmap
+	uint8_t pressed;		// 1 = press, 0 = release
+} KeypadEvent_t;
+
 typedef struct {
 	uint32_t RowPins[NUMROWS];
 	uint32_t ColPins[NUMCOLS];
@@ -26,6 +34,15 @@ typedef struct {
 	GPIO_TypeDef* ColPort[NUMCOLS];
 	char MAP[NUMROWS][NUMCOLS];
 	char Value;
+	GPIO_TypeDef* FastPort;	// All pins on this port (NULL: HAL pin-by-pin scan)
+	uint8_t RowShift;		// Rows are pins RowShift..RowShift+3
+	uint8_t ColShift;		// Columns are pins ColShift..ColShift+3
+	uint16_t Keys;			// Last scan, bit (row * NUMCOLS + col) = pressed
+	uint16_t State;			// Accepted key state (ghost patterns rejected)
+	uint8_t Ghosting;		// Last scan was ambiguous and ignored
+	uint8_t EvHead;			// Press / release events, oldest at EvTail
+	uint8_t EvTail;
+	KeypadEvent_t Events[KEYPAD_EVENT_QUEUE];
 } Keypad_HandleTypeDef;
 
 extern Keypad_HandleTypeDef hKeypad;
@@ -33,7 +50,7 @@ extern I2C_LCD_HandleTypeDef lcd1;
 
 // --- 2. Button & Sensor Config ---
 #define N0_OF_BUTTONS 					5
-#define DURATION_FOR_AUTO_INCREASING 	100 // 100 * 10ms = 1s for long press
+#define DURATION_FOR_AUTO_INCREASING 	100 // 100 * 10ms = 1s, default long press (per button in input_reading.c)
 
 // Logic level definitions
 #define BUTTON_IS_PRESSED 			GPIO_PIN_RESET
@@ -64,21 +81,26 @@ extern I2C_LCD_HandleTypeDef lcd1;
 
 // --- 4. Data Structures ---
 
-/* Input Snapshot: Holds processing results for FSM */
+/* Input Snapshot: Holds processing results for FSM.
+ * Levels are kept by Input_Process, the button fields are set by
+ * State_Process for the one event being handled (like gKeyEvent).
+ */
 typedef struct {
-    uint8_t doorSensor;      // 1 = CLOSED (Pressed), 0 = OPEN
-    uint8_t keySensor;       // 1 = Active
-    uint8_t indoorButton;    // 1 = Active (Short press)
-    uint8_t indoorButtonLong;// 1 = Active (Long press > 1s)
-    uint8_t batteryLow;      // 1 = Low Battery
+    uint8_t doorSensor;      // Level: 1 = CLOSED (Pressed), 0 = OPEN
+    uint8_t keySensor;       // Event: 1 = Mechanical key used
+    uint8_t indoorButton;    // Event: 1 = Short press
+    uint8_t indoorButtonLong;// Event: 1 = Long press > 1s
+    uint8_t batteryLow;      // Level: 1 = Low Battery
 } InputState_t;
 extern InputState_t gInputState;
-extern char last_keypad_char;
 extern uint8_t last_enter_state;
 extern uint8_t last_backspace_state;
 extern uint8_t last_door_btn_state;
 
-/* Key Event Mailbox: Keypad & Discrete Action Buttons */
+/* Key event being handled by the FSM: Keypad & Discrete Action Buttons.
+ * Input_Process queues events (key_queue.h), State_Process loads them
+ * here one at a time.
+ */
 typedef struct {
     char keyChar;       	// '0'-'9', 'A'-'F' from Keypad
     uint8_t isEnter;    	// 1 = Enter Pressed
@@ -100,24 +122,25 @@ typedef struct {
     char lcdLine1[17];
     char lcdLine2[17];
     size_t inLength; //length of password read
+    uint32_t solenoidCauseMs; // Sampling time of the input behind the last solenoid change
+    uint8_t solenoidCause;    // 1 = solenoidCauseMs is set and not yet measured
 } OutputStatus_t;
 extern OutputStatus_t gOutputStatus;
 
 // --- 5. Timers & Logic ---
-// Timer Task IDs
-#define BUZZER_TASK_ID      	0
-#define WARNING_TASK_ID     	1  // 3s timers
-#define ENTRY_TIMEOUT_ID    	2  // 30s timers
-#define UNLOCK_WINDOW_ID    	3  // 10s/30s timers
-#define MASK_TIMER_ID       	4  // 1s timer for masking password char
-#define DOOR_NOTIFY_TIMER_ID 	5  // Timer for displaying change the state of the door
+// Shared software timers (timer.h), allocated by init_global_variables
+extern int gWarningTimer;		// 3s timers
+extern int gEntryTimeoutTimer;	// 30s timers
+extern int gUnlockWindowTimer;	// 10s/30s timers
+extern int gMaskTimer;			// 1s LOCKED_WAKEUP timer of the FSM
+extern int gCharMaskTimer;		// 1s timer for masking password char (display only)
+extern int gDoorNotifyTimer;	// Timer for displaying change the state of the door
 
 /* System Timers (Long term) */
 typedef struct {
     uint32_t failedAttempts;
     uint8_t  penaltyLevel;
-    uint32_t penaltyEndTick;
-    uint32_t alarmRepeatTick;
+    uint64_t penaltyEndMs;		// Timebase_Now_Ms, for the countdown display
 } SystemTimers_t;
 extern SystemTimers_t gSystemTimers;
 
@@ -134,9 +157,6 @@ extern char gPassword[PASSWORD_LENGTH + 1];
 extern char inputBuffer[MAX_INPUT_LENGTH + 1];
 
 // Timer helper
-#define NUM_TASKS 6
-extern int timer_counter[NUM_TASKS];
-extern int timer_flag[NUM_TASKS];
 extern int TIMER_CYCLE; // 10ms
 
 void init_global_variables(void);
@@ -9,6 +9,7 @@
 #define INC_I2C_LCD_H_
 
 #include <stdint.h>
+#include "pt.h"
 
 /**
  * @brief Includes the HAL driver present in the project
@@ -36,6 +37,14 @@ typedef struct {
  */
 void lcd_init(I2C_LCD_HandleTypeDef *lcd);
 
+/**
+ * @brief Non-blocking lcd_init, run from a scheduler task (see pt.h).
+ * @param pt: Protothread state
+ * @param lcd: Pointer to the LCD handle
+ * @retval PT_WAITING until the LCD is ready, then PT_ENDED
+ */
+char lcd_init_pt(pt_t *pt, I2C_LCD_HandleTypeDef *lcd);
+
 /**
  * @brief Sends a command to the LCD.
  * @param lcd: Pointer to the LCD handle
@@ -18,9 +18,9 @@ void Input_Init(void);
  * @brief Process inputs, called periodically (recommended every 10 ms).
  *
  * Responsibilities:
- * - Read ADC and update gInputState.batteryLow.
+ * - Update gInputState.batteryLow from the battery monitor (battery_monitor.h).
  * - Detect edges/long presses on discrete buttons.
- * - Create Key Events (gKeyEvent) for the FSM.
+ * - Post key, button, sensor and battery events to the FSM (State_Event_*).
  */
 void Input_Process(void);
 
@@ -10,10 +10,33 @@
 
 #include "main.h"
 #include "global.h"
+
+/* 1 = the buttons (GPIOB / GPIOC) are sampled every 1 ms by TIM4-triggered
+ * DMA into circular buffers, and each tick debounces the batch of snapshots
+ * in one pass. 0 = they are read once per tick with the keypad.
+ */
+#ifndef INPUT_DMA_SAMPLING
+#define INPUT_DMA_SAMPLING	1
+#endif
+#define INPUT_DMA_SAMPLES	64	// Snapshots per port buffer, > one tick of samples
+
 void input_reading_init(void);
 void button_reading(void);
 unsigned int is_button_pressed(unsigned int index);
 unsigned int is_button_pressed_1s(unsigned int index);
+/* Debounces 'count' GPIOB / GPIOC snapshots taken 1 sample period apart,
+ * the last one at 'lastMs' (also used by host tests with synthetic buffers)
+ */
+void button_reading_batch(const uint16_t *portB, const uint16_t *portC, uint16_t count, uint32_t lastMs);
+uint16_t keypad_keys_debounced(void);	// KEYPAD_KEY_BIT bits, scanned by button_reading
+uint32_t button_edge_ms(unsigned int index);	// HAL_GetTick time the last press/release began
+uint32_t keypad_edge_ms(uint8_t index);		// Same for keypad key 'index' (KEYPAD_KEY_BIT order)
+void input_reading_wake(void);			// Wake-up edge: the next settled press is accepted at once
+/* Boot time: HAL_GetTick (ms from TIM2 start, right after reset and clock
+ * setup) at the first keypad scan since input_reading_init, 0 until then.
+ * Read it from the debugger.
+ */
+uint32_t input_reading_boot_scan_ms(void);
 
 
 #endif /* INC_INPUT_READING_H_ */
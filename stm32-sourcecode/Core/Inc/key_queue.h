@@ -0,0 +1,62 @@
+/*
+ * key_queue.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ */
+
+#ifndef INC_KEY_QUEUE_H_
+#define INC_KEY_QUEUE_H_
+
+/**
+ * @file key_queue.h
+ * @brief Lock-free single producer / single consumer queue of FSM input events.
+ *
+ * Notes:
+ * - Keys and buttons, door / key sensor edges and battery changes, posted
+ *   through the State_Event_* calls (state_processing.h). Timer expiries
+ *   come from the TIM2 interrupt and do not go through the queue.
+ * - Input_Process is the only producer, State_Process the only consumer.
+ *   Each side writes only its own index, so no lock or interrupt masking
+ *   is needed, even if the producer is later moved into an ISR.
+ * - When the queue is full the new event is dropped and counted: the FSM
+ *   sees every key up to the overflow, in order, never a partial event.
+ */
+
+#include <stdint.h>
+
+#define KEY_QUEUE_SIZE		32	// Power of two, <= 128
+
+typedef enum {
+	KEY_EV_NONE = 0,
+	KEY_EV_CHAR,			// 'key' holds the keypad character
+	KEY_EV_ENTER,
+	KEY_EV_ENTER_LONG,		// Enter held > 1s
+	KEY_EV_BACKSPACE,
+	KEY_EV_INDOOR,			// Indoor unlock button, short press
+	KEY_EV_INDOOR_LONG,		// Indoor unlock button held > 1s
+	KEY_EV_KEY_SENSOR,		// Mechanical key turned
+	KEY_EV_DOOR_OPEN,		// gInputState.doorSensor already updated
+	KEY_EV_DOOR_CLOSE,
+	KEY_EV_BATTERY			// gInputState.batteryLow changed
+} KeyEventType_t;
+
+typedef struct {
+	uint8_t type;			// KeyEventType_t
+	char key;				// KEY_EV_CHAR only
+	uint32_t timeMs;		// HAL_GetTick() time the input changed
+} KeyQueueEvent_t;
+
+typedef struct {
+	uint32_t pushed;		// Events accepted
+	uint32_t dropped;		// Events lost because the queue was full
+	uint8_t highWater;		// Most events queued at once
+} KeyQueueStats_t;
+
+void KeyQueue_Init(void);
+uint8_t KeyQueue_Push(const KeyQueueEvent_t *ev);	// Producer, 0 = full (dropped)
+uint8_t KeyQueue_Pop(KeyQueueEvent_t *ev);			// Consumer, 0 = empty
+uint8_t KeyQueue_Count(void);
+void KeyQueue_Get_Stats(KeyQueueStats_t *stats);
+
+#endif /* INC_KEY_QUEUE_H_ */
@@ -0,0 +1,42 @@
+/*
+ * keypad_wake.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ */
+
+#ifndef INC_KEYPAD_WAKE_H_
+#define INC_KEYPAD_WAKE_H_
+
+/**
+ * @file keypad_wake.h
+ * @brief Interrupt-driven wake-up from LOCKED_SLEEP, no polling while idle.
+ *
+ * Notes:
+ * - After KEYPAD_WAKE_QUIET_MS in LOCKED_SLEEP with every input released
+ *   and no soft timer running, all keypad columns are driven low and the
+ *   row inputs are armed as falling-edge EXTI sources, together with the
+ *   door / key sensor / indoor button inputs. The scheduler goes to
+ *   standby (SCH_Standby): no task runs until an edge, so Tickless_Idle
+ *   only wakes for the TIM2 counter span (~65 s).
+ * - The EXTI interrupt disarms the lines and signals an event task. The
+ *   task restores the columns and leaves standby. The edge counts as the
+ *   first debounce sample (input_reading_wake): the first tick at least
+ *   5 ms after it that reads the key pressed accepts it, so key-to-FSM
+ *   latency stays below 10 ms + 5 ms even with contact bounce.
+ * - Enter / Backspace (PB12/13) cannot wake: EXTI13 is taken by PC13, and
+ *   neither key does anything in LOCKED_SLEEP.
+ */
+
+#include <stdint.h>
+
+#define KEYPAD_WAKE_QUIET_MS	1000	// Idle time in LOCKED_SLEEP before standby
+#define KEYPAD_WAKE_SIGNAL		0		// Scheduler signal bit of the wake task
+
+void Keypad_Wake_Init(void);
+void Keypad_Wake_Process(void);		// Pipeline task, every tick after Output_Process
+
+/* From HAL_GPIO_EXTI_Callback: an armed input went low */
+void Keypad_Wake_Irq(uint16_t GPIO_Pin);
+
+#endif /* INC_KEYPAD_WAKE_H_ */
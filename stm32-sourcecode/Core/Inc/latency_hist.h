@@ -0,0 +1,48 @@
+/*
+ * latency_hist.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ */
+
+#ifndef INC_LATENCY_HIST_H_
+#define INC_LATENCY_HIST_H_
+
+/**
+ * @file latency_hist.h
+ * @brief Input-to-output latency histograms with fixed log2 buckets.
+ *
+ * Notes:
+ * - Inputs are stamped at sampling time (button_edge_ms, keypad_edge_ms).
+ *   The stamp travels in the FSM event (State_Event_*), then with the FSM
+ *   transition it causes (gOutputStatus.solenoidCauseMs), up to the relay
+ *   write in Output_Process.
+ * - Bucket 0 counts 0 ms, bucket b counts 2^(b-1) .. 2^b - 1 ms, the last
+ *   one everything from 2^(LATENCY_BUCKETS-2) ms up.
+ * - Plain RAM counters, read them from the debugger or Latency_Get.
+ */
+
+#include <stdint.h>
+
+#define LATENCY_BUCKETS		13	// 0, 1, 2-3, ... 1024-2047, >= 2048 ms
+
+typedef enum {
+	LATENCY_KEY_TO_FSM = 0,		// Input change -> FSM takes the event
+	LATENCY_INPUT_TO_RELAY,		// Input change -> relay pin written
+	LATENCY_COUNT
+} LatencyId_t;
+
+typedef struct {
+	uint32_t count;
+	uint32_t maxMs;
+	uint32_t totalMs;			// mean = totalMs / count
+	uint32_t bucket[LATENCY_BUCKETS];
+} LatencyHist_t;
+
+void Latency_Init(void);
+void Latency_Record(LatencyId_t id, uint32_t ms);
+const LatencyHist_t* Latency_Get(LatencyId_t id);
+uint8_t Latency_Bucket(uint32_t ms);
+uint32_t Latency_Bucket_Low_Ms(uint8_t bucket);	// Smallest latency of a bucket
+
+#endif /* INC_LATENCY_HIST_H_ */
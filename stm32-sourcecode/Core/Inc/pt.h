@@ -0,0 +1,78 @@
+/*
+ * pt.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ */
+
+#ifndef INC_PT_H_
+#define INC_PT_H_
+
+/**
+ * @file pt.h
+ * @brief Stackless coroutines (protothreads) for scheduler tasks.
+ *
+ * Notes:
+ * - A protothread is a function 'char f(pt_t *pt, ...)' that is called again
+ *   by its scheduler task until it returns PT_ENDED / PT_EXITED. Between calls
+ *   it resumes at the last PT_WAIT_* / PT_YIELD / PT_SLEEP_MS.
+ * - Local variables are NOT kept across a wait: keep state in statics or in
+ *   a struct next to the pt_t.
+ * - The resume point is a switch case label, so a protothread body must not
+ *   contain its own switch statement around a wait.
+ * - PT_SLEEP_MS counts scheduler ticks: the delay is rounded up to whole
+ *   SCH_TICK_MS ticks and ends on the first call after it elapsed.
+ */
+
+#include <stdint.h>
+#include "scheduler.h"
+
+typedef struct {
+	uint16_t lc;		// Resume point (source line), 0 = start
+	uint32_t wake;		// PT_SLEEP_MS deadline in scheduler ticks
+} pt_t;
+
+#define PT_WAITING	0
+#define PT_YIELDED	1
+#define PT_EXITED	2
+#define PT_ENDED	3
+
+#define PT_INIT(pt)				((pt)->lc = 0)
+
+#define PT_BEGIN(pt)			{ char pt_yielded = 1; (void)pt_yielded; switch ((pt)->lc) { case 0:
+
+#define PT_END(pt)				} pt_yielded = 0; PT_INIT(pt); return PT_ENDED; }
+
+#define PT_WAIT_UNTIL(pt, cond) \
+	do { \
+		(pt)->lc = __LINE__; case __LINE__: \
+		if (!(cond)) return PT_WAITING; \
+	} while (0)
+
+#define PT_WAIT_WHILE(pt, cond)	PT_WAIT_UNTIL(pt, !(cond))
+
+/* Wait for a child protothread to finish */
+#define PT_WAIT_THREAD(pt, thread)	PT_WAIT_WHILE(pt, PT_SCHEDULE(thread))
+
+/* Give the CPU back once, resume on the next call */
+#define PT_YIELD(pt) \
+	do { \
+		pt_yielded = 0; \
+		(pt)->lc = __LINE__; case __LINE__: \
+		if (pt_yielded == 0) return PT_YIELDED; \
+	} while (0)
+
+#define PT_SLEEP_MS(pt, ms) \
+	do { \
+		(pt)->wake = SCH_Get_Ticks() + ((ms) + SCH_TICK_MS - 1) / SCH_TICK_MS; \
+		PT_WAIT_UNTIL(pt, (int32_t)(SCH_Get_Ticks() - (pt)->wake) >= 0); \
+	} while (0)
+
+#define PT_RESTART(pt)			do { PT_INIT(pt); return PT_WAITING; } while (0)
+
+#define PT_EXIT(pt)				do { PT_INIT(pt); return PT_EXITED; } while (0)
+
+/* Non-zero while the protothread has not finished */
+#define PT_SCHEDULE(f)			((f) < PT_EXITED)
+
+#endif /* INC_PT_H_ */
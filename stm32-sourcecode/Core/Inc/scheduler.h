@@ -10,9 +10,58 @@
 
 #include <stdint.h>
 
+#ifndef SCH_STATIC_TASKS
+#define SCH_STATIC_TASKS	1		// 1 = permanent tasks come from task_table.h
+#endif
+
+#if SCH_STATIC_TASKS
+#define SCH_MAX_TASKS		8		// Dynamic slots, only for one-shot / extra tasks
+#else
 #define SCH_MAX_TASKS		40
+#endif
 #define NO_TASK_ID			0
 
+/* Scheduler backends:
+ * - DELTA_LIST:   tasks linked in delta-delay order, O(n) insert.
+ * - TIMING_WHEEL: tasks hashed into per-tick buckets, O(1) add/dispatch/requeue.
+ */
+#define SCH_BACKEND_DELTA_LIST		0
+#define SCH_BACKEND_TIMING_WHEEL	1
+
+#ifndef SCH_BACKEND
+#define SCH_BACKEND			SCH_BACKEND_TIMING_WHEEL
+#endif
+
+#ifndef SCH_PROFILING
+#define SCH_PROFILING		0		// 1 = per-task timing stats (task_profiler.h)
+#endif
+
+#ifndef SCH_BATCH_DISPATCH
+#define SCH_BATCH_DISPATCH	1		// 1 = run every ready task per dispatch pass
+#endif
+
+#ifndef SCH_AUTO_PHASE
+#define SCH_AUTO_PHASE		0		// 1 = SCH_Add_Task_Auto picks the least loaded phase
+#endif
+
+#define SCH_PRIORITY_HIGHEST	0
+#define SCH_PRIORITY_DEFAULT	128
+#define SCH_PRIORITY_LOWEST		255
+
+#define SCH_TICK_MS			10		// TIM2 tick period
+#define SCH_WHEEL_SIZE		32		// Buckets, must be a power of two
+#define SCH_PHASE_SLOTS		64		// Load profile length in ticks, power of two
+#define SCH_MAX_SIGNALS		32		// Signal bits for event tasks, one word
+#define SCH_NO_SLOT			0xFF
+#define SCH_IDLE_FOREVER	0xFFFFFFFF
+
+/* Task handle = (generation << 8) | slot. The generation is bumped every time
+ * a slot is released, so a stale handle never matches a reused slot and is
+ * never equal to NO_TASK_ID.
+ */
+#define SCH_HANDLE_SLOT(id)			((uint8_t)((id) & 0xFF))
+#define SCH_HANDLE_GENERATION(id)	((id) >> 8)
+
 #define ERROR_SCH_TOO_MANY_TASKS                      	1
 #define ERROR_SCH_WAITING_FOR_SLAVE_TO_ACK            	2
 #define ERROR_SCH_WAITING_FOR_START_COMMAND_FROM_MASTER 3
@@ -32,14 +81,46 @@ typedef struct {
 	uint32_t Period;
 	uint8_t RunMe;
 	uint32_t TaskID;
+	uint8_t Next;		// Wheel bucket / delta list / free list link
+	uint8_t Prev;		// Wheel bucket / delta list back link
+	uint8_t NextReady;	// Ready queue link
+	uint8_t Priority;	// Ready queue order, SCH_PRIORITY_HIGHEST runs first
+	uint8_t Flags;		// SCH_FLAG_* (scheduler.c)
+	uint8_t Signal;		// Event tasks: signal bit, Next links the tasks on it
 } sTask;
 
 extern uint8_t SCH_task_count;
 
 void SCH_Init(void);
 void SCH_Update(void);
-uint8_t SCH_Add_Task(void (*pFunction)(), uint32_t DELAY, uint32_t PERIOD);
+void SCH_Update_Ticks(uint32_t ticks);
+uint32_t SCH_Idle_Ticks(void);
+uint32_t SCH_Get_Ticks(void);
+uint32_t SCH_Add_Task(void (*pFunction)(), uint32_t DELAY, uint32_t PERIOD);
+uint32_t SCH_Add_Task_Priority(void (*pFunction)(), uint32_t DELAY, uint32_t PERIOD, uint8_t PRIORITY);
+/* Periodic task whose first-run phase is chosen by the scheduler so that
+ * the worst tick load stays as low as possible (SCH_AUTO_PHASE = 1, plain
+ * SCH_Add_Task_Priority with delay 0 otherwise). COST_US is the expected
+ * run time, replaced by the measured mean once SCH_PROFILING has one.
+ */
+uint32_t SCH_Add_Task_Auto(void (*pFunction)(), uint32_t PERIOD, uint16_t COST_US, uint8_t PRIORITY);
+void SCH_Rebalance(void);
+void SCH_Load_Report(void (*print)(const char *line));
+
+/* Event tasks have no period: they run once on the next dispatch pass each
+ * time their bit is set with SCH_Signal(1u << SIGNAL). Signals raised again
+ * before the task runs are merged into one run. SCH_Signal is ISR-safe.
+ */
+uint32_t SCH_Add_Event_Task(void (*pFunction)(), uint8_t SIGNAL, uint8_t PRIORITY);
+void SCH_Signal(uint32_t SIGNALS);
 void SCH_Dispatch_Tasks(void);
-uint8_t  SCH_Delete_Task(const uint8_t TASK_INDEX);
+/* Standby: time-driven tasks (table entries, periodic and delayed tasks)
+ * stay frozen where they are while ticks keep being counted, only event
+ * tasks run. SCH_Idle_Ticks then reports SCH_IDLE_FOREVER. ISR-safe.
+ */
+void SCH_Standby(uint8_t ON);
+uint8_t SCH_In_Standby(void);
+uint8_t  SCH_Delete_Task(const uint32_t TASK_ID);
+uint8_t  SCH_Reschedule_Task(const uint32_t TASK_ID, uint32_t DELAY);
 
 #endif /* INC_SCHEDULER_H_ */
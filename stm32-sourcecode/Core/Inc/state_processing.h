@@ -13,8 +13,15 @@
  * @brief State machine module (FSM) core logic.
  *
  * Notes:
- * - FSM uses global structures (gInputState, gKeyEvent) for input events.
- * - FSM updates global output status (gOutputStatus) and timers (gSystemTimers, timer_flag).
+ * - Event driven: inputs are posted with the State_Event_* calls into the
+ *   event queue (key_queue.h), timer expiries with State_Event_Timer. The FSM
+ *   only runs when one of them arrived, otherwise State_Process returns at once.
+ * - Each event is run to completion: one step presents it (gKeyEvent /
+ *   gInputState), further steps follow while the state keeps changing.
+ * - FSM updates global output status (gOutputStatus) and timers (gSystemTimers, timerConsume).
+ * - Table driven: per state, const transition rows (event, guard, action,
+ *   next state) in priority order, plus outputs / entry / exit actions run
+ *   once when the state is entered or left (state_processing.c).
  */
 
 #include <stdint.h>
@@ -26,41 +33,63 @@ void State_Init(void);
 
 /**
  * @brief Periodic handler, the core FSM loop.
- * Must be called by the scheduler every 10ms.
+ * Called by the scheduler every 10ms in the pipeline slot, after
+ * Input_Process: runs the FSM on the events posted since, if any.
  */
 void State_Process(void);
 
-/* --- Event handlers for discrete triggers (called by input_processing) --- */
+/* --- Event posting (called by input_processing) ---
+ * 'timeMs' is the HAL_GetTick() time the input was sampled (latency_hist.h).
+ */
 
 /**
- * @brief Posts a regular keypad character event to the FSM mailbox.
+ * @brief Posts a keypad character event.
  */
-void State_Event_KeypadChar(char c);
+void State_Event_KeypadChar(char c, uint32_t timeMs);
 
 /**
- * @brief Posts a long-press keypad character event (used for Enter '#').
+ * @brief Posts an Enter button press / a long press (> 1s, set password).
  */
-void State_Event_KeypadChar_Long(char c);
+void State_Event_Enter(uint32_t timeMs);
+void State_Event_Enter_Long(uint32_t timeMs);
 
 /**
- * @brief Posts a long-press event from the Indoor Unlock Button.
+ * @brief Posts a Backspace button press.
  */
-void State_Event_IndoorButton_Long(void);
+void State_Event_Backspace(uint32_t timeMs);
+
+/**
+ * @brief Posts a short / long press of the Indoor Unlock Button.
+ */
+void State_Event_IndoorButton(uint32_t timeMs);
+void State_Event_IndoorButton_Long(uint32_t timeMs);
 
 /**
  * @brief Posts an edge event indicating the Mechanical Key was used.
  */
-void State_Event_KeySensor(void);
+void State_Event_KeySensor(uint32_t timeMs);
 
 /**
  * @brief Posts an edge event indicating the Door Sensor was released (Door is Open).
+ * gInputState.doorSensor must already hold the new level (same for Close).
  */
-void State_Event_DoorSensor_Open(void);
+void State_Event_DoorSensor_Open(uint32_t timeMs);
 
 /**
  * @brief Posts an edge event indicating the Door Sensor was pressed (Door is Closed).
  */
-void State_Event_DoorSensor_Close(void);
+void State_Event_DoorSensor_Close(uint32_t timeMs);
+
+/**
+ * @brief Posts a change of gInputState.batteryLow.
+ */
+void State_Event_Battery(void);
+
+/**
+ * @brief Expiry callback of the FSM timers (timerCreate / TW_Create).
+ * ISR-safe: only marks that the FSM has a timeout to run.
+ */
+void State_Event_Timer(void);
 
 /* --- Password API --- */
 
@@ -0,0 +1,78 @@
+/*
+ * task_profiler.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ */
+
+#ifndef INC_TASK_PROFILER_H_
+#define INC_TASK_PROFILER_H_
+
+/**
+ * @file task_profiler.h
+ * @brief Opt-in per-task execution time / start jitter statistics.
+ *
+ * Notes:
+ * - Enabled with SCH_PROFILING in scheduler.h, compiles to nothing otherwise.
+ * - Target build counts DWT->CYCCNT core cycles, host build counts
+ *   CLOCK_MONOTONIC nanoseconds. "Cycles" below means whichever unit is used.
+ * - Stats are kept per scheduler slot and reset when a new task takes the slot.
+ *   Entries of the static task table use slots SCH_MAX_TASKS and up.
+ */
+
+#include <stdint.h>
+#include "scheduler.h"
+
+typedef struct {
+    void (*pTask)(void);
+    uint32_t runs;
+    uint32_t minCycles;
+    uint32_t maxCycles;
+    uint64_t totalCycles;   // mean = totalCycles / runs
+    uint32_t maxJitter;     // Start time - scheduled tick time
+    uint64_t totalJitter;
+    uint32_t overruns;      // Runs longer than the task period
+} TaskProfile_t;
+
+#if SCH_PROFILING
+
+/* Start the cycle counter and clear the table. Called by SCH_Init. */
+void Prof_Init(void);
+
+/* TIM2 ISR: timestamp of the latest scheduler tick */
+void Prof_Tick(void);
+
+/* Task in slot is released; lag = ticks still waiting to be drained */
+void Prof_Release(uint8_t slot, uint32_t lag);
+
+/* Current timestamp, pass it back to Prof_End */
+uint32_t Prof_Begin(void);
+
+/* Account one run of the task in slot started at 'start' */
+void Prof_End(uint8_t slot, void (*pTask)(void), uint32_t period, uint32_t start);
+
+/* Mean run time of a slot in microseconds, 0 if it never ran */
+uint32_t Prof_Mean_Us(uint8_t slot);
+
+/**
+ * @brief Returns the stats of a slot, NULL if the slot never ran.
+ */
+const TaskProfile_t* Prof_Get(uint8_t slot);
+
+/**
+ * @brief Writes one text line per profiled slot through 'print'.
+ */
+void Prof_Dump(void (*print)(const char *line));
+
+#else
+
+#define Prof_Init()
+#define Prof_Tick()
+#define Prof_Release(slot, lag)
+#define Prof_Begin()					0
+#define Prof_End(slot, pTask, period, start)	((void)(period), (void)(start))
+#define Prof_Mean_Us(slot)				0
+
+#endif /* SCH_PROFILING */
+
+#endif /* INC_TASK_PROFILER_H_ */
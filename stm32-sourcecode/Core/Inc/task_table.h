@@ -0,0 +1,40 @@
+/*
+ * task_table.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ */
+
+#ifndef INC_TASK_TABLE_H_
+#define INC_TASK_TABLE_H_
+
+/**
+ * @file task_table.h
+ * @brief Build-time task table used when SCH_STATIC_TASKS = 1.
+ *
+ * Notes:
+ * - X(function, phase, period): first run on tick phase + 1, then every
+ *   'period' ticks. Both are in scheduler ticks (10 ms).
+ * - Entries run in table order within a tick, before any dynamic task.
+ * - The descriptors are const (flash), only a countdown and a RunMe counter
+ *   per entry are kept in RAM. Periods and phases are checked at compile time.
+ */
+
+#include "input_reading.h"
+#include "input_processing.h"
+#include "state_processing.h"
+#include "output_processing.h"
+#include "keypad_wake.h"
+
+#define SCH_STATIC_TASK_LIST(X) \
+	X(button_reading,	0, 1) \
+	X(Input_Process,	0, 1) \
+	X(State_Process,	0, 1) \
+	X(Output_Process,	0, 1) \
+	X(Keypad_Wake_Process,	0, 1)
+
+#define SCH_STATIC_ENUM(fn, phase, period)	SCH_STATIC_ID_##fn,
+enum { SCH_STATIC_TASK_LIST(SCH_STATIC_ENUM) SCH_STATIC_TASK_COUNT };
+#undef SCH_STATIC_ENUM
+
+#endif /* INC_TASK_TABLE_H_ */
@@ -0,0 +1,48 @@
+/*
+ * timebase.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ */
+
+#ifndef INC_TIMEBASE_H_
+#define INC_TIMEBASE_H_
+
+/**
+ * @file timebase.h
+ * @brief Monotonic 64-bit millisecond clock driven by TIM2 alone.
+ *
+ * Notes:
+ * - TIM2 counts at 1 kHz, its update interrupt is the 10 ms scheduler tick
+ *   (longer during tickless idle). Time = ms accumulated by the interrupt
+ *   + current TIM2 counter, so it has 1 ms resolution without a 1 ms IRQ.
+ * - HAL_GetTick / HAL_InitTick are overridden: SysTick is never started,
+ *   HAL_GetTick is the low 32 bits of this clock. Until TIM2 is started
+ *   it reads 0, so HAL timeouts before MX_TIM2_Init only wait for flags
+ *   and HAL_Delay would never return.
+ * - 64-bit deadlines do not wrap; compare them with Timebase_Reached.
+ *   32-bit HAL_GetTick values must be compared by difference.
+ */
+
+#include <stdint.h>
+
+/* Initial value of the clock. Set it close to 2^32 (e.g. 0xFFFFFFFF - 60000)
+ * to exercise the 32-bit HAL_GetTick wrap a minute after boot.
+ */
+#ifndef TIMEBASE_START_MS
+#define TIMEBASE_START_MS	0ULL
+#endif
+
+/* TIM2 update interrupt: 'ms' milliseconds ended with this update */
+void Timebase_Advance(uint32_t ms);
+
+/* Milliseconds since boot (+ TIMEBASE_START_MS), never wraps */
+uint64_t Timebase_Now_Ms(void);
+
+/* Non-zero once the 64-bit deadline has passed */
+static inline int Timebase_Reached(uint64_t deadline)
+{
+	return Timebase_Now_Ms() >= deadline;
+}
+
+#endif /* INC_TIMEBASE_H_ */
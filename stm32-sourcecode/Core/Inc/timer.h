@@ -8,10 +8,38 @@
 #ifndef INC_TIMER_H_
 #define INC_TIMER_H_
 
-#include "global.h"
+#include <stdint.h>
+
+/* Software timer service
+ * Timers are taken from a static pool with timerCreate and identified by
+ * their pool index. Running timers are kept in a list sorted by deadline,
+ * each entry holding the ticks after the previous one, so a tick only
+ * decrements the head of the list.
+ * On expiry a timer sets its expired bit, posts its scheduler signals and
+ * calls its callback. The bits of all timers share one word (one per 32
+ * timers) updated atomically (atomic_bits.h): timerConsume reads and clears a bit in one
+ * step so an expiry is handled exactly once, timerExpired only peeks.
+ * setTimer / stopTimer clear the bit too. Expiry happens in the TIM2 ISR: callbacks must be
+ * short, anything longer belongs in an event task woken by the signal.
+ */
+#ifndef MAX_SOFT_TIMERS
+#define MAX_SOFT_TIMERS		8
+#endif
+#define TIMER_NONE			-1
+
+int  timerCreate(void (*callback)(void), uint32_t signals);
+void timerDelete(int id);
+
+void setTimer(int id, int duration);			// One-shot, duration in ms
+void setTimerPeriodic(int id, int period);		// Every 'period' ms until stopped
+void stopTimer(int id);
+int  timerRunning(int id);
+int  timerExpired(int id);
+int  timerConsume(int id);
 
-void setTimer(int task_id, int duration);
 void timerRun();
+void timerAdvance(int ticks);
+uint32_t timerNextDue(void);	// Ticks to the next expiry, SCH_IDLE_FOREVER if none runs
 
 
 #endif /* INC_TIMER_H_ */
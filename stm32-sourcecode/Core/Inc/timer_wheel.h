@@ -0,0 +1,50 @@
+/*
+ * timer_wheel.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ */
+
+#ifndef INC_TIMER_WHEEL_H_
+#define INC_TIMER_WHEEL_H_
+
+/**
+ * @file timer_wheel.h
+ * @brief Hierarchical timing wheel for long deadlines (minutes to hours).
+ *
+ * Notes:
+ * - Three levels: 100 x 10 ms, 60 x 1 s, 64 x 1 min. A timer waits in the
+ *   coarsest level that fits and is moved down ("cascaded") only when its
+ *   second / minute comes up, so a 125 min penalty costs a handful of moves
+ *   instead of a check on every tick. Deadlines past 64 min go round the
+ *   minute level again.
+ * - TW_Advance runs in the TIM2 interrupt with the soft timers; on expiry a
+ *   timer sets its bit in an atomic expiry word (consumed by the FSM with
+ *   TW_Consume, see atomic_bits.h), posts its scheduler signals and calls
+ *   its callback (ISR context, keep it short) as the soft timers do.
+ * - Resolution is one 10 ms tick, maximum delay ~49 days.
+ */
+
+#include <stdint.h>
+
+#ifndef TW_MAX_TIMERS
+#define TW_MAX_TIMERS		4
+#endif
+#define TW_NONE				-1
+
+int  TW_Create(void (*callback)(void), uint32_t signals);
+void TW_Start(int id, uint32_t ms);
+void TW_Stop(int id);
+int  TW_Expired(int id);
+int  TW_Consume(int id);
+int  TW_Running(int id);
+
+/* TIM2 interrupt: 'ticks' 10 ms ticks elapsed */
+void TW_Advance(uint32_t ticks);
+
+/* Ticks until the wheel may have work to do, for tickless idle;
+ * SCH_IDLE_FOREVER when no timer runs
+ */
+uint32_t TW_Next_Due(void);
+
+#endif /* INC_TIMER_WHEEL_H_ */
@@ -9,6 +9,44 @@
 #include "keypad.h"
 #include "global.h" // For KEYPAD_DOUBLE_TIMEOUT, keypad_flags
 
+/* Settling time after switching columns: a row released by the previous
+ * column rises through the ~40k pull-up, about 1 us. Host builds replace
+ * the wait with the simulated matrix (Tests/Stubs/keypad_matrix.c).
+ */
+#define KEYPAD_SETTLE_LOOPS	8
+#ifndef KEYPAD_SETTLE
+#define KEYPAD_SETTLE(port)	for (volatile int i = 0; i < KEYPAD_SETTLE_LOOPS; i++) {}
+#endif
+
+static uint8_t pin_index(uint32_t pin)
+{
+	uint8_t index = 0;
+	while (pin > 1) { pin >>= 1; index++; }
+	return index;
+}
+
+/* Fast scan needs rows and columns on one port, each on 4 consecutive pins */
+static void keypad_detect_fast_port(Keypad_HandleTypeDef* KEYPAD)
+{
+	GPIO_TypeDef* port = KEYPAD->RowPort[0];
+	uint8_t rowShift = pin_index(KEYPAD->RowPins[0]);
+	uint8_t colShift = pin_index(KEYPAD->ColPins[0]);
+
+	KEYPAD->FastPort = NULL;
+	for (int i = 0; i < NUMROWS; i++)
+	{
+		if (KEYPAD->RowPort[i] != port || KEYPAD->RowPins[i] != (1u << (rowShift + i))) return;
+	}
+	for (int i = 0; i < NUMCOLS; i++)
+	{
+		if (KEYPAD->ColPort[i] != port || KEYPAD->ColPins[i] != (1u << (colShift + i))) return;
+	}
+
+	KEYPAD->RowShift = rowShift;
+	KEYPAD->ColShift = colShift;
+	KEYPAD->FastPort = port;
+}
+
 void Keypad_Init(Keypad_HandleTypeDef* KEYPAD, char KEYMAP[NUMROWS][NUMCOLS],
 										GPIO_TypeDef* COL1_PORT, uint32_t COL1_PIN,
 										GPIO_TypeDef* COL2_PORT, uint32_t COL2_PIN,
@@ -49,45 +87,140 @@ void Keypad_Init(Keypad_HandleTypeDef* KEYPAD, char KEYMAP[NUMROWS][NUMCOLS],
 	HAL_GPIO_WritePin(KEYPAD->ColPort[1],KEYPAD->ColPins[1],GPIO_PIN_SET);
 	HAL_GPIO_WritePin(KEYPAD->ColPort[2],KEYPAD->ColPins[2],GPIO_PIN_SET);
 	HAL_GPIO_WritePin(KEYPAD->ColPort[3],KEYPAD->ColPins[3],GPIO_PIN_SET);
+
+	KEYPAD->Keys = 0;
+	KEYPAD->State = 0;
+	KEYPAD->Ghosting = 0;
+	KEYPAD->EvHead = 0;
+	KEYPAD->EvTail = 0;
+	keypad_detect_fast_port(KEYPAD);
 }
 
-/*char Keypad_Readkey(Keypad_HandleTypeDef* KEYPAD) {
-	KEYPAD->Value = 0;
-	for(int colum = 0; colum < NUMCOLS; colum++)
+/* One BSRR write per column (that column low, the others high) and one IDR
+ * read for its four rows.
+ */
+static uint16_t keypad_scan_fast(Keypad_HandleTypeDef* KEYPAD)
+{
+	GPIO_TypeDef* port = KEYPAD->FastPort;
+	uint32_t colMask = 0xFu << KEYPAD->ColShift;
+	uint16_t keys = 0;
+
+	for (int colum = 0; colum < NUMCOLS; colum++)
 	{
-		HAL_GPIO_WritePin(KEYPAD->ColPort[colum],KEYPAD->ColPins[colum],GPIO_PIN_RESET);
-		for(int row = 0; row < NUMROWS; row++)
+		uint32_t colPin = 1u << (KEYPAD->ColShift + colum);
+		port->BSRR = (colPin << 16) | (colMask & ~colPin);
+		KEYPAD_SETTLE(port);
+
+		uint32_t rows = ~(port->IDR >> KEYPAD->RowShift) & 0xFu; // Active low
+		for (int row = 0; row < NUMROWS; row++)
 		{
-			if(HAL_GPIO_ReadPin(KEYPAD->RowPort[row],KEYPAD->RowPins[row]) == 0)
-			{
-				HAL_Delay(50);// debound
-				while(HAL_GPIO_ReadPin(KEYPAD->RowPort[row],KEYPAD->RowPins[row])==0){}
-				KEYPAD->Value = KEYPAD->MAP[row][colum];
+			if (rows & (1u << row)) keys |= KEYPAD_KEY_BIT(row, colum);
+		}
+	}
+	port->BSRR = colMask;
+	return keys;
+}
 
-				return KEYPAD->Value;
-			}
+/* Fallback for boards with the matrix on scattered pins */
+static uint16_t keypad_scan_hal(Keypad_HandleTypeDef* KEYPAD)
+{
+	uint16_t keys = 0;
+
+	for (int colum = 0; colum < NUMCOLS; colum++)
+	{
+		HAL_GPIO_WritePin(KEYPAD->ColPort[colum], KEYPAD->ColPins[colum], GPIO_PIN_RESET);
+		for (int row = 0; row < NUMROWS; row++)
+		{
+			if (HAL_GPIO_ReadPin(KEYPAD->RowPort[row], KEYPAD->RowPins[row]) == 0)
+				keys |= KEYPAD_KEY_BIT(row, colum);
 		}
-		HAL_GPIO_WritePin(KEYPAD->ColPort[colum],KEYPAD->ColPins[colum],GPIO_PIN_SET);
+		HAL_GPIO_WritePin(KEYPAD->ColPort[colum], KEYPAD->ColPins[colum], GPIO_PIN_SET);
 	}
+	return keys;
+}
 
-	return 0;
-}*/
+uint16_t Keypad_Scan(Keypad_HandleTypeDef* KEYPAD)
+{
+	KEYPAD->Keys = (KEYPAD->FastPort != NULL) ? keypad_scan_fast(KEYPAD) : keypad_scan_hal(KEYPAD);
+	return KEYPAD->Keys;
+}
 
+/* First pressed key in column order, 0 if none */
 char Keypad_Readkey(Keypad_HandleTypeDef* KEYPAD) {
+	uint16_t keys = Keypad_Scan(KEYPAD);
+
 	KEYPAD->Value = 0;
 	for(int colum = 0; colum < NUMCOLS; colum++)
 	{
-		HAL_GPIO_WritePin(KEYPAD->ColPort[colum], KEYPAD->ColPins[colum], GPIO_PIN_RESET);
 		for(int row = 0; row < NUMROWS; row++)
 		{
-			if(HAL_GPIO_ReadPin(KEYPAD->RowPort[row], KEYPAD->RowPins[row]) == 0)
+			if (keys & KEYPAD_KEY_BIT(row, colum))
 			{
 				KEYPAD->Value = KEYPAD->MAP[row][colum];
-				HAL_GPIO_WritePin(KEYPAD->ColPort[colum], KEYPAD->ColPins[colum], GPIO_PIN_SET);
 				return KEYPAD->Value;
 			}
 		}
-		HAL_GPIO_WritePin(KEYPAD->ColPort[colum], KEYPAD->ColPins[colum], GPIO_PIN_SET);
 	}
 	return 0;
 }
+
+/* Without diodes, two rows sharing two pressed columns cannot be told apart
+ * from the same pattern with one key less: the scan is ambiguous.
+ */
+static uint8_t keypad_is_ghost(uint16_t keys)
+{
+	for (int r1 = 0; r1 < NUMROWS - 1; r1++)
+	{
+		uint16_t cols1 = (keys >> (r1 * NUMCOLS)) & 0xF;
+		for (int r2 = r1 + 1; r2 < NUMROWS; r2++)
+		{
+			uint16_t common = cols1 & (keys >> (r2 * NUMCOLS)) & 0xF;
+			if (common & (common - 1)) return 1; // Two or more columns
+		}
+	}
+	return 0;
+}
+
+static void keypad_push_event(Keypad_HandleTypeDef* KEYPAD, uint8_t index, uint8_t pressed)
+{
+	uint8_t next = (KEYPAD->EvHead + 1) & (KEYPAD_EVENT_QUEUE - 1);
+	if (next == KEYPAD->EvTail) return; // Full: drop
+
+	KeypadEvent_t* event = &KEYPAD->Events[KEYPAD->EvHead];
+	event->key = KEYPAD->MAP[index / NUMCOLS][index % NUMCOLS];
+	event->index = index;
+	event->pressed = pressed;
+	KEYPAD->EvHead = next;
+}
+
+void Keypad_Update(Keypad_HandleTypeDef* KEYPAD)
+{
+	Keypad_Update_Keys(KEYPAD, Keypad_Scan(KEYPAD));
+}
+
+void Keypad_Update_Keys(Keypad_HandleTypeDef* KEYPAD, uint16_t keys)
+{
+	KEYPAD->Ghosting = keypad_is_ghost(keys);
+	if (KEYPAD->Ghosting) return;
+
+	uint16_t changed = keys ^ KEYPAD->State;
+	// Releases first so a roll A -> B reads "A up, B down"
+	for (uint8_t i = 0; i < NUMROWS * NUMCOLS; i++)
+	{
+		if ((changed & (1u << i)) && !(keys & (1u << i))) keypad_push_event(KEYPAD, i, 0);
+	}
+	for (uint8_t i = 0; i < NUMROWS * NUMCOLS; i++)
+	{
+		if ((changed & (1u << i)) && (keys & (1u << i))) keypad_push_event(KEYPAD, i, 1);
+	}
+	KEYPAD->State = keys;
+}
+
+uint8_t Keypad_Get_Event(Keypad_HandleTypeDef* KEYPAD, KeypadEvent_t* event)
+{
+	if (KEYPAD->EvTail == KEYPAD->EvHead) return 0;
+
+	*event = KEYPAD->Events[KEYPAD->EvTail];
+	KEYPAD->EvTail = (KEYPAD->EvTail + 1) & (KEYPAD_EVENT_QUEUE - 1);
+	return 1;
+}
@@ -0,0 +1,196 @@
+/*
+ * battery_monitor.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ */
+#include "battery_monitor.h"
+#include "main.h"
+#include "global.h"
+#include "scheduler.h"
+
+#define BATTERY_UPDATE_TICKS	(BATTERY_UPDATE_MS / SCH_TICK_MS)
+#define BATTERY_VREFINT_CHANNEL	17
+#define BATTERY_ADC_SMP			7u		// 239.5 cycles, VREFINT needs >= 17.1 us
+
+_Static_assert(BATTERY_OVERSAMPLE * BATTERY_SAMPLE_MS < BATTERY_UPDATE_MS,
+			   "a reading must not span the previous one");
+
+static uint16_t adcBuffer[BATTERY_OVERSAMPLE * BATTERY_ADC_CHANNELS];
+static BatteryFilter_t batteryFilter;
+static uint16_t updateTicks;
+static uint8_t loadSeen;		// Solenoid on during the current reading period
+
+
+uint16_t Battery_Decimate_mV(const uint16_t *buffer, uint16_t scans)
+{
+	uint32_t vrefSum = 0;
+#ifdef BATTERY_DIVIDER_CHANNEL
+	uint32_t inputSum = 0;
+#endif
+
+	for (uint16_t k = 0; k < scans; k++)
+	{
+		vrefSum += buffer[k * BATTERY_ADC_CHANNELS];
+#ifdef BATTERY_DIVIDER_CHANNEL
+		inputSum += buffer[k * BATTERY_ADC_CHANNELS + 1];
+#endif
+	}
+	if (vrefSum == 0) return 0; // Not converted yet
+
+#ifdef BATTERY_DIVIDER_CHANNEL
+	// input / vref = Vinput / 1.20 V: VDDA cancels out
+	return (uint16_t)((uint64_t)inputSum * BATTERY_VREFINT_MV * BATTERY_DIVIDER_RATIO / vrefSum);
+#else
+	// vref = 1.20 V * 4095 / VDDA per scan
+	return (uint16_t)((uint64_t)BATTERY_VREFINT_MV * 4095u * scans / vrefSum);
+#endif
+}
+
+void Battery_Filter_Init(BatteryFilter_t *filter)
+{
+	filter->averageX4 = 0;
+	filter->mV = 0;
+	filter->primed = 0;
+	filter->low = 0;
+	filter->confirm = 0;
+	filter->holdOff = 0;
+}
+
+uint8_t Battery_Filter_Update(BatteryFilter_t *filter, uint16_t mV, uint8_t loaded)
+{
+	// A dip under the solenoid load says nothing about the charge left
+	if (loaded)
+	{
+		filter->holdOff = BATTERY_RECOVERY_READINGS;
+		return filter->low;
+	}
+	if (filter->holdOff > 0)
+	{
+		filter->holdOff--;
+		return filter->low;
+	}
+	if (mV == 0) return filter->low;
+
+	// Moving average over ~4 readings
+	if (!filter->primed)
+	{
+		filter->averageX4 = (uint32_t)mV * 4;
+		filter->primed = 1;
+	} else {
+		filter->averageX4 = filter->averageX4 - filter->averageX4 / 4 + mV;
+	}
+	filter->mV = (uint16_t)(filter->averageX4 / 4);
+
+	// Hysteresis, each crossing confirmed over several readings
+	uint8_t crossing = filter->low ? (filter->mV >= BATTERY_OK_MV) : (filter->mV < BATTERY_LOW_MV);
+	if (!crossing)
+	{
+		filter->confirm = 0;
+	}
+	else if (++filter->confirm >= BATTERY_CONFIRM_READINGS)
+	{
+		filter->low = !filter->low;
+		filter->confirm = 0;
+	}
+	return filter->low;
+}
+
+uint8_t Battery_Filter_Seed(BatteryFilter_t *filter, uint16_t mV)
+{
+	if (mV == 0) return filter->low;
+
+	filter->averageX4 = (uint32_t)mV * 4;
+	filter->mV = mV;
+	filter->primed = 1;
+	filter->confirm = 0;
+	filter->holdOff = 0;
+	filter->low = filter->low ? (mV < BATTERY_OK_MV) : (mV < BATTERY_LOW_MV);
+	return filter->low;
+}
+
+static void adc_sample_time(uint32_t channel)
+{
+	if (channel >= 10)
+		ADC1->SMPR1 |= BATTERY_ADC_SMP << ((channel - 10) * 3);
+	else
+		ADC1->SMPR2 |= BATTERY_ADC_SMP << (channel * 3);
+}
+
+void Battery_Monitor_Init(void)
+{
+	Battery_Filter_Init(&batteryFilter);
+	updateTicks = 0;
+	loadSeen = 0;
+	for (unsigned int k = 0; k < BATTERY_OVERSAMPLE * BATTERY_ADC_CHANNELS; k++) adcBuffer[k] = 0;
+
+	__HAL_RCC_ADC1_CLK_ENABLE();
+	__HAL_RCC_TIM3_CLK_ENABLE();
+	__HAL_RCC_DMA1_CLK_ENABLE();
+	MODIFY_REG(RCC->CFGR, RCC_CFGR_ADCPRE, RCC_CFGR_ADCPRE_DIV2); // 4 MHz ADC clock
+
+	// Power up and calibrate before the trigger is on
+	ADC1->CR2 = ADC_CR2_ADON;
+	for (volatile int i = 0; i < 100; i++) {} // tSTAB
+	ADC1->CR2 |= ADC_CR2_RSTCAL;
+	while (ADC1->CR2 & ADC_CR2_RSTCAL) {}
+	ADC1->CR2 |= ADC_CR2_CAL;
+	while (ADC1->CR2 & ADC_CR2_CAL) {}
+
+	// Regular sequence: VREFINT, then the divider
+	ADC1->SMPR1 = 0;
+	ADC1->SMPR2 = 0;
+	adc_sample_time(BATTERY_VREFINT_CHANNEL);
+	ADC1->SQR1 = (BATTERY_ADC_CHANNELS - 1u) << ADC_SQR1_L_Pos;
+	ADC1->SQR3 = BATTERY_VREFINT_CHANNEL;
+#ifdef BATTERY_DIVIDER_CHANNEL
+	adc_sample_time(BATTERY_DIVIDER_CHANNEL);
+	ADC1->SQR3 |= (uint32_t)BATTERY_DIVIDER_CHANNEL << ADC_SQR3_SQ2_Pos;
+#endif
+	ADC1->CR1 = ADC_CR1_SCAN;
+
+	DMA1_Channel1->CCR = 0;
+	DMA1_Channel1->CPAR = (uint32_t)(uintptr_t)&ADC1->DR;
+	DMA1_Channel1->CMAR = (uint32_t)(uintptr_t)adcBuffer;
+	DMA1_Channel1->CNDTR = BATTERY_OVERSAMPLE * BATTERY_ADC_CHANNELS;
+	DMA1_Channel1->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_PSIZE_0 | DMA_CCR_MSIZE_0 | DMA_CCR_EN;
+
+	// EXTSEL = 100: TIM3 TRGO. Rewriting ADON on its own would start a conversion;
+	// here other CR2 bits change in the same write, so none is started.
+	ADC1->CR2 = ADC_CR2_ADON | ADC_CR2_TSVREFE | ADC_CR2_DMA | ADC_CR2_EXTTRIG | ADC_CR2_EXTSEL_2;
+
+	TIM3->CR1 = 0;
+	TIM3->PSC = SystemCoreClock / 10000 - 1;	// 10 kHz (APB1 prescaler 1)
+	TIM3->ARR = 10 * BATTERY_SAMPLE_MS - 1;
+	TIM3->CR2 = TIM_CR2_MMS_1;					// TRGO on update
+	TIM3->EGR = TIM_EGR_UG;
+	TIM3->CR1 = TIM_CR1_CEN;
+}
+
+uint8_t Battery_Monitor_Process(void)
+{
+	if (gOutputStatus.solenoid == SOLENOID_UNLOCKED) loadSeen = 1;
+	if (++updateTicks < BATTERY_UPDATE_TICKS) return batteryFilter.low;
+
+	updateTicks = 0;
+	uint8_t low = Battery_Filter_Update(&batteryFilter,
+										Battery_Decimate_mV(adcBuffer, BATTERY_OVERSAMPLE), loadSeen);
+	loadSeen = (gOutputStatus.solenoid == SOLENOID_UNLOCKED);
+	return low;
+}
+
+/* The buffer kept filling during standby with the solenoid off: 64 scans
+ * of a rested battery, already averaged by the decimation.
+ */
+void Battery_Monitor_Wake(void)
+{
+	updateTicks = 0;
+	loadSeen = (gOutputStatus.solenoid == SOLENOID_UNLOCKED);
+	if (loadSeen) return;
+	Battery_Filter_Seed(&batteryFilter, Battery_Decimate_mV(adcBuffer, BATTERY_OVERSAMPLE));
+}
+
+uint16_t Battery_Monitor_mV(void)
+{
+	return batteryFilter.mV;
+}
@@ -9,6 +9,7 @@
 #define SRC_GLOBAL_C_
 
 #include "global.h"
+#include "state_processing.h"
 #include <string.h>
 
 Keypad_HandleTypeDef hKeypad;
@@ -30,10 +31,13 @@ SystemState_t gSystemState;
 char gPassword[PASSWORD_LENGTH + 1];
 char inputBuffer[MAX_INPUT_LENGTH + 1];
 
-int timer_counter[NUM_TASKS];
-int timer_flag[NUM_TASKS];
+int gWarningTimer = TIMER_NONE;
+int gEntryTimeoutTimer = TIMER_NONE;
+int gUnlockWindowTimer = TIMER_NONE;
+int gMaskTimer = TIMER_NONE;
+int gCharMaskTimer = TIMER_NONE;
+int gDoorNotifyTimer = TIMER_NONE;
 int TIMER_CYCLE = 10;
-char last_keypad_char;
 uint8_t last_enter_state;
 uint8_t last_backspace_state;
 uint8_t last_door_btn_state;
@@ -57,12 +61,22 @@ void init_global_variables(void)
     gOutputStatus.ledRed = LED_OFF;
     gOutputStatus.solenoid = SOLENOID_LOCKED;
     gOutputStatus.buzzer = BUZZER_OFF;
+    gOutputStatus.solenoidCauseMs = 0;
+    gOutputStatus.solenoidCause = 0;
     memset(gOutputStatus.lcdLine1, ' ', 16); gOutputStatus.lcdLine1[16] = 0;
     memset(gOutputStatus.lcdLine2, ' ', 16); gOutputStatus.lcdLine2[16] = 0;
 
     // State
     gSystemState.currentState = LOCKED_SLEEP;
 
+    // Timers (polled through timerExpired / timerRunning), the FSM ones wake State_Process
+    if (gWarningTimer == TIMER_NONE) gWarningTimer = timerCreate(State_Event_Timer, 0);
+    if (gEntryTimeoutTimer == TIMER_NONE) gEntryTimeoutTimer = timerCreate(State_Event_Timer, 0);
+    if (gUnlockWindowTimer == TIMER_NONE) gUnlockWindowTimer = timerCreate(State_Event_Timer, 0);
+    if (gMaskTimer == TIMER_NONE) gMaskTimer = timerCreate(State_Event_Timer, 0);
+    if (gCharMaskTimer == TIMER_NONE) gCharMaskTimer = timerCreate(NULL, 0);
+    if (gDoorNotifyTimer == TIMER_NONE) gDoorNotifyTimer = timerCreate(NULL, 0);
+
     // Default Password: 1234
     strcpy(gPassword, "1234");
     inputBuffer[0] = '\0';
@@ -85,32 +85,57 @@ void lcd_gotoxy(I2C_LCD_HandleTypeDef *lcd, int col, int row)
 }
 
 /**
- * @brief Initializes the LCD in 4-bit mode.
+ * @brief Power-up sequence for 4-bit mode: command, then wait (ms).
+ */
+static const uint8_t lcd_init_seq[][2] = {
+	{ 0x30, 5 },   // Wake up command
+	{ 0x30, 1 },   // Wake up command
+	{ 0x30, 10 },  // Wake up command
+	{ 0x20, 10 },  // Set to 4-bit mode
+	// LCD configuration commands
+	{ 0x28, 1 },   // 4-bit mode, 2 lines, 5x8 font
+	{ 0x08, 1 },   // Display off, cursor off, blink off
+	{ 0x01, 2 },   // Clear display
+	{ 0x06, 1 },   // Entry mode: cursor moves right
+	{ 0x0C, 0 },   // Display on, cursor off, blink off
+};
+#define LCD_POWER_UP_MS		50
+#define LCD_INIT_STEPS		(sizeof(lcd_init_seq) / sizeof(lcd_init_seq[0]))
+
+/**
+ * @brief Initializes the LCD in 4-bit mode (blocking, ~81 ms).
  * @param lcd: Pointer to the LCD handle
  * @retval None
  */
 void lcd_init(I2C_LCD_HandleTypeDef *lcd)
 {
-	HAL_Delay(50);  // Wait for LCD power-up
-	lcd_send_cmd(lcd, 0x30);  // Wake up command
-	HAL_Delay(5);
-	lcd_send_cmd(lcd, 0x30);  // Wake up command
-	HAL_Delay(1);
-	lcd_send_cmd(lcd, 0x30);  // Wake up command
-	HAL_Delay(10);
-	lcd_send_cmd(lcd, 0x20);  // Set to 4-bit mode
-	HAL_Delay(10);
+	HAL_Delay(LCD_POWER_UP_MS);  // Wait for LCD power-up
+	for (uint8_t i = 0; i < LCD_INIT_STEPS; i++)
+	{
+		lcd_send_cmd(lcd, lcd_init_seq[i][0]);
+		if (lcd_init_seq[i][1] > 0) HAL_Delay(lcd_init_seq[i][1]);
+	}
+}
 
-	// LCD configuration commands
-	lcd_send_cmd(lcd, 0x28);  // 4-bit mode, 2 lines, 5x8 font
-	HAL_Delay(1);
-	lcd_send_cmd(lcd, 0x08);  // Display off, cursor off, blink off
-	HAL_Delay(1);
-	lcd_send_cmd(lcd, 0x01);  // Clear display
-	HAL_Delay(2);
-	lcd_send_cmd(lcd, 0x06);  // Entry mode: cursor moves right
-	HAL_Delay(1);
-	lcd_send_cmd(lcd, 0x0C);  // Display on, cursor off, blink off
+/**
+ * @brief Same sequence as lcd_init as a protothread: call it from a scheduler
+ *        task until it stops returning PT_WAITING. The display ends up cleared.
+ * @param pt: Protothread state, PT_INIT it to (re)start the sequence
+ * @param lcd: Pointer to the LCD handle
+ * @retval PT_WAITING while running, PT_ENDED when the LCD is ready
+ */
+char lcd_init_pt(pt_t *pt, I2C_LCD_HandleTypeDef *lcd)
+{
+	static uint8_t step;  // Kept across waits, one sequence at a time
+
+	PT_BEGIN(pt);
+	PT_SLEEP_MS(pt, LCD_POWER_UP_MS);  // Wait for LCD power-up
+	for (step = 0; step < LCD_INIT_STEPS; step++)
+	{
+		lcd_send_cmd(lcd, lcd_init_seq[step][0]);
+		if (lcd_init_seq[step][1] > 0) PT_SLEEP_MS(pt, lcd_init_seq[step][1]);
+	}
+	PT_END(pt);
 }
 
 /**
@@ -11,69 +11,74 @@
 #include "keypad.h"
 #include "global.h"
 #include "i2c_lcd.h"
+#include "key_queue.h"
+#include "state_processing.h"
+#include "battery_monitor.h"
 #include <string.h>
 // --- Static variables for edge detection ---
-//static char last_keypad_char;
 //static uint8_t last_enter_state;
 //static uint8_t last_backspace_state;
 //static uint8_t last_door_btn_state;
+static uint8_t last_enter_long_state;
+static uint8_t last_key_sensor_state;
+static uint8_t last_indoor_state;
+static uint8_t last_indoor_long_state;
 
 void Input_Init(void) {
-    last_keypad_char = 0;
     last_enter_state = 0;
     last_backspace_state = 0;
     last_door_btn_state = 0;
+    last_enter_long_state = 0;
+    last_key_sensor_state = 0;
+    last_indoor_state = 0;
+    last_indoor_long_state = 0;
+    KeyQueue_Init();
+    Battery_Monitor_Init();
 }
 
 void Input_Process(void) {
 
     // --- Handle Keypad 4x4 (Char Input) ---
-    char current_key = Keypad_Readkey(&hKeypad);
-
-    /* Edge Logic for Keypad:
-     * 1. current_key must not be 0 (a key is pressed).
-     * 2. current_key must differ from last_keypad_char.
-     * This handles:
-     * - Pressing a key (0 -> 'A'): Trigger 'A'.
-     * - Holding 'A' ('A' -> 'A'): Ignored.
-     * - Sliding to 'B' without release ('A' -> 'B'): Trigger 'B'.
+    /* Every key has its own press/release event (n-key rollover), so
+     * overlapping presses of a fast typist all come out, in press order.
+     * All presses are posted to the FSM event queue: State_Process takes as
+     * many as it can use and keeps the rest while it is busy.
      */
-    if (current_key != 0 && current_key != last_keypad_char)
+    KeypadEvent_t keyEvent;
+    Keypad_Update_Keys(&hKeypad, keypad_keys_debounced()); // Scanned and debounced by button_reading
+
+    while (Keypad_Get_Event(&hKeypad, &keyEvent))
     {
-        gKeyEvent.keyChar = current_key; // Post event
-    } else {
-        gKeyEvent.keyChar = 0; // Clear event slot
+        if (keyEvent.pressed)
+        {
+            State_Event_KeypadChar(keyEvent.key, keypad_edge_ms(keyEvent.index));
+        }
     }
-    last_keypad_char = current_key; // Update history
 
     // --- Handle Enter Button (Edge + Long Press) ---
     uint8_t enter_curr = is_button_pressed(ENTER_BUTTON_INDEX);
     uint8_t enter_long = is_button_pressed_1s(ENTER_BUTTON_INDEX);
 
-    // Reset flags
-    gKeyEvent.isEnter = 0;
-    gKeyEvent.isEnterLong = 0;
-
     // Single press detection (Rising Edge: 0 -> 1)
     if (enter_curr == 1 && last_enter_state == 0) {
-        gKeyEvent.isEnter = 1;
+        State_Event_Enter(button_edge_ms(ENTER_BUTTON_INDEX));
     }
 
-    // Long press detection (Handled by input_reading timer)
-    if (enter_long == 1)
+    // Long press detection (Handled by input_reading timer), once per hold
+    if (enter_long == 1 && last_enter_long_state == 0)
     {
-        gKeyEvent.isEnterLong = 1;
+        State_Event_Enter_Long(HAL_GetTick());
     }
     last_enter_state = enter_curr;
+    last_enter_long_state = enter_long;
 
     // --- Handle Backspace Button (Edge only) ---
     uint8_t back_curr = is_button_pressed(BACKSPACE_BUTTON_INDEX);
-    gKeyEvent.isBackspace = 0;
 
     // Single press detection (Rising Edge: 0 -> 1)
     if (back_curr == 1 && last_backspace_state == 0)
     {
-        gKeyEvent.isBackspace = 1;
+        State_Event_Backspace(button_edge_ms(BACKSPACE_BUTTON_INDEX));
     }
     last_backspace_state = back_curr;
 
@@ -83,18 +88,34 @@ void Input_Process(void) {
 	if (current_door_btn == 1 && last_door_btn_state == 0) {
 		if (gInputState.doorSensor == 0) {
 			gInputState.doorSensor = 1;
+			State_Event_DoorSensor_Close(button_edge_ms(DOOR_SENSOR_INDEX));
 		} else {
 			gInputState.doorSensor = 0;
+			State_Event_DoorSensor_Open(button_edge_ms(DOOR_SENSOR_INDEX));
 		}
 		// 100 ticks to dislay notify change state
-		setTimer(DOOR_NOTIFY_TIMER_ID, 1000);
+		setTimer(gDoorNotifyTimer, 1000);
 	}
 	last_door_btn_state = current_door_btn;
 
-    // Mechanical Key Sensor
-    gInputState.keySensor = is_button_pressed(KEY_SENSOR_INDEX);
+    // Mechanical Key Sensor (Rising Edge)
+    uint8_t key_sensor = is_button_pressed(KEY_SENSOR_INDEX);
+    if (key_sensor && !last_key_sensor_state) State_Event_KeySensor(button_edge_ms(KEY_SENSOR_INDEX));
+    last_key_sensor_state = key_sensor;
 
-    // Indoor Unlock Button
-    gInputState.indoorButton = is_button_pressed(INDOOR_BUTTON_INDEX);
-    gInputState.indoorButtonLong = is_button_pressed_1s(INDOOR_BUTTON_INDEX);
+    // Indoor Unlock Button (Rising Edge + Long Press once per hold)
+    uint8_t indoor = is_button_pressed(INDOOR_BUTTON_INDEX);
+    uint8_t indoor_long = is_button_pressed_1s(INDOOR_BUTTON_INDEX);
+    if (indoor && !last_indoor_state) State_Event_IndoorButton(button_edge_ms(INDOOR_BUTTON_INDEX));
+    if (indoor_long && !last_indoor_long_state) State_Event_IndoorButton_Long(HAL_GetTick());
+    last_indoor_state = indoor;
+    last_indoor_long_state = indoor_long;
+
+    // Battery (ADC1 runs by itself, filtered once a second)
+    uint8_t battery_low = Battery_Monitor_Process();
+    if (battery_low != gInputState.batteryLow)
+    {
+        gInputState.batteryLow = battery_low;
+        State_Event_Battery();
+    }
 }
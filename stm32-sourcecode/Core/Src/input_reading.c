@@ -5,83 +5,413 @@
  *      Author: nguye
  */
 #include "input_reading.h"
+#include "keypad.h"
+#include "scheduler.h"
 
+/* Debouncing
+ * All inputs are sampled into one word, pressed = 1: the discrete buttons
+ * on bits 0..N0_OF_BUTTONS-1 (by index), the keypad keys on the upper half
+ * (KEYPAD_KEY_BIT << INPUT_KEYPAD_SHIFT).
+ * A 5-bit vertical counter (one bitplane per counter bit) counts, for
+ * every input at once, the consecutive samples that differ from its
+ * debounced state. An input changes when its count reaches its own
+ * threshold, a sample equal to the state resets the count.
+ * With INPUT_DMA_SAMPLING the buttons are sampled every 1 ms by DMA and
+ * debounced snapshot by snapshot, the keypad is still scanned by tick, at
+ * the rate the governor below sets for the FSM state.
+ */
+#define INPUT_KEYPAD_SHIFT		16
+#define INPUT_KEYPAD_BITS		(0xFFFFu << INPUT_KEYPAD_SHIFT)
+#define INPUT_BUTTON_BITS		((1u << N0_OF_BUTTONS) - 1)
+#define INPUT_DEBOUNCE_MAX		31	// 5-bit counter
+#define KEYPAD_DEBOUNCE_MS		20
+#define INPUT_WAKE_SETTLE_MS	5	// Bounce window after a wake-up edge
 
+#define KEYPAD_SCAN_HOLD_TICKS	(500 / SCH_TICK_MS)	// Full rate after the last key activity
 
-// Debouncing
-static GPIO_PinState buttonBuffer[N0_OF_BUTTONS];
-//define two buffers for debouncing
-static GPIO_PinState debounceButtonBuffer1[N0_OF_BUTTONS];
-static GPIO_PinState debounceButtonBuffer2[N0_OF_BUTTONS];
-//define a flag for a button pressed more than 1 second.
-static uint8_t flagForButtonPress1s[N0_OF_BUTTONS];
-//define counter for automatically increasing the value
-//after the button is pressed more than 1 second.
-static uint16_t counterForButtonPress1s[N0_OF_BUTTONS];
+#if INPUT_DMA_SAMPLING
+#define BUTTON_SAMPLE_MS		1	// TIM4 -> DMA1 snapshot period
+#else
+#define BUTTON_SAMPLE_MS		SCH_TICK_MS
+#endif
 
-void input_reading_init(void){
-	for (int i = 0; i < N0_OF_BUTTONS; i++) {
-		buttonBuffer[i] = GPIO_PIN_SET;          // Mặc định là NHẢ (Release)
-		debounceButtonBuffer1[i] = GPIO_PIN_SET;
-		debounceButtonBuffer2[i] = GPIO_PIN_SET;
-		flagForButtonPress1s[i] = 0;
-		counterForButtonPress1s[i] = 0;
+typedef struct {
+	GPIO_TypeDef *port;
+	uint16_t pin;
+	uint8_t debounceMs;		// Time a change must last
+	uint16_t longPress;		// Ticks held for is_button_pressed_1s, 0 = not used
+} ButtonConfig_t;
+
+static const ButtonConfig_t buttonConfig[N0_OF_BUTTONS] = {
+	[DOOR_SENSOR_INDEX]			= { DOOR_SENSOR_GPIO_Port,	DOOR_SENSOR_Pin,	30, 0 },	// Reed contact bounces longer
+	[KEY_SENSOR_INDEX]			= { KEY_SENSOR_GPIO_Port,	KEY_SENSOR_Pin,		20, 0 },
+	[INDOOR_BUTTON_INDEX]		= { BUTTON_GPIO_Port,		BUTTON_Pin,			20, DURATION_FOR_AUTO_INCREASING },
+	[ENTER_BUTTON_INDEX]		= { ENTER_GPIO_Port,		ENTER_Pin,			20, DURATION_FOR_AUTO_INCREASING },
+	[BACKSPACE_BUTTON_INDEX]	= { BACKSPACE_GPIO_Port,	BACKSPACE_Pin,		20, 0 },
+};
+
+/* Scan-rate governor
+ * Keypad scan period per FSM state, in ticks, 0 = not scanned. Full rate
+ * where keys are used or queued for later, slower in LOCKED_SLEEP (a press
+ * lasts far longer than 2 ticks), slow where keys are dropped but the state
+ * soon hands over to one that reads them, off where they are never read.
+ * Any key seen by a scan, or still debounced as pressed, keeps the full
+ * rate for KEYPAD_SCAN_HOLD_TICKS, so a press is debounced at the normal
+ * rate and its release is always seen (in states that are not scanned,
+ * only until the keys held on entry are released).
+ */
+static const uint8_t keypadScanTicks[LOCKED_RELOCK + 1] = {
+	[0]						= 1,
+	[LOCKED_SLEEP]			= 2,
+	[LOCKED_WAKEUP]			= 1,
+	[BATTERY_WARNING]		= 1,
+	[LOCKED_ENTRY]			= 1,
+	[LOCKED_VERIFY]			= 1,
+	[PENALTY_TIMER]			= 10,
+	[PERMANENT_LOCKOUT]		= 0,
+	[UNLOCKED_WAITOPEN]		= 10,
+	[UNLOCKED_SETPASSWORD]	= 1,
+	[UNLOCKED_DOOROPEN]		= 10,
+	[ALARM_FORGOTCLOSE]		= 10,
+	[UNLOCKED_WAITCLOSE]	= 10,
+	[UNLOCKED_ALWAYSOPEN]	= 0,
+	[LOCKED_RELOCK]			= 10,
+};
+
+_Static_assert(N0_OF_BUTTONS <= INPUT_KEYPAD_SHIFT, "buttons overlap the keypad bits");
+_Static_assert(NUMROWS * NUMCOLS <= 32 - INPUT_KEYPAD_SHIFT, "keypad bits must fit in the word");
+
+static uint32_t debouncedState;				// 1 = pressed
+static uint32_t count0, count1, count2, count3, count4;		// Vertical counter bitplanes
+static uint32_t thresh0, thresh1, thresh2, thresh3, thresh4;	// Per-input threshold bitplanes
+static uint32_t longPressState;				// 1 = held past its longPress
+static uint16_t holdTicks[N0_OF_BUTTONS];
+static uint32_t edgeMs[N0_OF_BUTTONS];		// HAL_GetTick time of the last change
+static uint32_t keyEdgeMs[NUMROWS * NUMCOLS];	// Scan time each keypad key began to change
+static uint16_t keysChanging;				// Keys read different from their state
+static uint8_t wakePrimed;					// Edge seen while in standby
+static uint32_t wakeEdgeMs;
+static uint8_t scanWait;					// Ticks to the next governed scan
+static uint8_t scanHold;					// Full-rate ticks left
+static uint8_t bootScanned;					// First keypad scan since input_reading_init done
+static uint32_t bootScanMs;
+
+static void set_threshold(uint32_t bits, uint32_t samples)
+{
+	if (samples < 1) samples = 1;
+	if (samples > INPUT_DEBOUNCE_MAX) samples = INPUT_DEBOUNCE_MAX;
+	thresh0 = (samples & 1) ? (thresh0 | bits) : (thresh0 & ~bits);
+	thresh1 = (samples & 2) ? (thresh1 | bits) : (thresh1 & ~bits);
+	thresh2 = (samples & 4) ? (thresh2 | bits) : (thresh2 & ~bits);
+	thresh3 = (samples & 8) ? (thresh3 | bits) : (thresh3 & ~bits);
+	thresh4 = (samples & 16) ? (thresh4 | bits) : (thresh4 & ~bits);
+}
+
+static void clear_counts(uint32_t bits)
+{
+	count0 &= ~bits;
+	count1 &= ~bits;
+	count2 &= ~bits;
+	count3 &= ~bits;
+	count4 &= ~bits;
+}
+
+/* Debounce the 'mask' inputs of one sample at once, returns the inputs that changed */
+static uint32_t debounce_sample(uint32_t sample, uint32_t mask)
+{
+	uint32_t delta = (sample ^ debouncedState) & mask;
+	uint32_t keep = ~mask;	// Inputs not in this sample keep their count
+
+	// Count up where the sample differs, back to 0 where it agrees
+	uint32_t c01 = count0 & count1;
+	uint32_t c012 = c01 & count2;
+	count4 = (count4 & keep) | ((count4 ^ (c012 & count3)) & delta);
+	count3 = (count3 & keep) | ((count3 ^ c012) & delta);
+	count2 = (count2 & keep) | ((count2 ^ c01) & delta);
+	count1 = (count1 & keep) | ((count1 ^ count0) & delta);
+	count0 = (count0 & keep) | (~count0 & delta);
+
+	uint32_t reached = delta & ~((count0 ^ thresh0) | (count1 ^ thresh1) | (count2 ^ thresh2) |
+								 (count3 ^ thresh3) | (count4 ^ thresh4));
+	debouncedState ^= reached;
+	clear_counts(reached);
+	return reached;
+}
+
+/* Button bits of one sample taken at 'nowMs': keep the time each change began */
+static void debounce_buttons(uint32_t sample, uint32_t nowMs)
+{
+	uint32_t changed = debounce_sample(sample, INPUT_BUTTON_BITS);
+	for (uint8_t i = 0; changed != 0; i++, changed >>= 1)
+	{
+		if (changed & 1u)
+			edgeMs[i] = nowMs - (buttonConfig[i].debounceMs / BUTTON_SAMPLE_MS - 1) * BUTTON_SAMPLE_MS;
 	}
 }
+
+/* The wake-up edge counts as the first sample: inputs read pressed
+ * INPUT_WAKE_SETTLE_MS or more after it are accepted at once, samples inside
+ * the bounce window are not used.
+ */
+static uint32_t wake_sample(uint32_t sample, uint32_t mask)
+{
+	if (HAL_GetTick() - wakeEdgeMs < INPUT_WAKE_SETTLE_MS)
+		return debouncedState;
+
+	wakePrimed = 0;
+	uint32_t pressed = sample & ~debouncedState & mask;
+	debouncedState |= pressed;
+	clear_counts(pressed);
+	// Pressed at the wake-up edge
+	for (uint8_t i = 0; i < N0_OF_BUTTONS; i++)
+	{
+		if (pressed & (1u << i)) edgeMs[i] = wakeEdgeMs;
+	}
+	for (uint8_t i = 0; i < NUMROWS * NUMCOLS; i++)
+	{
+		if (pressed & (1u << (i + INPUT_KEYPAD_SHIFT))) keyEdgeMs[i] = wakeEdgeMs;
+	}
+	return sample;
+}
+
+static uint8_t keypad_scan_due(void)
+{
+	uint8_t state = gSystemState.currentState;
+	uint8_t period = (state <= LOCKED_RELOCK) ? keypadScanTicks[state] : 1;
+
+	// Keys left pressed from the previous state: follow them to release
+	if (period == 0) return keypad_keys_debounced() != 0;
+	if (period == 1 || scanHold > 0 || wakePrimed)
+	{
+		scanWait = 0;
+		return 1;
+	}
+	if (scanWait > 0)
+	{
+		scanWait--;
+		return 0;
+	}
+	scanWait = period - 1;
+	return 1;
+}
+
+void input_reading_wake(void)
+{
+	wakeEdgeMs = HAL_GetTick();
+	wakePrimed = 1;
+}
+
 GPIO_PinState read_button(int index)
 {
-    switch (index)
-    {
-        case DOOR_SENSOR_INDEX:
-        	return HAL_GPIO_ReadPin(DOOR_SENSOR_GPIO_Port, DOOR_SENSOR_Pin);
-        case KEY_SENSOR_INDEX:
-        	return HAL_GPIO_ReadPin(KEY_SENSOR_GPIO_Port, KEY_SENSOR_Pin);
-        case INDOOR_BUTTON_INDEX:
-        	return HAL_GPIO_ReadPin(BUTTON_GPIO_Port, BUTTON_Pin);
-        case ENTER_BUTTON_INDEX:
-        	return HAL_GPIO_ReadPin(ENTER_GPIO_Port, ENTER_Pin);
-        case BACKSPACE_BUTTON_INDEX:
-        	return HAL_GPIO_ReadPin(BACKSPACE_GPIO_Port, BACKSPACE_Pin);
-        default:
-        	return GPIO_PIN_SET;
-    }
+	if (index < 0 || index >= N0_OF_BUTTONS) return BUTTON_IS_RELEASED;
+	return (buttonConfig[index].port->IDR & buttonConfig[index].pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
 }
 
+/* Button bits (pressed = 1) of one GPIOB / GPIOC snapshot */
+static uint32_t buttons_from_ports(uint16_t portB, uint16_t portC)
+{
+	uint32_t sample = 0;
+	for (int i = 0; i < N0_OF_BUTTONS; i++)
+	{
+		uint16_t idr = (buttonConfig[i].port == GPIOB) ? portB : portC;
+		if ((idr & buttonConfig[i].pin) == 0) sample |= 1u << i; // Active low
+	}
+	return sample;
+}
+
+void button_reading_batch(const uint16_t *portB, const uint16_t *portC, uint16_t count, uint32_t lastMs)
+{
+	for (uint16_t k = 0; k < count; k++)
+	{
+		debounce_buttons(buttons_from_ports(portB[k], portC[k]),
+						 lastMs - (uint32_t)(count - 1 - k) * BUTTON_SAMPLE_MS);
+	}
+}
+
+#if INPUT_DMA_SAMPLING
+/* TIM4 at 1 kHz: its update event triggers DMA1 channel 7 (GPIOB->IDR) and
+ * its CC2 event, at the same counter value, DMA1 channel 4 (GPIOC->IDR);
+ * channel 1 is the only one ADC1 can use (battery_monitor).
+ * IDR is read as a word and stored as a half-word, into circular buffers.
+ */
+static uint16_t dmaPortB[INPUT_DMA_SAMPLES];
+static uint16_t dmaPortC[INPUT_DMA_SAMPLES];
+static uint16_t dmaRead;		// Next snapshot to process
+static uint32_t dmaLastMs;		// HAL_GetTick of the previous batch
+
+static void dma_channel_start(DMA_Channel_TypeDef *ch, volatile uint32_t *idr, uint16_t *buffer)
+{
+	ch->CCR = 0;
+	ch->CPAR = (uint32_t)(uintptr_t)idr;
+	ch->CMAR = (uint32_t)(uintptr_t)buffer;
+	ch->CNDTR = INPUT_DMA_SAMPLES;
+	ch->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_PSIZE_1 | DMA_CCR_MSIZE_0 | DMA_CCR_PL_0 | DMA_CCR_EN;
+}
+
+static void input_dma_start(void)
+{
+	for (int k = 0; k < INPUT_DMA_SAMPLES; k++)
+	{
+		dmaPortB[k] = 0xFFFF; // Released
+		dmaPortC[k] = 0xFFFF;
+	}
+	__HAL_RCC_DMA1_CLK_ENABLE();
+	__HAL_RCC_TIM4_CLK_ENABLE();
+	dma_channel_start(DMA1_Channel7, &GPIOB->IDR, dmaPortB);
+	dma_channel_start(DMA1_Channel4, &GPIOC->IDR, dmaPortC);
+
+	TIM4->CR1 = 0;
+	TIM4->PSC = SystemCoreClock / 1000000 - 1;	// 1 MHz (APB1 prescaler 1)
+	TIM4->ARR = 1000 * BUTTON_SAMPLE_MS - 1;
+	TIM4->CCR2 = 0;
+	TIM4->EGR = TIM_EGR_UG;						// Load PSC before the requests are on
+	TIM4->SR = 0;
+	TIM4->DIER = TIM_DIER_UDE | TIM_DIER_CC2DE;
+	TIM4->CR1 = TIM_CR1_CEN;
+
+	dmaRead = 0;
+	dmaLastMs = HAL_GetTick();
+}
+
+/* Snapshots written since the last batch, up to the slower of the channels */
+static uint16_t dma_pending(void)
+{
+	uint16_t writeB = (INPUT_DMA_SAMPLES - DMA1_Channel7->CNDTR) % INPUT_DMA_SAMPLES;
+	uint16_t writeC = (INPUT_DMA_SAMPLES - DMA1_Channel4->CNDTR) % INPUT_DMA_SAMPLES;
+	uint16_t newB = (uint16_t)(writeB + INPUT_DMA_SAMPLES - dmaRead) % INPUT_DMA_SAMPLES;
+	uint16_t newC = (uint16_t)(writeC + INPUT_DMA_SAMPLES - dmaRead) % INPUT_DMA_SAMPLES;
+	return (newB < newC) ? newB : newC;
+}
+
+static void input_dma_collect(void)
+{
+	uint32_t now = HAL_GetTick();
+	uint16_t count = dma_pending();
+
+	// Away longer than the buffer (standby, long task): older snapshots are gone
+	if (now - dmaLastMs >= INPUT_DMA_SAMPLES - 1 && count > 1)
+	{
+		dmaRead = (dmaRead + count - 1) % INPUT_DMA_SAMPLES;
+		count = 1;
+	}
+	dmaLastMs = now;
+
+	// Up to the end of the buffer, then from its start
+	uint16_t first = INPUT_DMA_SAMPLES - dmaRead;
+	if (first > count) first = count;
+	button_reading_batch(&dmaPortB[dmaRead], &dmaPortC[dmaRead], first, now - (count - first));
+	button_reading_batch(dmaPortB, dmaPortC, count - first, now);
+	dmaRead = (dmaRead + count) % INPUT_DMA_SAMPLES;
+}
+#endif /* INPUT_DMA_SAMPLING */
+
+void input_reading_init(void){
+	debouncedState = 0;	// Released
+	clear_counts(0xFFFFFFFF);
+	longPressState = 0;
+	keysChanging = 0;
+	wakePrimed = 0;
+	scanWait = 0;
+	scanHold = 0;
+	bootScanned = 0;
+	bootScanMs = 0;
+	thresh0 = thresh1 = thresh2 = thresh3 = thresh4 = 0;
+	for (int i = 0; i < N0_OF_BUTTONS; i++) {
+		set_threshold(1u << i, buttonConfig[i].debounceMs / BUTTON_SAMPLE_MS);
+		holdTicks[i] = 0;
+		edgeMs[i] = 0;
+	}
+	set_threshold(INPUT_KEYPAD_BITS, KEYPAD_DEBOUNCE_MS / SCH_TICK_MS);
+#if INPUT_DMA_SAMPLING
+	input_dma_start();
+#endif
+}
 
 void button_reading(void) {
+	uint32_t sample = 0;
+	uint8_t scanned = keypad_scan_due();
+
+	if (scanned)
+	{
+		uint16_t keys = Keypad_Scan(&hKeypad);
+		if (!bootScanned)
+		{
+			bootScanMs = HAL_GetTick();
+			bootScanned = 1;
+		}
+		if (keys != 0 || keypad_keys_debounced() != 0) scanHold = KEYPAD_SCAN_HOLD_TICKS;
+		else if (scanHold > 0) scanHold--;
+		sample = (uint32_t)keys << INPUT_KEYPAD_SHIFT;
+
+		// First scan of each change: the time the key went down / up
+		uint16_t changing = keys ^ keypad_keys_debounced();
+		uint16_t started = changing & ~keysChanging;
+		keysChanging = changing;
+		for (uint8_t i = 0; started != 0; i++, started >>= 1)
+		{
+			if (started & 1u) keyEdgeMs[i] = HAL_GetTick();
+		}
+	}
+
+#if INPUT_DMA_SAMPLING
+	input_dma_collect();
+	if (wakePrimed) sample = wake_sample(sample, INPUT_KEYPAD_BITS);
+#else
+	// Buttons are sampled with the keypad, once per tick
+	for (int i = 0; i < N0_OF_BUTTONS; i++)
+	{
+		if (read_button(i) == BUTTON_IS_PRESSED) sample |= 1u << i;
+	}
+	if (wakePrimed) sample = wake_sample(sample, INPUT_KEYPAD_BITS | INPUT_BUTTON_BITS);
+	debounce_buttons(sample, HAL_GetTick());
+#endif
+	// Keypad counts only move on scanned ticks
+	if (scanned) debounce_sample(sample, INPUT_KEYPAD_BITS);
+
+	// Long press: per-button hold counters, only for buttons that use one
 	for (uint8_t i = 0; i < N0_OF_BUTTONS; i++)
 	{
-		debounceButtonBuffer2[i] = debounceButtonBuffer1[i];
-		debounceButtonBuffer1[i] = read_button(i);
-		if (debounceButtonBuffer1[i] == debounceButtonBuffer2[i])
+		if (buttonConfig[i].longPress == 0) continue;
+		if (debouncedState & (1u << i))
 		{
-			buttonBuffer[i] = debounceButtonBuffer1[i];
-			if (buttonBuffer[i] == BUTTON_IS_PRESSED)
-			{
-				 //if a button is pressed, we start counting
-				 if(counterForButtonPress1s[i] < DURATION_FOR_AUTO_INCREASING){
-					 counterForButtonPress1s[i]++;
-				 } else {
-					 //the flag is turned on when 1 second has passed
-					 //since the button is pressed.
-					 flagForButtonPress1s[i] = 1;
-					 //todo
-				 }
-			} else {
-				 counterForButtonPress1s[i] = 0;
-				 flagForButtonPress1s[i] = 0;
-			}
+			if (holdTicks[i] < buttonConfig[i].longPress) holdTicks[i]++;
+			if (holdTicks[i] >= buttonConfig[i].longPress) longPressState |= 1u << i;
+		} else {
+			holdTicks[i] = 0;
+			longPressState &= ~(1u << i);
 		}
 	}
 }
 
 unsigned int is_button_pressed(unsigned int index) {
 	if(index >= N0_OF_BUTTONS) return 0;
-	return (buttonBuffer[index] == BUTTON_IS_PRESSED);
+	return (debouncedState >> index) & 1u;
 }
 
 
 unsigned int is_button_pressed_1s(unsigned int index){
 	if(index >= N0_OF_BUTTONS) return 0;
-	return (flagForButtonPress1s[index] == 1);
+	return (longPressState >> index) & 1u;
+}
+
+uint32_t button_edge_ms(unsigned int index)
+{
+	if(index >= N0_OF_BUTTONS) return 0;
+	return edgeMs[index];
+}
+
+uint32_t keypad_edge_ms(uint8_t index)
+{
+	if (index >= NUMROWS * NUMCOLS) return 0;
+	return keyEdgeMs[index];
+}
+
+uint32_t input_reading_boot_scan_ms(void)
+{
+	return bootScanMs;
+}
+
+uint16_t keypad_keys_debounced(void)
+{
+	return (uint16_t)(debouncedState >> INPUT_KEYPAD_SHIFT);
 }
@@ -0,0 +1,78 @@
+/*
+ * key_queue.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ */
+#include "key_queue.h"
+
+#if defined(__arm__)
+#include "main.h" // CMSIS __DMB
+#define KEYQ_BARRIER()	__DMB()
+#else
+#include <stdatomic.h>
+#define KEYQ_BARRIER()	atomic_thread_fence(memory_order_seq_cst)
+#endif
+
+_Static_assert((KEY_QUEUE_SIZE & (KEY_QUEUE_SIZE - 1)) == 0, "KEY_QUEUE_SIZE must be a power of two");
+_Static_assert(KEY_QUEUE_SIZE <= 128, "free running uint8_t indices");
+
+#define KEYQ_MASK		(KEY_QUEUE_SIZE - 1)
+
+static KeyQueueEvent_t keyQueue[KEY_QUEUE_SIZE];
+static volatile uint8_t keyHead;	// Next slot to write, producer only
+static volatile uint8_t keyTail;	// Next slot to read, consumer only
+static KeyQueueStats_t keyStats;	// Written by the producer
+
+
+void KeyQueue_Init(void)
+{
+	keyHead = 0;
+	keyTail = 0;
+	keyStats.pushed = 0;
+	keyStats.dropped = 0;
+	keyStats.highWater = 0;
+}
+
+uint8_t KeyQueue_Push(const KeyQueueEvent_t *ev)
+{
+	uint8_t head = keyHead;
+	uint8_t used = (uint8_t)(head - keyTail);
+
+	if (used >= KEY_QUEUE_SIZE)
+	{
+		keyStats.dropped++;
+		return 0;
+	}
+	keyQueue[head & KEYQ_MASK] = *ev;
+	KEYQ_BARRIER();				// Slot contents visible before the new head
+	keyHead = head + 1;
+
+	keyStats.pushed++;
+	if (used + 1 > keyStats.highWater)
+		keyStats.highWater = used + 1;
+	return 1;
+}
+
+uint8_t KeyQueue_Pop(KeyQueueEvent_t *ev)
+{
+	uint8_t tail = keyTail;
+
+	if (tail == keyHead)
+		return 0;
+	KEYQ_BARRIER();				// Read the slot only after seeing the head
+	*ev = keyQueue[tail & KEYQ_MASK];
+	KEYQ_BARRIER();				// Slot copied before the producer may reuse it
+	keyTail = tail + 1;
+	return 1;
+}
+
+uint8_t KeyQueue_Count(void)
+{
+	return (uint8_t)(keyHead - keyTail);
+}
+
+void KeyQueue_Get_Stats(KeyQueueStats_t *stats)
+{
+	*stats = keyStats;
+}
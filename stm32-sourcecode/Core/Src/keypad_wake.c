@@ -0,0 +1,149 @@
+/*
+ * keypad_wake.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ */
+#include "keypad_wake.h"
+#include "main.h"
+#include "global.h"
+#include "input_reading.h"
+#include "battery_monitor.h"
+#include "scheduler.h"
+#include "timer.h"
+#include "timer_wheel.h"
+
+#define KEYPAD_WAKE_QUIET_TICKS	(KEYPAD_WAKE_QUIET_MS / SCH_TICK_MS)
+#define KEYPAD_WAKE_IRQ_PRIORITY	1	// Below TIM2
+
+static uint32_t wakeLines;			// EXTI lines armed in standby, bit n = line n
+static uint16_t quietTicks;
+static uint32_t wakeTaskID = NO_TASK_ID;
+
+
+static IRQn_Type wake_irqn(uint32_t line)
+{
+	if (line <= 4) return (IRQn_Type)(EXTI0_IRQn + line);
+	if (line <= 9) return EXTI9_5_IRQn;
+	return EXTI15_10_IRQn;
+}
+
+/* Routes the EXTI line of 'pin' to 'port' (AFIO_EXTICRx, 4 bits per line),
+ * falling edge, masked until the next standby.
+ */
+static void wake_add_line(GPIO_TypeDef *port, uint16_t pin)
+{
+	uint32_t line = POSITION_VAL(pin);
+	uint32_t portIndex = ((uintptr_t)port - GPIOA_BASE) / (GPIOB_BASE - GPIOA_BASE);
+	uint32_t shift = (line & 3u) * 4u;
+
+	AFIO->EXTICR[line >> 2] = (AFIO->EXTICR[line >> 2] & ~(0xFu << shift)) | (portIndex << shift);
+	EXTI->IMR &= ~(uint32_t)pin;
+	EXTI->RTSR &= ~(uint32_t)pin;
+	EXTI->FTSR |= pin;
+	HAL_NVIC_SetPriority(wake_irqn(line), KEYPAD_WAKE_IRQ_PRIORITY, 0);
+	HAL_NVIC_EnableIRQ(wake_irqn(line));
+	wakeLines |= pin;
+}
+
+/* Low columns: any pressed key pulls its row low */
+static void wake_drive_columns(GPIO_PinState state)
+{
+	for (int colum = 0; colum < NUMCOLS; colum++)
+	{
+		HAL_GPIO_WritePin(hKeypad.ColPort[colum], hKeypad.ColPins[colum], state);
+	}
+}
+
+static uint8_t wake_inputs_released(void)
+{
+	if (keypad_keys_debounced() != 0) return 0;
+	for (unsigned int i = 0; i < N0_OF_BUTTONS; i++)
+	{
+		if (is_button_pressed(i)) return 0;
+	}
+	return 1;
+}
+
+/* A row or sensor already low when the lines were armed left no edge */
+static uint8_t wake_level_pending(void)
+{
+	for (int row = 0; row < NUMROWS; row++)
+	{
+		if (HAL_GPIO_ReadPin(hKeypad.RowPort[row], hKeypad.RowPins[row]) == GPIO_PIN_RESET) return 1;
+	}
+	return HAL_GPIO_ReadPin(DOOR_SENSOR_GPIO_Port, DOOR_SENSOR_Pin) == GPIO_PIN_RESET ||
+		   HAL_GPIO_ReadPin(KEY_SENSOR_GPIO_Port, KEY_SENSOR_Pin) == GPIO_PIN_RESET ||
+		   HAL_GPIO_ReadPin(BUTTON_GPIO_Port, BUTTON_Pin) == GPIO_PIN_RESET;
+}
+
+static void wake_arm(void)
+{
+	wake_drive_columns(GPIO_PIN_RESET);
+	EXTI->PR = wakeLines;
+	EXTI->IMR |= wakeLines;
+
+	if (wake_level_pending())
+	{
+		EXTI->IMR &= ~wakeLines;
+		wake_drive_columns(GPIO_PIN_SET);
+		quietTicks = 0;
+		return;
+	}
+	// An edge from here on signals the wake task, which also ends standby
+	SCH_Standby(1);
+}
+
+/* Event task: first pass after the wake-up interrupt */
+static void keypad_wake_task(void)
+{
+	if (!SCH_In_Standby()) return;
+
+	wake_drive_columns(GPIO_PIN_SET); // Idle level for scanning
+	quietTicks = 0;
+	SCH_Standby(0);
+	// The edge stands for the first debounce sample
+	input_reading_wake();
+	// The battery filter was frozen for the whole sleep
+	Battery_Monitor_Wake();
+}
+
+void Keypad_Wake_Init(void)
+{
+	wakeLines = 0;
+	for (int row = 0; row < NUMROWS; row++)
+	{
+		wake_add_line(hKeypad.RowPort[row], hKeypad.RowPins[row]);
+	}
+	wake_add_line(DOOR_SENSOR_GPIO_Port, DOOR_SENSOR_Pin);
+	wake_add_line(KEY_SENSOR_GPIO_Port, KEY_SENSOR_Pin);
+	wake_add_line(BUTTON_GPIO_Port, BUTTON_Pin);
+	EXTI->PR = wakeLines;
+
+	quietTicks = 0;
+	if (wakeTaskID == NO_TASK_ID)
+		wakeTaskID = SCH_Add_Event_Task(keypad_wake_task, KEYPAD_WAKE_SIGNAL, SCH_PRIORITY_HIGHEST);
+}
+
+void Keypad_Wake_Process(void)
+{
+	if (gSystemState.currentState != LOCKED_SLEEP || !wake_inputs_released() ||
+		timerNextDue() != SCH_IDLE_FOREVER || TW_Next_Due() != SCH_IDLE_FOREVER)
+	{
+		quietTicks = 0;
+		return;
+	}
+	if (++quietTicks >= KEYPAD_WAKE_QUIET_TICKS)
+	{
+		wake_arm();
+	}
+}
+
+void Keypad_Wake_Irq(uint16_t GPIO_Pin)
+{
+	if ((GPIO_Pin & wakeLines) == 0) return;
+
+	EXTI->IMR &= ~wakeLines;
+	EXTI->PR = wakeLines;
+	SCH_Signal(1u << KEYPAD_WAKE_SIGNAL);
+}
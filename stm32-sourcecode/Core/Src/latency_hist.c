@@ -0,0 +1,52 @@
+/*
+ * latency_hist.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ */
+#include "latency_hist.h"
+
+static LatencyHist_t hist[LATENCY_COUNT];
+
+void Latency_Init(void)
+{
+	for (unsigned int id = 0; id < LATENCY_COUNT; id++)
+	{
+		hist[id].count = 0;
+		hist[id].maxMs = 0;
+		hist[id].totalMs = 0;
+		for (unsigned int b = 0; b < LATENCY_BUCKETS; b++) hist[id].bucket[b] = 0;
+	}
+}
+
+uint8_t Latency_Bucket(uint32_t ms)
+{
+	uint8_t bucket = 0;
+	while (ms != 0 && bucket < LATENCY_BUCKETS - 1)
+	{
+		ms >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+uint32_t Latency_Bucket_Low_Ms(uint8_t bucket)
+{
+	return (bucket == 0) ? 0 : (1u << (bucket - 1));
+}
+
+void Latency_Record(LatencyId_t id, uint32_t ms)
+{
+	if (id >= LATENCY_COUNT) return;
+
+	LatencyHist_t *h = &hist[id];
+	h->count++;
+	h->totalMs += ms;
+	if (ms > h->maxMs) h->maxMs = ms;
+	h->bucket[Latency_Bucket(ms)]++;
+}
+
+const LatencyHist_t* Latency_Get(LatencyId_t id)
+{
+	return (id < LATENCY_COUNT) ? &hist[id] : 0;
+}
@@ -28,9 +28,13 @@
 #include "state_processing.h"
 #include "scheduler.h"
 #include "timer.h"
+#include "timebase.h"
+#include "timer_wheel.h"
 #include "keypad.h"
 #include "i2c_lcd.h"
 #include "input_reading.h"
+#include "keypad_wake.h"
+#include "latency_hist.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -40,6 +44,9 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+#define TICKLESS_IDLE			1	// Sleep until the next scheduler deadline
+#define TIM2_COUNTS_PER_TICK	10	// TIM2 counts at 1 kHz, one tick = 10 ms
+#define TICKLESS_MAX_TICKS		(0xFFFF / TIM2_COUNTS_PER_TICK)
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -53,7 +60,7 @@ I2C_HandleTypeDef hi2c1;
 TIM_HandleTypeDef htim2;
 
 /* USER CODE BEGIN PV */
-
+static volatile uint32_t tim2TicksPerIrq = 1; // > 1 while TIM2 period is stretched
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -62,7 +69,7 @@ static void MX_GPIO_Init(void);
 static void MX_I2C1_Init(void);
 static void MX_TIM2_Init(void);
 /* USER CODE BEGIN PFP */
-
+static void Tickless_Idle(void);
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
@@ -105,11 +112,11 @@ int main(void)
   // LCD Driver
   lcd1.hi2c = &hi2c1;     // I2C from MX
   lcd1.address = (0x27 <<1);
-  lcd_init(&lcd1);
-  lcd_clear(&lcd1);
+  // lcd_init runs in the background from Output_Process (lcd_init_pt)
 
   // Global Variables
   init_global_variables();
+  Latency_Init();
 
   // Khởi tạo Scheduler
   SCH_Init();
@@ -130,11 +137,17 @@ int main(void)
   input_reading_init();
   Output_Init();
   State_Init();
+  Keypad_Wake_Init();
 //  SCH_Add_Task(timerRun, 0, 1);
-  SCH_Add_Task(button_reading, 0, 1);
-  SCH_Add_Task(Input_Process,  0, 1);
-  SCH_Add_Task(State_Process,  1, 1);
-  SCH_Add_Task(Output_Process, 2, 1);
+#if !SCH_STATIC_TASKS
+  // Same tick, run in pipeline order: read -> input -> state -> output
+  // (with SCH_STATIC_TASKS the same list lives in task_table.h)
+  SCH_Add_Task_Priority(button_reading, 0, 1, 0);
+  SCH_Add_Task_Priority(Input_Process,  0, 1, 1);
+  SCH_Add_Task_Priority(State_Process,  0, 1, 2);
+  SCH_Add_Task_Priority(Output_Process, 0, 1, 3);
+  SCH_Add_Task_Priority(Keypad_Wake_Process, 0, 1, 4);
+#endif
   /* USER CODE END 2 */
 
   /* Infinite loop */
@@ -145,6 +158,7 @@ int main(void)
 
 	  SCH_Dispatch_Tasks();
 	/* USER CODE BEGIN 3 */
+	  Tickless_Idle();
   }
   /* USER CODE END 3 */
 }
@@ -319,8 +333,82 @@ static void MX_GPIO_Init(void)
 
 /* USER CODE BEGIN 4 */
 void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
-	SCH_Update();
-	timerRun();
+	uint32_t ticks = tim2TicksPerIrq;
+
+	Timebase_Advance(ticks * TIM2_COUNTS_PER_TICK);
+	// End of a stretched idle period: back to one tick per interrupt
+	if (ticks > 1) {
+		__HAL_TIM_SET_AUTORELOAD(&htim2, TIM2_COUNTS_PER_TICK - 1);
+		tim2TicksPerIrq = 1;
+	}
+	SCH_Update_Ticks(ticks);
+	timerAdvance(ticks);
+	TW_Advance(ticks);
+}
+
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
+	// Keypad row / sensor edge while the scheduler is in standby
+	Keypad_Wake_Irq(GPIO_Pin);
+}
+
+/**
+  * @brief  Sleeps until the next scheduler deadline.
+  * TIM2 keeps counting: its auto-reload is stretched over the idle horizon so
+  * the next update interrupt posts every skipped tick in one step. There is
+  * no SysTick to stop: HAL_GetTick is read from TIM2 (timebase.c).
+  * In scheduler standby (keypad_wake.c) nothing is due, so the CPU only
+  * wakes for the 16-bit TIM2 span or an EXTI edge.
+  */
+static void Tickless_Idle(void)
+{
+#if TICKLESS_IDLE
+	uint32_t ticks;
+
+	__disable_irq();
+	ticks = SCH_Idle_Ticks();
+	// Soft timers and the timing wheel expire in the TIM2 interrupt
+	if (timerNextDue() < ticks) ticks = timerNextDue();
+	if (TW_Next_Due() < ticks) ticks = TW_Next_Due();
+	if (ticks == 0 || __HAL_TIM_GET_FLAG(&htim2, TIM_FLAG_UPDATE)) {
+		__enable_irq();
+		return;
+	}
+	if (ticks > TICKLESS_MAX_TICKS) ticks = TICKLESS_MAX_TICKS;
+
+	if (ticks > 1) {
+		__HAL_TIM_SET_AUTORELOAD(&htim2, ticks * TIM2_COUNTS_PER_TICK - 1);
+		tim2TicksPerIrq = ticks;
+		// Tick ended while reprogramming: it belongs to the old period
+		if (__HAL_TIM_GET_FLAG(&htim2, TIM_FLAG_UPDATE)) {
+			__HAL_TIM_SET_AUTORELOAD(&htim2, TIM2_COUNTS_PER_TICK - 1);
+			tim2TicksPerIrq = 1;
+			__enable_irq();
+			return;
+		}
+	}
+
+	__WFI(); // Wakes on any pending interrupt, even with PRIMASK set
+
+	// CNT first, then the flag: a period that ended before the read has its
+	// update pending and keeps tim2TicksPerIrq = ticks (CNT already wrapped)
+	uint32_t now = __HAL_TIM_GET_COUNTER(&htim2);
+	if (!__HAL_TIM_GET_FLAG(&htim2, TIM_FLAG_UPDATE)) {
+		// Woken early by another interrupt: end the period after the current tick.
+		// If it ends right after the check, 'now' was its last count and the
+		// reload written below is the one it ended on (elapsed == ticks).
+		uint32_t elapsed = now / TIM2_COUNTS_PER_TICK + 1;
+		__HAL_TIM_SET_AUTORELOAD(&htim2, elapsed * TIM2_COUNTS_PER_TICK - 1);
+		// TIM2 kept counting: if it already passed the new reload it would run
+		// on to 0xFFFF and wrap, so end the period one tick later instead
+		// (at most the stretched period, which the counter cannot be past).
+		while (__HAL_TIM_GET_COUNTER(&htim2) > __HAL_TIM_GET_AUTORELOAD(&htim2)) {
+			elapsed++;
+			__HAL_TIM_SET_AUTORELOAD(&htim2, elapsed * TIM2_COUNTS_PER_TICK - 1);
+		}
+		tim2TicksPerIrq = elapsed;
+	}
+	__enable_irq();
+#endif
 }
 /* USER CODE END 4 */
 
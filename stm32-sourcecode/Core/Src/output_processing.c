@@ -10,12 +10,17 @@
 #include "i2c_lcd.h"
 #include "main.h"
 #include "timer.h"
+#include "timebase.h"
+#include "latency_hist.h"
 #include <stdio.h>
 #include <string.h>
 
 // --- Private Variables ---
 static char prevLcdLine1[17] = "";
 static char prevLcdLine2[17] = "";
+static pt_t lcdInitPt; // LCD power-up sequence, runs until lcdReady
+static uint8_t lcdReady = 0;
+static Solenoid_t relayLevel = SOLENOID_LOCKED; // Last level written to the relay pin
 
 // Variables for Password Masking Logic
 static int lastInputLen = 0; // To detect new key presses
@@ -52,7 +57,7 @@ static void format_password_display(void)
     // 1. Detect new character input to restart visibility timer
     if (currentLen > lastInputLen)
     {
-        setTimer(MASK_TIMER_ID, MASK_TIMEOUT_MS); // Start 1s timer
+        setTimer(gCharMaskTimer, MASK_TIMEOUT_MS); // Start 1s timer
     }
     lastInputLen = currentLen;
 
@@ -79,7 +84,7 @@ static void format_password_display(void)
         // - The very last char is visible ONLY if MASK_TIMER is running
         if (originalIdx == (currentLen - 1)) {
             // Check if timer is still running (flag == 0 means running)
-            if (timer_counter[MASK_TIMER_ID] > 0) {
+            if (timerRunning(gCharMaskTimer)) {
                 // Keep char visible
             } else {
                 charToShow = '*';
@@ -139,10 +144,11 @@ static void MapStateToVisuals(void)
         case PENALTY_TIMER:
             center_text(gOutputStatus.lcdLine1, "Lockout warning");
             // Calculate remaining minutes
-            if (gSystemTimers.penaltyEndTick > HAL_GetTick()) {
-                uint32_t diff = gSystemTimers.penaltyEndTick - HAL_GetTick();
+            uint64_t now = Timebase_Now_Ms();
+            if (gSystemTimers.penaltyEndMs > now) {
+                uint32_t diff = (uint32_t)(gSystemTimers.penaltyEndMs - now);
                 uint32_t min = (diff / 60000) + 1; // Round up
-                sprintf(tempStr, "%lu minutes", min);
+                sprintf(tempStr, "%lu minutes", (unsigned long)min);
                 center_text(gOutputStatus.lcdLine2, tempStr);
             } else {
                 center_text(gOutputStatus.lcdLine2, "Wait...");
@@ -194,10 +200,11 @@ void Output_Init(void)
     HAL_GPIO_WritePin(GPIOB, LED_RED_Pin, GPIO_PIN_RESET);
     HAL_GPIO_WritePin(GPIOB, BUZZER_Pin, GPIO_PIN_RESET);
     HAL_GPIO_WritePin(GPIOB, RELAY_Pin, GPIO_PIN_RESET);
+    relayLevel = SOLENOID_LOCKED;
 
-    // LCD Init
-    lcd_init(&lcd1);
-    lcd_clear(&lcd1);
+    // LCD Init: started here, finished by Output_Process without blocking
+    PT_INIT(&lcdInitPt);
+    lcdReady = 0;
 
     // Clear Buffers
     memset(prevLcdLine1, 0, 17);
@@ -208,7 +215,7 @@ void Output_Init(void)
 void Output_Process(void)
 {
 	// 1. Determine what to show based on State
-	if (timer_counter[DOOR_NOTIFY_TIMER_ID] > 0)
+	if (timerRunning(gDoorNotifyTimer))
 	{
 		// Overwrite lcd by notify change state of the door
 		char tempStr[17];
@@ -230,8 +237,23 @@ void Output_Process(void)
     HAL_GPIO_WritePin(GPIOB, LED_RED_Pin, (gOutputStatus.ledRed == LED_ON) ? GPIO_PIN_SET : GPIO_PIN_RESET);
     HAL_GPIO_WritePin(GPIOB, BUZZER_Pin, (gOutputStatus.buzzer == BUZZER_ON) ? GPIO_PIN_SET : GPIO_PIN_RESET);
     HAL_GPIO_WritePin(GPIOB, RELAY_Pin, (gOutputStatus.solenoid == SOLENOID_UNLOCKED) ? GPIO_PIN_SET : GPIO_PIN_RESET); // Active High or Low depends on Relay module, assuming Active High here
+    if (gOutputStatus.solenoid != relayLevel)
+    {
+        relayLevel = gOutputStatus.solenoid;
+        // Input sampled -> relay written (latency_hist.h)
+        if (gOutputStatus.solenoidCause)
+        {
+            Latency_Record(LATENCY_INPUT_TO_RELAY, HAL_GetTick() - gOutputStatus.solenoidCauseMs);
+            gOutputStatus.solenoidCause = 0;
+        }
+    }
+
+    // 3. LCD Update (Only if changed), once the init sequence is done
+    if (!lcdReady) {
+        if (PT_SCHEDULE(lcd_init_pt(&lcdInitPt, &lcd1))) return;
+        lcdReady = 1;
+    }
 
-    // 3. LCD Update (Only if changed)
     if (strcmp(gOutputStatus.lcdLine1, prevLcdLine1) != 0) {
         lcd_gotoxy(&lcd1, 0, 0);
         lcd_puts(&lcd1, gOutputStatus.lcdLine1);
@@ -6,92 +6,869 @@
  */
 #include "main.h"
 #include "scheduler.h"
+#include "task_profiler.h"
+#include "atomic_bits.h"
+
+#define SCH_FLAG_QUEUED		0x01	// Slot is in the ready queue
+#define SCH_FLAG_LINKED		0x02	// Slot is waiting in the wheel / delta list
+#define SCH_FLAG_EVENT		0x04	// Slot is on a signal chain instead
+#define SCH_FLAG_AUTO		0x08	// Phase chosen by SCH_Add_Task_Auto
 
 sTask SCH_tasks_G[SCH_MAX_TASKS];
 uint8_t SCH_task_count = 0;
 uint8_t Error_code_G = 0;
 
-void SCH_Init(void)
+/* Tasks live in fixed slots of SCH_tasks_G for their whole lifetime. The
+ * backend only links slots together, so a handle stays valid however many
+ * tasks are added or removed around it.
+ */
+static uint8_t SCH_free_head = SCH_NO_SLOT;
+static uint8_t SCH_ready_head = SCH_NO_SLOT;
+static uint8_t SCH_ready_tail = SCH_NO_SLOT;
+
+/* ISR -> main loop tick hand-off. The TIM2 ISR is the only writer of
+ * SCH_ticks_posted and the main loop the only writer of SCH_ticks_done, so
+ * no locking is needed: an aligned 32-bit read is atomic on Cortex-M3 and
+ * the difference stays correct across wrap-around.
+ */
+static volatile uint32_t SCH_ticks_posted = 0;
+static uint32_t SCH_ticks_done = 0;
+
+/* Event tasks: one chain of slots per signal bit (linked through Next, they
+ * are never in the timing backend). ISRs only set bits in SCH_signals_pending,
+ * the chains are walked by the main loop.
+ */
+static atomic_bits_t SCH_signals_pending = 0;
+static volatile uint8_t SCH_standby = 0;     // Time-driven tasks frozen
+static uint8_t SCH_signal_head[SCH_MAX_SIGNALS];
+
+static void SCH_Release(uint8_t index);
+
+#if SCH_BACKEND == SCH_BACKEND_TIMING_WHEEL
+
+/* Timing wheel backend
+ * Each task sits in the bucket of its expiry tick (Delay holds the absolute
+ * expiry tick). SCH_Update only walks the bucket of the current tick, so
+ * adding, requeueing and releasing a task never touches the other slots.
+ */
+static uint8_t SCH_wheel_G[SCH_WHEEL_SIZE];
+static uint32_t SCH_tick_G = 0;
+
+static void SCH_Timing_Init(void)
+{
+    for (uint8_t i = 0; i < SCH_WHEEL_SIZE; i++)
+        SCH_wheel_G[i] = SCH_NO_SLOT;
+    SCH_tick_G = 0;
+}
+
+static void SCH_Timing_Insert(uint8_t index, uint32_t ticks)
+{
+    uint32_t expire = SCH_tick_G + ticks;
+    uint8_t bucket = expire & (SCH_WHEEL_SIZE - 1);
+
+    SCH_tasks_G[index].Delay = expire;
+    SCH_tasks_G[index].Flags |= SCH_FLAG_LINKED;
+    SCH_tasks_G[index].Prev = SCH_NO_SLOT;
+    SCH_tasks_G[index].Next = SCH_wheel_G[bucket];
+    if (SCH_wheel_G[bucket] != SCH_NO_SLOT)
+        SCH_tasks_G[SCH_wheel_G[bucket]].Prev = index;
+    SCH_wheel_G[bucket] = index;
+}
+
+static void SCH_Timing_Unlink(uint8_t index)
+{
+    sTask *task = &SCH_tasks_G[index];
+    if (!(task->Flags & SCH_FLAG_LINKED)) return;
+
+    if (task->Prev != SCH_NO_SLOT)
+        SCH_tasks_G[task->Prev].Next = task->Next;
+    else
+        SCH_wheel_G[task->Delay & (SCH_WHEEL_SIZE - 1)] = task->Next;
+
+    if (task->Next != SCH_NO_SLOT)
+        SCH_tasks_G[task->Next].Prev = task->Prev;
+
+    task->Next = SCH_NO_SLOT;
+    task->Prev = SCH_NO_SLOT;
+    task->Flags &= ~SCH_FLAG_LINKED;
+}
+
+static void SCH_Timing_Tick(void)
+{
+    SCH_tick_G++;
+
+    uint8_t index = SCH_wheel_G[SCH_tick_G & (SCH_WHEEL_SIZE - 1)];
+    while (index != SCH_NO_SLOT)
+    {
+        uint8_t next = SCH_tasks_G[index].Next;
+
+        // Bucket also holds tasks due on a later revolution of the wheel
+        if (SCH_tasks_G[index].Delay == SCH_tick_G)
+            SCH_Release(index);
+        index = next;
+    }
+}
+
+/* Ticks until the earliest linked task is due. Only used when idle, so a
+ * plain scan of the slots is good enough.
+ */
+static uint32_t SCH_Timing_Next_Due(void)
+{
+    uint32_t next = SCH_IDLE_FOREVER;
+
+    for (uint8_t i = 0; i < SCH_MAX_TASKS; i++)
+    {
+        if ((SCH_tasks_G[i].Flags & SCH_FLAG_LINKED) &&
+            SCH_tasks_G[i].Delay - SCH_tick_G < next)
+        {
+            next = SCH_tasks_G[i].Delay - SCH_tick_G;
+        }
+    }
+    return next;
+}
+
+#if SCH_AUTO_PHASE
+/* Ticks until a linked task is due */
+static uint32_t SCH_Timing_Remaining(uint8_t index)
+{
+    return SCH_tasks_G[index].Delay - SCH_tick_G;
+}
+#endif
+
+#else /* SCH_BACKEND_DELTA_LIST */
+
+/* Delta list backend
+ * Slots are linked in due order, each Delay relative to the previous one,
+ * so SCH_Update only decrements the head.
+ */
+static uint8_t SCH_list_head = SCH_NO_SLOT;
+
+static void SCH_Timing_Init(void)
+{
+    SCH_list_head = SCH_NO_SLOT;
+}
+
+static void SCH_Timing_Insert(uint8_t index, uint32_t ticks)
+{
+    uint8_t prev = SCH_NO_SLOT;
+    uint8_t cur = SCH_list_head;
+
+    while (cur != SCH_NO_SLOT && ticks >= SCH_tasks_G[cur].Delay)
+    {
+        ticks -= SCH_tasks_G[cur].Delay;
+        prev = cur;
+        cur = SCH_tasks_G[cur].Next;
+    }
+
+    SCH_tasks_G[index].Delay = ticks;
+    SCH_tasks_G[index].Flags |= SCH_FLAG_LINKED;
+    SCH_tasks_G[index].Prev = prev;
+    SCH_tasks_G[index].Next = cur;
+
+    if (prev != SCH_NO_SLOT)
+        SCH_tasks_G[prev].Next = index;
+    else
+        SCH_list_head = index;
+
+    if (cur != SCH_NO_SLOT)
+    {
+        SCH_tasks_G[cur].Prev = index;
+        SCH_tasks_G[cur].Delay -= ticks;
+    }
+}
+
+static void SCH_Timing_Unlink(uint8_t index)
+{
+    sTask *task = &SCH_tasks_G[index];
+    if (!(task->Flags & SCH_FLAG_LINKED)) return;
+
+    if (task->Prev != SCH_NO_SLOT)
+        SCH_tasks_G[task->Prev].Next = task->Next;
+    else
+        SCH_list_head = task->Next;
+
+    if (task->Next != SCH_NO_SLOT)
+    {
+        SCH_tasks_G[task->Next].Prev = task->Prev;
+        SCH_tasks_G[task->Next].Delay += task->Delay;
+    }
+
+    task->Next = SCH_NO_SLOT;
+    task->Prev = SCH_NO_SLOT;
+    task->Flags &= ~SCH_FLAG_LINKED;
+}
+
+static void SCH_Timing_Tick(void)
+{
+    if (SCH_list_head == SCH_NO_SLOT) return;
+
+    if (SCH_tasks_G[SCH_list_head].Delay > 0)
+        SCH_tasks_G[SCH_list_head].Delay--;
+
+    while (SCH_list_head != SCH_NO_SLOT && SCH_tasks_G[SCH_list_head].Delay == 0)
+        SCH_Release(SCH_list_head);
+}
+
+/* Ticks until the head of the delta list is due */
+static uint32_t SCH_Timing_Next_Due(void)
+{
+    if (SCH_list_head == SCH_NO_SLOT) return SCH_IDLE_FOREVER;
+    return SCH_tasks_G[SCH_list_head].Delay;
+}
+
+#if SCH_AUTO_PHASE
+/* Ticks until a linked task is due: sum of the deltas up to it */
+static uint32_t SCH_Timing_Remaining(uint8_t index)
+{
+    uint32_t ticks = 0;
+    for (uint8_t cur = SCH_list_head; cur != index; cur = SCH_tasks_G[cur].Next)
+        ticks += SCH_tasks_G[cur].Delay;
+    return ticks + SCH_tasks_G[index].Delay;
+}
+#endif
+
+#endif /* SCH_BACKEND */
+
+#if SCH_STATIC_TASKS
+#include "task_table.h"
+
+/* Build-time task table: descriptors in flash, counters in RAM */
+typedef struct {
+    void (*pTask)(void);
+    uint16_t Phase;
+    uint16_t Period;
+} sStaticTask;
+
+#define SCH_STATIC_ENTRY(fn, phase, period)	{ fn, phase, period },
+static const sStaticTask SCH_static_tasks[SCH_STATIC_TASK_COUNT] = {
+    SCH_STATIC_TASK_LIST(SCH_STATIC_ENTRY)
+};
+
+#define SCH_STATIC_CHECK(fn, phase, period) \
+    _Static_assert((period) > 0 && (period) <= 0xFFFF, #fn ": period must be 1..65535 ticks"); \
+    _Static_assert((phase) >= 0 && (phase) < (period), #fn ": phase must be smaller than period");
+SCH_STATIC_TASK_LIST(SCH_STATIC_CHECK)
+
+static uint16_t SCH_static_countdown[SCH_STATIC_TASK_COUNT];
+static uint8_t SCH_static_runme[SCH_STATIC_TASK_COUNT];
+
+static void SCH_Static_Init(void)
+{
+    for (uint8_t i = 0; i < SCH_STATIC_TASK_COUNT; i++)
+    {
+        SCH_static_countdown[i] = SCH_static_tasks[i].Phase + 1;
+        SCH_static_runme[i] = 0;
+    }
+}
+
+static void SCH_Static_Tick(void)
+{
+    for (uint8_t i = 0; i < SCH_STATIC_TASK_COUNT; i++)
+    {
+        if (--SCH_static_countdown[i] == 0)
+        {
+            SCH_static_countdown[i] = SCH_static_tasks[i].Period;
+            SCH_static_runme[i]++;
+            Prof_Release(SCH_MAX_TASKS + i, SCH_ticks_posted - SCH_ticks_done - 1);
+        }
+    }
+}
+
+/* Runs ready table entries in table order: all of them, or only the first
+ * one if 'all' is 0. Returns the number of runs.
+ */
+static uint8_t SCH_Static_Run(uint8_t all)
+{
+    uint8_t runs = 0;
+
+    for (uint8_t i = 0; i < SCH_STATIC_TASK_COUNT; i++)
+    {
+        if (SCH_static_runme[i] == 0) continue;
+
+        uint32_t start = Prof_Begin();
+        SCH_static_runme[i]--;
+        (*SCH_static_tasks[i].pTask)();
+        Prof_End(SCH_MAX_TASKS + i, SCH_static_tasks[i].pTask, SCH_static_tasks[i].Period, start);
+
+        runs++;
+        if (!all) break;
+    }
+    return runs;
+}
+
+static uint32_t SCH_Static_Next_Due(void)
+{
+    uint32_t next = SCH_IDLE_FOREVER;
+
+    for (uint8_t i = 0; i < SCH_STATIC_TASK_COUNT; i++)
+    {
+        if (SCH_static_runme[i] > 0) return 0;
+        if (SCH_static_countdown[i] < next) next = SCH_static_countdown[i];
+    }
+    return next;
+}
+
+#else
+
+#define SCH_Static_Init()
+#define SCH_Static_Tick()
+#define SCH_Static_Run(all)		0
+#define SCH_Static_Next_Due()	SCH_IDLE_FOREVER
+
+#endif /* SCH_STATIC_TASKS */
+
+/* Ready queue is ordered by Priority (0 first), FIFO among equal priorities */
+static void SCH_Ready_Push(uint8_t index)
+{
+    uint8_t priority = SCH_tasks_G[index].Priority;
+
+    SCH_tasks_G[index].Flags |= SCH_FLAG_QUEUED;
+    SCH_tasks_G[index].NextReady = SCH_NO_SLOT;
+
+    // Common case: not more urgent than the tail, append
+    if (SCH_ready_tail == SCH_NO_SLOT || SCH_tasks_G[SCH_ready_tail].Priority <= priority)
+    {
+        if (SCH_ready_tail != SCH_NO_SLOT)
+            SCH_tasks_G[SCH_ready_tail].NextReady = index;
+        else
+            SCH_ready_head = index;
+        SCH_ready_tail = index;
+        return;
+    }
+
+    uint8_t prev = SCH_NO_SLOT;
+    uint8_t cur = SCH_ready_head;
+    while (SCH_tasks_G[cur].Priority <= priority)
+    {
+        prev = cur;
+        cur = SCH_tasks_G[cur].NextReady;
+    }
+
+    SCH_tasks_G[index].NextReady = cur;
+    if (prev != SCH_NO_SLOT)
+        SCH_tasks_G[prev].NextReady = index;
+    else
+        SCH_ready_head = index;
+}
+
+static uint8_t SCH_Ready_Pop(void)
+{
+    uint8_t index = SCH_ready_head;
+    if (index == SCH_NO_SLOT) return SCH_NO_SLOT;
+
+    SCH_ready_head = SCH_tasks_G[index].NextReady;
+    if (SCH_ready_head == SCH_NO_SLOT)
+        SCH_ready_tail = SCH_NO_SLOT;
+    SCH_tasks_G[index].Flags &= ~SCH_FLAG_QUEUED;
+    return index;
+}
+
+/* Due task: requeue it if periodic and hand it to the dispatcher */
+static void SCH_Release(uint8_t index)
+{
+    SCH_Timing_Unlink(index);
+    if (SCH_tasks_G[index].Period > 0)
+        SCH_Timing_Insert(index, SCH_tasks_G[index].Period);
+
+    SCH_tasks_G[index].RunMe++;
+    if (!(SCH_tasks_G[index].Flags & SCH_FLAG_QUEUED))
+        SCH_Ready_Push(index);
+
+    Prof_Release(index, SCH_ticks_posted - SCH_ticks_done - 1);
+}
+
+/* Makes every task on the raised signal bits ready. Several signals before
+ * one dispatch pass give a single run.
+ */
+static void SCH_Signal_Release(uint32_t signals)
+{
+    while (signals != 0)
+    {
+        uint8_t bit = __builtin_ctz(signals);
+        signals &= signals - 1;
+
+        for (uint8_t index = SCH_signal_head[bit]; index != SCH_NO_SLOT; index = SCH_tasks_G[index].Next)
+        {
+            if (SCH_tasks_G[index].RunMe > 0) continue;
+
+            SCH_tasks_G[index].RunMe = 1;
+            if (!(SCH_tasks_G[index].Flags & SCH_FLAG_QUEUED))
+                SCH_Ready_Push(index);
+            Prof_Release(index, 0);
+        }
+    }
+}
+
+static void SCH_Signal_Unlink(uint8_t index)
 {
+    if (!(SCH_tasks_G[index].Flags & SCH_FLAG_EVENT)) return;
+
+    uint8_t *link = &SCH_signal_head[SCH_tasks_G[index].Signal];
+    while (*link != index)
+        link = &SCH_tasks_G[*link].Next;
+    *link = SCH_tasks_G[index].Next;
+
+    SCH_tasks_G[index].Next = SCH_NO_SLOT;
+    SCH_tasks_G[index].Flags &= ~SCH_FLAG_EVENT;
+}
+
+static void SCH_Free_Slot(uint8_t index)
+{
+    uint32_t generation = SCH_HANDLE_GENERATION(SCH_tasks_G[index].TaskID) + 1;
+    if (generation > 0x00FFFFFF) generation = 1;
+
+    SCH_tasks_G[index].TaskID = (generation << 8) | index;
+    SCH_tasks_G[index].pTask = 0;
+    SCH_tasks_G[index].Delay = 0;
+    SCH_tasks_G[index].Period = 0;
+    SCH_tasks_G[index].RunMe = 0;
+    SCH_tasks_G[index].Priority = SCH_PRIORITY_DEFAULT;
+    SCH_tasks_G[index].Flags = 0;
+    SCH_tasks_G[index].Signal = 0;
+    SCH_tasks_G[index].Prev = SCH_NO_SLOT;
+    SCH_tasks_G[index].Next = SCH_free_head;
+    SCH_free_head = index;
+}
+
+/* Handle -> slot, SCH_NO_SLOT if the task no longer exists */
+static uint8_t SCH_Find_Slot(uint32_t id)
+{
+    uint8_t index = SCH_HANDLE_SLOT(id);
+
+    if (id == NO_TASK_ID || index >= SCH_MAX_TASKS) return SCH_NO_SLOT;
+    if (SCH_tasks_G[index].TaskID != id || SCH_tasks_G[index].pTask == 0) return SCH_NO_SLOT;
+    return index;
+}
+
+#if SCH_AUTO_PHASE
+#include <stdio.h>
+
+/* Automatic phase staggering
+ * The load profile is the expected run time (us) landing on each tick of a
+ * SCH_PHASE_SLOTS long window. It is exact for periods dividing the window
+ * length and an approximation of one window for the others. Auto tasks are
+ * placed one by one, largest first, on the phase whose worst tick is the
+ * lowest; other tasks keep their timing and only add to the profile.
+ */
+static uint16_t SCH_cost_us[SCH_MAX_TASKS];
+static uint32_t SCH_load_us[SCH_PHASE_SLOTS];
+
+/* Measured mean if the profiler has one for this task, declared cost (auto
+ * tasks) or 0 else.
+ */
+static uint32_t SCH_Task_Cost(uint8_t index)
+{
+#if SCH_PROFILING
+    const TaskProfile_t *p = Prof_Get(index);
+    if (p != NULL && p->pTask == SCH_tasks_G[index].pTask)
+        return Prof_Mean_Us(index);
+#endif
+    return (SCH_tasks_G[index].Flags & SCH_FLAG_AUTO) ? SCH_cost_us[index] : 0;
+}
+
+/* Adds 'cost' to every tick of the window the task runs on, starting at
+ * absolute tick 'first'.
+ */
+static void SCH_Load_Add(uint32_t first, uint32_t period, uint32_t cost)
+{
+    for (uint32_t t = 0; t < SCH_PHASE_SLOTS; t += period)
+        SCH_load_us[(first + t) & (SCH_PHASE_SLOTS - 1)] += cost;
+}
+
+/* Worst tick of the window if a task with 'period' and 'cost' first runs on
+ * absolute tick 'first'.
+ */
+static uint32_t SCH_Load_Peak(uint32_t first, uint32_t period, uint32_t cost)
+{
+    uint32_t peak = 0;
+    for (uint32_t t = 0; t < SCH_PHASE_SLOTS; t += period)
+    {
+        uint32_t load = SCH_load_us[(first + t) & (SCH_PHASE_SLOTS - 1)] + cost;
+        if (load > peak) peak = load;
+    }
+    return peak;
+}
+
+/* Profile of every periodic task except slot 'skip' and, if 'skipAuto',
+ * the auto tasks about to be placed again.
+ */
+static void SCH_Load_Build(uint8_t skipAuto, uint8_t skip)
+{
+    for (uint8_t i = 0; i < SCH_PHASE_SLOTS; i++)
+        SCH_load_us[i] = 0;
+
+#if SCH_STATIC_TASKS
+    for (uint8_t i = 0; i < SCH_STATIC_TASK_COUNT; i++)
+    {
+        SCH_Load_Add(SCH_ticks_done + SCH_static_countdown[i], SCH_static_tasks[i].Period,
+                     Prof_Mean_Us(SCH_MAX_TASKS + i));
+    }
+#endif
     for (uint8_t i = 0; i < SCH_MAX_TASKS; i++)
-        SCH_Delete_Task(i);
+    {
+        sTask *task = &SCH_tasks_G[i];
+        if (!(task->Flags & SCH_FLAG_LINKED) || task->Period == 0 || i == skip) continue;
+        if (skipAuto && (task->Flags & SCH_FLAG_AUTO)) continue;
+        SCH_Load_Add(SCH_ticks_done + SCH_Timing_Remaining(i), task->Period, SCH_Task_Cost(i));
+    }
+}
+
+/* Moves an auto task to its best phase and adds it to the profile */
+static void SCH_Place(uint8_t index)
+{
+    uint32_t period = SCH_tasks_G[index].Period;
+    uint32_t cost = SCH_Task_Cost(index);
+    uint32_t phases = (period < SCH_PHASE_SLOTS) ? period : SCH_PHASE_SLOTS;
+    uint32_t best = 0;
+    uint32_t bestPeak = SCH_IDLE_FOREVER;
+
+    for (uint32_t phase = 0; phase < phases; phase++)
+    {
+        uint32_t peak = SCH_Load_Peak(SCH_ticks_done + phase + 1, period, cost);
+        if (peak < bestPeak)
+        {
+            bestPeak = peak;
+            best = phase;
+        }
+    }
+
+    SCH_Timing_Unlink(index);
+    SCH_Timing_Insert(index, best + 1);
+    SCH_Load_Add(SCH_ticks_done + best + 1, period, cost);
+}
+
+/* Re-places every auto task, largest cost first (e.g. once the profiler
+ * has measured them). Runs already pending are kept.
+ */
+void SCH_Rebalance(void)
+{
+    uint8_t placed[SCH_MAX_TASKS] = { 0 };
+
+    SCH_Load_Build(1, SCH_NO_SLOT);
+    for (;;)
+    {
+        uint8_t next = SCH_NO_SLOT;
+        for (uint8_t i = 0; i < SCH_MAX_TASKS; i++)
+        {
+            if (!(SCH_tasks_G[i].Flags & SCH_FLAG_AUTO) || placed[i]) continue;
+            if (next == SCH_NO_SLOT || SCH_Task_Cost(i) > SCH_Task_Cost(next))
+                next = i;
+        }
+        if (next == SCH_NO_SLOT) break;
+
+        SCH_Place(next);
+        placed[next] = 1;
+    }
+}
+
+/* Writes the load profile of the next SCH_PHASE_SLOTS ticks, 8 ticks per
+ * line, then the worst and mean tick.
+ */
+void SCH_Load_Report(void (*print)(const char *line))
+{
+    char line[80];
+    uint32_t peak = 0;
+    uint32_t peakTick = 0;
+    uint32_t total = 0;
+
+    SCH_Load_Build(0, SCH_NO_SLOT);
+    for (uint8_t row = 0; row < SCH_PHASE_SLOTS; row += 8)
+    {
+        int len = snprintf(line, sizeof(line), "+%02u:", (unsigned)row);
+        for (uint8_t i = row; i < row + 8; i++)
+        {
+            uint32_t load = SCH_load_us[(SCH_ticks_done + 1 + i) & (SCH_PHASE_SLOTS - 1)];
+            len += snprintf(line + len, sizeof(line) - len, " %6lu", (unsigned long)load);
+            total += load;
+            if (load > peak)
+            {
+                peak = load;
+                peakTick = i;
+            }
+        }
+        print(line);
+    }
+    snprintf(line, sizeof(line), "peak %lu us at +%lu, mean %lu us per %u ms tick",
+             (unsigned long)peak, (unsigned long)peakTick,
+             (unsigned long)(total / SCH_PHASE_SLOTS), (unsigned)SCH_TICK_MS);
+    print(line);
+}
+
+#else
+
+void SCH_Rebalance(void)
+{
+}
+
+void SCH_Load_Report(void (*print)(const char *line))
+{
+    print("SCH_AUTO_PHASE disabled");
+}
+
+#endif /* SCH_AUTO_PHASE */
+
+void SCH_Init(void)
+{
+    SCH_Timing_Init();
+    SCH_Static_Init();
+    Prof_Init();
 
+    SCH_free_head = SCH_NO_SLOT;
+    for (uint8_t i = SCH_MAX_TASKS; i > 0; i--)
+    {
+        SCH_tasks_G[i - 1].TaskID = i - 1;
+        SCH_Free_Slot(i - 1);
+    }
+
+    SCH_ready_head = SCH_NO_SLOT;
+    SCH_ready_tail = SCH_NO_SLOT;
+    for (uint8_t i = 0; i < SCH_MAX_SIGNALS; i++)
+        SCH_signal_head[i] = SCH_NO_SLOT;
+    Atomic_Consume_Bits(&SCH_signals_pending, 0xFFFFFFFF);
+    SCH_standby = 0;
     SCH_task_count = 0;
     Error_code_G = 0;
+
+    // TIM2 may already be running, start counting from its current tick
+    SCH_ticks_done = SCH_ticks_posted;
 }
 
-uint8_t SCH_Add_Task(void (*pFunction)(), uint32_t DELAY, uint32_t PERIOD)
+uint32_t SCH_Add_Task(void (*pFunction)(), uint32_t DELAY, uint32_t PERIOD)
 {
-    if (SCH_task_count >= SCH_MAX_TASKS)
+    return SCH_Add_Task_Priority(pFunction, DELAY, PERIOD, SCH_PRIORITY_DEFAULT);
+}
+
+uint32_t SCH_Add_Task_Priority(void (*pFunction)(), uint32_t DELAY, uint32_t PERIOD, uint8_t PRIORITY)
+{
+    if (SCH_free_head == SCH_NO_SLOT)
     {
         Error_code_G = ERROR_SCH_TOO_MANY_TASKS;
-        return SCH_MAX_TASKS;
+        return NO_TASK_ID;
     }
 
-    uint8_t index = 0;
-    while (index < SCH_task_count && DELAY >= SCH_tasks_G[index].Delay)
+    uint8_t index = SCH_free_head;
+    SCH_free_head = SCH_tasks_G[index].Next;
+
+    SCH_tasks_G[index].pTask = pFunction;
+    SCH_tasks_G[index].Period = PERIOD;
+    SCH_tasks_G[index].RunMe = 0;
+    SCH_tasks_G[index].Priority = PRIORITY;
+    // First run on tick DELAY + 1, the same tick the original list released it
+    SCH_Timing_Insert(index, DELAY + 1);
+
+    SCH_task_count++;
+    return SCH_tasks_G[index].TaskID;
+}
+
+uint32_t SCH_Add_Task_Auto(void (*pFunction)(), uint32_t PERIOD, uint16_t COST_US, uint8_t PRIORITY)
+{
+    uint32_t id = SCH_Add_Task_Priority(pFunction, 0, PERIOD, PRIORITY);
+    if (id == NO_TASK_ID || PERIOD == 0) return id;
+
+#if SCH_AUTO_PHASE
+    uint8_t index = SCH_HANDLE_SLOT(id);
+    SCH_cost_us[index] = COST_US;
+    SCH_tasks_G[index].Flags |= SCH_FLAG_AUTO;
+    SCH_Load_Build(0, index);
+    SCH_Place(index);
+#else
+    (void)COST_US;
+#endif
+    return id;
+}
+
+uint32_t SCH_Add_Event_Task(void (*pFunction)(), uint8_t SIGNAL, uint8_t PRIORITY)
+{
+    if (SIGNAL >= SCH_MAX_SIGNALS) return NO_TASK_ID;
+    if (SCH_free_head == SCH_NO_SLOT)
     {
-        DELAY -= SCH_tasks_G[index].Delay;
-        index++;
+        Error_code_G = ERROR_SCH_TOO_MANY_TASKS;
+        return NO_TASK_ID;
     }
 
-    for (uint8_t i = SCH_task_count; i > index; i--)
-        SCH_tasks_G[i] = SCH_tasks_G[i - 1];
+    uint8_t index = SCH_free_head;
+    SCH_free_head = SCH_tasks_G[index].Next;
 
     SCH_tasks_G[index].pTask = pFunction;
-    SCH_tasks_G[index].Delay = DELAY;
-    SCH_tasks_G[index].Period = PERIOD;
+    SCH_tasks_G[index].Period = 0;
     SCH_tasks_G[index].RunMe = 0;
-
-    if (index < SCH_task_count)
-        SCH_tasks_G[index + 1].Delay -= DELAY;
+    SCH_tasks_G[index].Priority = PRIORITY;
+    SCH_tasks_G[index].Signal = SIGNAL;
+    SCH_tasks_G[index].Flags |= SCH_FLAG_EVENT;
+    SCH_tasks_G[index].Next = SCH_signal_head[SIGNAL];
+    SCH_signal_head[SIGNAL] = index;
 
     SCH_task_count++;
-    return index;
+    return SCH_tasks_G[index].TaskID;
+}
+
+/* Safe from any ISR and from tasks: the chains are walked on the next pass */
+void SCH_Signal(uint32_t SIGNALS)
+{
+    Atomic_Set_Bits(&SCH_signals_pending, SIGNALS);
 }
 
+/* Called from the TIM2 ISR: constant time, never touches the task lists */
 void SCH_Update(void)
 {
-    if (SCH_task_count == 0) return;
+    SCH_ticks_posted++;
+    Prof_Tick();
+}
 
-    if (SCH_tasks_G[0].Delay > 0)
-        SCH_tasks_G[0].Delay--;
+/* Same as SCH_Update for an ISR that covers several ticks (tickless idle) */
+void SCH_Update_Ticks(uint32_t ticks)
+{
+    SCH_ticks_posted += ticks;
+    Prof_Tick();
+}
 
-    for (uint8_t i = 0; i < SCH_task_count && SCH_tasks_G[i].Delay == 0; i++)
-        SCH_tasks_G[i].RunMe++;
+/* Number of ticks the CPU may sleep before any task is due:
+ * 0 when there is work pending, SCH_IDLE_FOREVER when no task is waiting.
+ */
+uint32_t SCH_Idle_Ticks(void)
+{
+    if (SCH_ready_head != SCH_NO_SLOT || SCH_ticks_done != SCH_ticks_posted ||
+        SCH_signals_pending != 0)
+        return 0;
+
+    if (SCH_standby) return SCH_IDLE_FOREVER;
+
+    uint32_t next = SCH_Timing_Next_Due();
+    uint32_t nextStatic = SCH_Static_Next_Due();
+    return (nextStatic < next) ? nextStatic : next;
 }
 
-void SCH_Dispatch_Tasks(void)
+void SCH_Standby(uint8_t ON)
 {
-    if (SCH_task_count == 0) return;
+    SCH_standby = ON ? 1 : 0;
+}
 
-    if (SCH_tasks_G[0].RunMe > 0)
-    {
-        void (*pTask)() = SCH_tasks_G[0].pTask;
+uint8_t SCH_In_Standby(void)
+{
+    return SCH_standby;
+}
 
-        SCH_tasks_G[0].RunMe--;
-        (*pTask)();
+/* Ticks processed by the dispatcher so far (wraps after ~497 days) */
+uint32_t SCH_Get_Ticks(void)
+{
+    return SCH_ticks_done;
+}
 
-        sTask tmp = SCH_tasks_G[0];
-        SCH_Delete_Task(0);
+/* Runs one pass of the task in slot 'index' just popped from the ready
+ * queue. Returns 1 if it still has runs pending and must be queued again.
+ */
+static uint8_t SCH_Run_Task(uint8_t index)
+{
+    sTask *task = &SCH_tasks_G[index];
+    void (*pTask)() = task->pTask;
 
-        if (tmp.Period > 0)
-            SCH_Add_Task(tmp.pTask, tmp.Period, tmp.Period);
+    // Deleted while waiting in the ready queue
+    if (pTask == 0)
+    {
+        SCH_Free_Slot(index);
+        return 0;
     }
+    // Rescheduled while waiting in the ready queue
+    if (task->RunMe == 0) return 0;
+
+    uint32_t id = task->TaskID;
+    uint32_t period = task->Period;
+    uint32_t start = Prof_Begin();
+    task->RunMe--;
+    (*pTask)();
+    Prof_End(index, pTask, period, start);
+
+    // The task may have deleted itself
+    if (task->TaskID != id || task->pTask != pTask) return 0;
+
+    if (task->RunMe > 0)
+        return 1;
+    if (!(task->Flags & (SCH_FLAG_LINKED | SCH_FLAG_EVENT)))
+        SCH_Delete_Task(id); // One-shot task is done
+    return 0;
 }
 
-uint8_t SCH_Delete_Task(const uint8_t index)
+void SCH_Dispatch_Tasks(void)
 {
-    if (index >= SCH_task_count) return RETURN_ERROR;
+    // Drain every tick elapsed since the last pass in one batch
+    uint32_t posted = SCH_ticks_posted;
+    while (SCH_ticks_done != posted)
+    {
+        if (!SCH_standby)
+        {
+            SCH_Static_Tick();
+            SCH_Timing_Tick();
+        }
+        SCH_ticks_done++;
+    }
+    SCH_Signal_Release(Atomic_Consume_Bits(&SCH_signals_pending, 0xFFFFFFFF));
 
-    for (uint8_t i = index; i < SCH_task_count - 1; i++)
-        SCH_tasks_G[i] = SCH_tasks_G[i + 1];
+#if SCH_BATCH_DISPATCH
+    // Run every ready task once: table entries first, then the ready queue
+    // by priority. Tasks that are behind by several runs are queued again
+    // only after the whole pass. They keep SCH_FLAG_QUEUED meanwhile, so a
+    // later task deleting one only marks it and the pop frees it.
+    uint8_t again[SCH_MAX_TASKS];
+    uint8_t againCount = 0;
+    uint8_t index;
 
-    SCH_tasks_G[SCH_task_count - 1].pTask = 0;
-    SCH_tasks_G[SCH_task_count - 1].Delay = 0;
-    SCH_tasks_G[SCH_task_count - 1].Period = 0;
-    SCH_tasks_G[SCH_task_count - 1].RunMe = 0;
+    (void)SCH_Static_Run(1);
+    while ((index = SCH_Ready_Pop()) != SCH_NO_SLOT)
+    {
+        if (SCH_Run_Task(index))
+        {
+            SCH_tasks_G[index].Flags |= SCH_FLAG_QUEUED;
+            again[againCount++] = index;
+        }
+    }
+    for (uint8_t i = 0; i < againCount; i++)
+        SCH_Ready_Push(again[i]);
+#else
+    if (SCH_Static_Run(0) > 0) return;
 
+    uint8_t index = SCH_Ready_Pop();
+    if (index != SCH_NO_SLOT && SCH_Run_Task(index))
+        SCH_Ready_Push(index);
+#endif
+}
+
+uint8_t SCH_Delete_Task(const uint32_t TASK_ID)
+{
+    uint8_t index = SCH_Find_Slot(TASK_ID);
+    if (index == SCH_NO_SLOT)
+    {
+        Error_code_G = ERROR_SCH_CANNOT_DELETE_TASK;
+        return RETURN_ERROR;
+    }
+
+    SCH_Timing_Unlink(index);
+    SCH_Signal_Unlink(index);
     SCH_task_count--;
+
+    // A queued slot is released by the dispatcher when it is popped
+    if (SCH_tasks_G[index].Flags & SCH_FLAG_QUEUED)
+    {
+        SCH_tasks_G[index].pTask = 0;
+        SCH_tasks_G[index].RunMe = 0;
+    }
+    else
+    {
+        SCH_Free_Slot(index);
+    }
+    return RETURN_NORMAL;
+}
+
+/* Move the next run of an existing task to DELAY ticks from now, dropping
+ * any run that is already pending. Periodic tasks keep their period after.
+ */
+uint8_t SCH_Reschedule_Task(const uint32_t TASK_ID, uint32_t DELAY)
+{
+    uint8_t index = SCH_Find_Slot(TASK_ID);
+    if (index == SCH_NO_SLOT || (SCH_tasks_G[index].Flags & SCH_FLAG_EVENT))
+        return RETURN_ERROR;
+
+    SCH_Timing_Unlink(index);
+    SCH_tasks_G[index].RunMe = 0;
+    SCH_Timing_Insert(index, DELAY + 1);
     return RETURN_NORMAL;
 }
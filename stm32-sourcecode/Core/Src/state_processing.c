@@ -9,6 +9,13 @@
 #include "global.h"
 #include "kmp.h"
 #include "timer.h"
+#include "scheduler.h"
+#include "pt.h"
+#include "timebase.h"
+#include "timer_wheel.h"
+#include "key_queue.h"
+#include "latency_hist.h"
+#include "atomic_bits.h"
 #include <string.h>
 
 // --- Constants & Config ---
@@ -19,10 +26,32 @@ static const uint8_t MAX_PENALTY_LEVEL = 4;
 #define TIMEOUT_10S_CYCLES  10000 				// 1000
 #define TIMEOUT_30S_CYCLES  30000				// 3000
 #define ALARM_REPEAT_MS     (5 * 60 * 1000)     // 5 minutes
+#define ALARM_BEEP_ON_MS    500
+#define ALARM_BEEP_OFF_MS   500
+#define ALARM_BEEPS         (TIMEOUT_10S_CYCLES / (ALARM_BEEP_ON_MS + ALARM_BEEP_OFF_MS))
+#define STATE_MAX_CHAIN     8                   // Steps per event (bound only, no row chain is that long)
+#define STATE_WAKE_TIMER    0x01                // stateWake: an FSM timer expired
+
+/* Called on every FSM step if defined; the host tests count steps with it */
+#ifdef STATE_STEP_HOOK
+void STATE_STEP_HOOK(void);
+#endif
 
 // --- Internal Variables ---
 static uint16_t inputLen = 0;
 static bool isShowingError = false; // Flag to hold VERIFY state for 3s error display
+static uint32_t buzzerTaskID = NO_TASK_ID; // Runs the alarm pattern while it plays
+static pt_t buzzerPt;
+static uint8_t buzzerBeeps;
+static int penaltyTimer = TW_NONE;     // Long deadlines on the timing wheel
+static int alarmRepeatTimer = TW_NONE;
+static uint32_t causeMs;       // Input behind the latest transitions (latency_hist.h)
+static bool causeValid;
+static bool entryPending = true; // Current state's entry actions not run yet
+static atomic_bits_t stateWake;  // STATE_WAKE_*, set from the TIM2 interrupt
+static KeyQueueEvent_t deferredKeys[KEY_QUEUE_SIZE]; // Keys held back by state_defers_keys
+static uint8_t deferredHead;
+static uint8_t deferredCount;
 
 // --- Helper Functions ---
 
@@ -61,434 +90,635 @@ static void activate_penalty(uint8_t level) {
     } else {
         minutes = penalty_minutes[MAX_PENALTY_LEVEL - 1];
     }
-    gSystemTimers.penaltyEndTick = HAL_GetTick() + (minutes * 60 * 1000);
+    gSystemTimers.penaltyEndMs = Timebase_Now_Ms() + (minutes * 60 * 1000);
+    TW_Start(penaltyTimer, minutes * 60 * 1000);
+}
+
+/* Alarm pattern: 10s of 0.5s beeps */
+static char buzzer_pattern(pt_t *pt) {
+    PT_BEGIN(pt);
+    for (buzzerBeeps = 0; buzzerBeeps < ALARM_BEEPS; buzzerBeeps++) {
+        gOutputStatus.buzzer = BUZZER_ON;
+        PT_SLEEP_MS(pt, ALARM_BEEP_ON_MS);
+        gOutputStatus.buzzer = BUZZER_OFF;
+        PT_SLEEP_MS(pt, ALARM_BEEP_OFF_MS);
+    }
+    PT_END(pt);
+}
+
+/* Scheduler task (every tick) driving the pattern, removes itself at the end */
+static void buzzer_task(void) {
+    if (!PT_SCHEDULE(buzzer_pattern(&buzzerPt))) {
+        SCH_Delete_Task(buzzerTaskID);
+        buzzerTaskID = NO_TASK_ID;
+    }
+}
+
+/* Start the 10s alarm, from the beginning if it is already playing */
+static void buzzer_start(void) {
+    PT_INIT(&buzzerPt);
+    if (buzzerTaskID == NO_TASK_ID) {
+        buzzerTaskID = SCH_Add_Task(buzzer_task, 0, 1);
+    }
+}
+
+/* Silence the buzzer and drop the alarm pattern if one is playing */
+static void buzzer_off(void) {
+    gOutputStatus.buzzer = BUZZER_OFF;
+    if (buzzerTaskID != NO_TASK_ID) {
+        SCH_Delete_Task(buzzerTaskID);
+        buzzerTaskID = NO_TASK_ID;
+    }
+}
+
+/* States that cannot take a key yet but will soon (mask after wakeup,
+ * battery notice, password check / error display): keys typed meanwhile
+ * stay queued and are entered once LOCKED_ENTRY is reached.
+ */
+static bool state_defers_keys(void) {
+    switch (gSystemState.currentState) {
+        case LOCKED_WAKEUP:
+        case BATTERY_WARNING:
+        case LOCKED_VERIFY:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Present one queued event (or none) to the FSM through gKeyEvent and the
+ * button fields of gInputState. Door and battery events only wake the FSM:
+ * the rows read the levels, already updated by Input_Process.
+ */
+static void key_event_load(const KeyQueueEvent_t *ev) {
+    gKeyEvent.keyChar = 0;
+    gKeyEvent.isEnter = 0;
+    gKeyEvent.isEnterLong = 0;
+    gKeyEvent.isBackspace = 0;
+    gInputState.keySensor = 0;
+    gInputState.indoorButton = 0;
+    gInputState.indoorButtonLong = 0;
+    if (ev == NULL) return;
+
+    switch (ev->type) {
+        case KEY_EV_CHAR:        gKeyEvent.keyChar = ev->key; break;
+        case KEY_EV_ENTER:       gKeyEvent.isEnter = 1; break;
+        case KEY_EV_ENTER_LONG:  gKeyEvent.isEnterLong = 1; break;
+        case KEY_EV_BACKSPACE:   gKeyEvent.isBackspace = 1; break;
+        case KEY_EV_INDOOR:      gInputState.indoorButton = 1; break;
+        case KEY_EV_INDOOR_LONG: gInputState.indoorButtonLong = 1; break;
+        case KEY_EV_KEY_SENSOR:  gInputState.keySensor = 1; break;
+        default: break;
+    }
+}
+
+static bool event_is_key(const KeyQueueEvent_t *ev) {
+    return ev->type == KEY_EV_CHAR || ev->type == KEY_EV_ENTER ||
+           ev->type == KEY_EV_ENTER_LONG || ev->type == KEY_EV_BACKSPACE;
+}
+
+/* Next event for the FSM: keys held back come first once the state takes
+ * keys again. Keys arriving in a busy state are set aside (dropped when
+ * the buffer is full, like a full queue), other events go through.
+ */
+static bool event_next(KeyQueueEvent_t *ev) {
+    if (deferredCount > 0 && !state_defers_keys()) {
+        *ev = deferredKeys[deferredHead];
+        deferredHead = (uint8_t)((deferredHead + 1) % KEY_QUEUE_SIZE);
+        deferredCount--;
+        return true;
+    }
+    while (KeyQueue_Pop(ev)) {
+        if (!event_is_key(ev) || !state_defers_keys()) return true;
+        if (deferredCount < KEY_QUEUE_SIZE) {
+            deferredKeys[(deferredHead + deferredCount) % KEY_QUEUE_SIZE] = *ev;
+            deferredCount++;
+        }
+    }
+    return false;
+}
+
+static void state_step(void);
+
+/* One FSM step, 'inputMs' = sampling time of the input presented (NULL if
+ * none). A transition made on an input remembers its time; the solenoid
+ * change it leads to, maybe a few steps later, hands it to Output_Process.
+ */
+static void state_step_traced(const uint32_t *inputMs) {
+    uint8_t prevState = gSystemState.currentState;
+    Solenoid_t prevSolenoid = gOutputStatus.solenoid;
+    bool prevDefers = state_defers_keys();
+
+#ifdef STATE_STEP_HOOK
+    STATE_STEP_HOOK();
+#endif
+    state_step();
+
+    if (gSystemState.currentState != prevState)
+    {
+        if (inputMs != NULL)
+        {
+            causeMs = *inputMs;
+            causeValid = true;
+        }
+        else if (!prevDefers)
+        {
+            causeValid = false; // Timeout: no input behind it
+        }
+    }
+    if (gOutputStatus.solenoid != prevSolenoid)
+    {
+        gOutputStatus.solenoidCauseMs = causeMs;
+        gOutputStatus.solenoidCause = causeValid;
+        causeValid = false;
+    }
+}
+
+/* Run to completion: the first step takes the event, the next ones (no
+ * event) run the entry actions and level checks of each state reached.
+ */
+static void state_run(const uint32_t *inputMs) {
+    for (uint8_t n = 0; n < STATE_MAX_CHAIN; n++) {
+        uint8_t prevState = gSystemState.currentState;
+        state_step_traced(inputMs);
+        if (gSystemState.currentState == prevState && !entryPending) break;
+        key_event_load(NULL); // Unused events are dropped
+    }
 }
 
 // --- Main API ---
 
 void State_Init(void) {
     gSystemState.currentState = LOCKED_SLEEP;
+    entryPending = true;
     gSystemTimers.failedAttempts = 0;
     gSystemTimers.penaltyLevel = 0;
+    if (penaltyTimer == TW_NONE) penaltyTimer = TW_Create(State_Event_Timer, 0);
+    if (alarmRepeatTimer == TW_NONE) alarmRepeatTimer = TW_Create(State_Event_Timer, 0);
     input_clear();
+    causeValid = false;
+    deferredHead = 0;
+    deferredCount = 0;
+    Atomic_Set_Bits(&stateWake, STATE_WAKE_TIMER); // First run: LOCKED_SLEEP entry
 }
 
 void State_Process(void) {
-    // uint32_t now = HAL_GetTick();
+    KeyQueueEvent_t ev;
+    bool timeout = Atomic_Consume_Bits(&stateWake, STATE_WAKE_TIMER) != 0;
 
-    // --- GLOBAL OVERRIDES (Highest Priority) ---
+    // Nothing posted and no timer expired: the FSM stays idle
+    if (!timeout && KeyQueue_Count() == 0) return;
 
-    /* Mechanical Key OR Indoor Button (Short Press)
-     * Acts as Master Unlock in locked states.
+    if (timeout)
+    {
+        key_event_load(NULL);
+        state_run(NULL);
+    }
+
+    /* One run per event, so a burst typed within a tick is entered
+     * completely and in order. Keys a state does not use are dropped,
+     * except in the busy states (state_defers_keys).
      */
-    if (gInputState.keySensor == 1 || gInputState.indoorButton == 1)
+    while (event_next(&ev))
     {
-        // Override conditions: Not already open logic (to prevent state hopping)
-        if (gSystemState.currentState <= PERMANENT_LOCKOUT ||
-            gSystemState.currentState == LOCKED_RELOCK ||
-            gSystemState.currentState == ALARM_FORGOTCLOSE) // Emergency open even if alarming
-        {
-            gSystemState.currentState = UNLOCKED_WAITOPEN;
-            setTimer(UNLOCK_WINDOW_ID, TIMEOUT_10S_CYCLES);
+        Latency_Record(LATENCY_KEY_TO_FSM, HAL_GetTick() - ev.timeMs);
+        key_event_load(&ev);
+        state_run(&ev.timeMs);
+    }
+}
 
-            // Reset Penalties
-            gSystemTimers.failedAttempts = 0;
-            gSystemTimers.penaltyEndTick = 0;
+// --- FSM Table ---
 
-            // Consume events
-            gInputState.keySensor = 0;
-            gInputState.indoorButton = 0;
-            return; // Exit immediately to next cycle
-        }
-    }
+/* Events the transition rows are keyed on. Each is tested at most once per
+ * step, when a row of the current state first asks for it: the timer events
+ * consume their expiry as they are read, so rows are tested in table order
+ * and a state only consumes the timers it has rows for.
+ */
+typedef enum {
+    EV_ALWAYS = 0,
+    EV_KEY,             // gKeyEvent.keyChar
+    EV_ENTER,
+    EV_ENTER_LONG,
+    EV_BACKSPACE,
+    EV_DOOR_OPEN,       // Level: gInputState.doorSensor == 0
+    EV_DOOR_CLOSED,
+    EV_INDOOR_LONG,
+    EV_MASTER_UNLOCK,   // Mechanical key or indoor button (short press)
+    EV_MASK_TIMEOUT,
+    EV_WARNING_TIMEOUT,
+    EV_ENTRY_TIMEOUT,
+    EV_UNLOCK_TIMEOUT,
+    EV_PENALTY_END,
+    EV_ALARM_REPEAT,
+    EV_COUNT
+} FsmEvent_t;
+
+#define FSM_STAY        0       // Internal transition: no exit / entry
+#define FSM_CONTINUE    0x01    // Keep testing the state's next rows
+
+typedef struct {
+    uint8_t event;
+    bool (*guard)(void);        // NULL = no guard
+    void (*action)(void);       // NULL = no action
+    uint8_t next;               // Target state or FSM_STAY
+    uint8_t flags;
+} FsmTransition_t;
+
+/* Entry runs once, on the first step spent in the state: a master unlock
+ * taken on that step leaves it without entering it.
+ */
+typedef struct {
+    Solenoid_t solenoid;
+    Led_t ledRed;
+    Led_t ledGreen;
+    bool silence;               // buzzer_off() on entry
+    void (*entry)(void);        // NULL = outputs only
+    void (*exit)(void);
+    const FsmTransition_t *rows;    // Priority order
+    uint8_t rowCount;
+} FsmState_t;
+
+#define FSM_ROWS(r)     (r), (uint8_t)(sizeof(r) / sizeof((r)[0]))
+
+static uint16_t eventTested;        // Per step cache, bit = FsmEvent_t
+static uint16_t eventPresent;
+
+// Guards
+
+static bool override_allowed(void) {
+    // Not already open logic (to prevent state hopping), emergency open even if alarming
+    return gSystemState.currentState <= PERMANENT_LOCKOUT ||
+           gSystemState.currentState == LOCKED_RELOCK ||
+           gSystemState.currentState == ALARM_FORGOTCLOSE;
+}
 
-    // --- STATE MACHINE LOGIC ---
+static bool battery_low(void) { return gInputState.batteryLow != 0; }
 
-    switch (gSystemState.currentState) {
-        case LOCKED_SLEEP:
-            gOutputStatus.solenoid = SOLENOID_LOCKED;
-            gOutputStatus.ledRed = LED_OFF;
-            gOutputStatus.ledGreen = LED_OFF;
-            gOutputStatus.buzzer = BUZZER_OFF;
-            // Transitions:
-            // Any Key -> Wakeup
-            if (gKeyEvent.keyChar != 0)
-            {
-                gSystemState.currentState = LOCKED_WAKEUP;
-                gKeyEvent.keyChar = 0;
-                setTimer(MASK_TIMER_ID, 1000);
-            }
-            break;
+static bool verify_bad_format(void) {
+    return !isShowingError && (inputLen < PASSWORD_LENGTH || inputLen > MAX_INPUT_LENGTH);
+}
 
-        case LOCKED_WAKEUP:
-        	// Ensuring entry safety
-        	input_clear();
-            gOutputStatus.solenoid = SOLENOID_LOCKED;
-            gOutputStatus.ledRed = LED_ON;
-            gOutputStatus.ledGreen = LED_OFF;
-            gOutputStatus.buzzer = BUZZER_OFF;
-            // Check Battery
-        	if (timer_flag[MASK_TIMER_ID] == 1){
-				if (gInputState.batteryLow)
-				{
-					gSystemState.currentState = BATTERY_WARNING;
-					setTimer(WARNING_TASK_ID, TIMEOUT_3S_CYCLES);
-				} else {
-					gSystemState.currentState = LOCKED_ENTRY;
-					setTimer(ENTRY_TIMEOUT_ID, TIMEOUT_30S_CYCLES);
-				}
-        	}
-            break;
+static bool verify_correct(void) { return !isShowingError && verify_password(); }
 
-        case BATTERY_WARNING:
-        	// Do:
-            gOutputStatus.solenoid = SOLENOID_LOCKED;
-            gOutputStatus.ledRed = LED_ON;
-            gOutputStatus.ledGreen = LED_OFF;
-            gOutputStatus.buzzer = BUZZER_OFF;
-            // Transitions: After 3s -> Locked Entry
-            if (timer_flag[WARNING_TASK_ID] == 1)
-            {
-                gSystemState.currentState = LOCKED_ENTRY;
-                setTimer(ENTRY_TIMEOUT_ID, TIMEOUT_30S_CYCLES);
-            }
-            break;
+/* Wrong password: every third attempt is penalised, the 15th locks out */
+static bool verify_lockout(void) {
+    uint32_t attempts = gSystemTimers.failedAttempts + 1;
+    return !isShowingError && (attempts % 3) == 0 && attempts >= 15;
+}
 
-        case LOCKED_ENTRY:
-        	// Do:
-            gOutputStatus.solenoid = SOLENOID_LOCKED;
-            gOutputStatus.ledRed = LED_ON;
-            gOutputStatus.ledGreen = LED_OFF;
-            gOutputStatus.buzzer = BUZZER_OFF;
-            // Transitions:
-            // 1. Timeout 30s -> Sleep
-            if (timer_flag[ENTRY_TIMEOUT_ID] == 1)
-            {
-                gSystemState.currentState = LOCKED_SLEEP;
-            }
-            // 2. Enter Pressed -> Verify
-            else if (gKeyEvent.isEnter)
-            {
-                gSystemState.currentState = LOCKED_VERIFY;
-                isShowingError = false; // Reset error flag
-                gKeyEvent.isEnter = 0;
-            }
-            // 3. Input Handling
-            else if (gKeyEvent.isBackspace)
-            {
-                input_backspace();
-                setTimer(ENTRY_TIMEOUT_ID, TIMEOUT_30S_CYCLES); // Reset timeout
-                gKeyEvent.isBackspace = 0;
-            }
-            else if (gKeyEvent.keyChar != 0)
-            {
-                input_append(gKeyEvent.keyChar);
-                setTimer(ENTRY_TIMEOUT_ID, TIMEOUT_30S_CYCLES); // Reset timeout
-                gKeyEvent.keyChar = 0;
-            }
-            break;
+static bool verify_penalty(void) {
+    return !isShowingError && ((gSystemTimers.failedAttempts + 1) % 3) == 0;
+}
 
-        case LOCKED_VERIFY:
-        	// Do:
-            gOutputStatus.solenoid = SOLENOID_LOCKED;
-            gOutputStatus.ledRed = LED_ON;
-            gOutputStatus.ledGreen = LED_OFF;
-            gOutputStatus.buzzer = BUZZER_OFF;
-            // Logic: Check password
-            // If just entered state (isShowingError == false)
-            if (!isShowingError)
-            {
-                bool isCorrect = verify_password();
-
-                // Case A: Format Error (Len < 4 or > 20)
-                if (inputLen < PASSWORD_LENGTH || inputLen > MAX_INPUT_LENGTH)
-                {
-                    isShowingError = true;
-                    setTimer(WARNING_TASK_ID, TIMEOUT_3S_CYCLES); // Show error 3s
-                    // Output processing will check "isShowingError" to display text
-                }
-                // Case B: Correct Password
-                else if (isCorrect)
-                {
-                    gSystemState.currentState = UNLOCKED_WAITOPEN;
-                    setTimer(UNLOCK_WINDOW_ID, TIMEOUT_10S_CYCLES);
-                    gSystemTimers.failedAttempts = 0;
-                    input_clear();
-                }
-                // Case C: Wrong Password
-                else {
-                    gSystemTimers.failedAttempts++;
-                    isShowingError = true;
-                    setTimer(WARNING_TASK_ID, TIMEOUT_3S_CYCLES);
-//                    input_clear();
-
-                    // Check Modulo 3
-                    if ((gSystemTimers.failedAttempts % 3) == 0)
-                    {
-                        // Max attempts reached
-                        if (gSystemTimers.failedAttempts >= 15)
-                        {
-                            gSystemState.currentState = PERMANENT_LOCKOUT;
-                            // Start Buzzer 10s
-                            gOutputStatus.buzzer = BUZZER_ON;
-                            setTimer(BUZZER_TASK_ID, TIMEOUT_10S_CYCLES);
-                        } else { // Penalty Timer
-                            uint8_t level = gSystemTimers.failedAttempts / 3;
-                            activate_penalty(level);
-                            gSystemState.currentState = PENALTY_TIMER;
-                            gOutputStatus.buzzer = BUZZER_ON;
-                            setTimer(BUZZER_TASK_ID, TIMEOUT_10S_CYCLES);
-                        }
-                    } else { // Normal Wrong (Not divisible by 3)
-                        isShowingError = true;
-                        setTimer(WARNING_TASK_ID, TIMEOUT_3S_CYCLES); // Show error 3s
-                    }
-                }
-            }
-            // If showing error (Wait for 3s timer)
-            else {
-                if (timer_flag[WARNING_TASK_ID] == 1)
-                {
-                    gSystemState.currentState = LOCKED_ENTRY;
-                    input_clear();
-                    setTimer(ENTRY_TIMEOUT_ID, TIMEOUT_30S_CYCLES);
-                }
-            }
-            break;
+static bool verify_wrong(void) { return !isShowingError; }
 
-        case PENALTY_TIMER:
-        	// Do:
-            gOutputStatus.solenoid = SOLENOID_LOCKED;
-            gOutputStatus.ledRed = LED_ON;
-            gOutputStatus.ledGreen = LED_OFF;
-            // gOutputStatus.buzzer = BUZZER_OFF;
-            // Logic: Wait for penalty end
-            // 1. Buzzer timeout (10s)
-            if (timer_flag[BUZZER_TASK_ID] == 1)
-            {
-                gOutputStatus.buzzer = BUZZER_OFF;
-            }
-            // 2. Check Penalty Time
-            if (HAL_GetTick() >= gSystemTimers.penaltyEndTick)
-            {
-                gSystemState.currentState = LOCKED_ENTRY;
-                input_clear();
-                setTimer(ENTRY_TIMEOUT_ID, TIMEOUT_30S_CYCLES);
-            }
-            break;
+static bool showing_error(void) { return isShowingError; }
 
-        case PERMANENT_LOCKOUT:
-        	// Do:
-            gOutputStatus.solenoid = SOLENOID_LOCKED;
-            gOutputStatus.ledRed = LED_ON;
-            gOutputStatus.ledGreen = LED_OFF;
-            // gOutputStatus.buzzer = BUZZER_OFF;
-            // Logic: Infinite loop until Master Key (Handled in Global Overrides)
-            // Buzzer timeout
-            if (timer_flag[BUZZER_TASK_ID] == 1)
-            {
-                gOutputStatus.buzzer = BUZZER_OFF;
-            }
-            break;
+static bool new_password_ok(void) { return inputLen == PASSWORD_LENGTH; }
 
-        case UNLOCKED_WAITOPEN:
-        	// Do:
-            gOutputStatus.solenoid = SOLENOID_UNLOCKED;
-            gOutputStatus.ledRed = LED_OFF;
-            gOutputStatus.ledGreen = LED_ON;
-            gOutputStatus.buzzer = BUZZER_OFF;
-            // Transitions:
-            // 1. Door Opens -> DoorOpen
-            if (gInputState.doorSensor == 0)
-            {
-                gSystemState.currentState = UNLOCKED_DOOROPEN;
-                setTimer(UNLOCK_WINDOW_ID, TIMEOUT_30S_CYCLES);
-            }
-            // 2. Timeout 10s (Door never opened) -> Relock
-            else if (timer_flag[UNLOCK_WINDOW_ID] == 1)
-            {
-                gSystemState.currentState = LOCKED_RELOCK;
-                setTimer(WARNING_TASK_ID, TIMEOUT_3S_CYCLES);
-            }
-            // 3. Enter Long Press -> Set Password
-            else if (gKeyEvent.isEnterLong)
-            {
-                gSystemState.currentState = UNLOCKED_SETPASSWORD;
-                input_clear();
-                setTimer(ENTRY_TIMEOUT_ID, TIMEOUT_30S_CYCLES);
-                gKeyEvent.isEnterLong = 0;
-            }
-            break;
+static bool alarm_active(void) { return gSystemState.currentState == ALARM_FORGOTCLOSE; }
 
-        case UNLOCKED_SETPASSWORD:
-        	// Do:
-            gOutputStatus.solenoid = SOLENOID_UNLOCKED;
-            gOutputStatus.ledRed = LED_OFF;
-            gOutputStatus.ledGreen = LED_ON;
-            gOutputStatus.buzzer = BUZZER_OFF;
-            // Logic: Input new password
-            // 1. Timeout 30s -> WaitOpen
-            if (timer_flag[ENTRY_TIMEOUT_ID] == 1)
-            {
-                gSystemState.currentState = UNLOCKED_WAITOPEN;
-                setTimer(UNLOCK_WINDOW_ID, TIMEOUT_10S_CYCLES);
-            }
-            // 2. Enter Pressed -> Save
-            else if (gKeyEvent.isEnter)
-            {
-                if (inputLen == PASSWORD_LENGTH)
-                {
-                    State_SetPassword(inputBuffer); // Update global password
-                    gSystemState.currentState = LOCKED_RELOCK;
-                    setTimer(WARNING_TASK_ID, TIMEOUT_3S_CYCLES);
-                } else {
-                    gSystemState.currentState = UNLOCKED_WAITOPEN;
-                    setTimer(UNLOCK_WINDOW_ID, TIMEOUT_10S_CYCLES);
-                }
-                gKeyEvent.isEnter = 0;
-            }
-            // 3. Input
-            else if (gKeyEvent.keyChar != 0)
-            {
-                // Only allow input up to 4 chars
-                if (inputLen < PASSWORD_LENGTH)
-                {
-                    input_append(gKeyEvent.keyChar);
-                }
-                setTimer(ENTRY_TIMEOUT_ID, TIMEOUT_30S_CYCLES);
-                gKeyEvent.keyChar = 0;
-            }
-            else if (gKeyEvent.isBackspace)
-            {
-                input_backspace();
-                setTimer(ENTRY_TIMEOUT_ID, TIMEOUT_30S_CYCLES);
-                gKeyEvent.isBackspace = 0;
-            }
-            break;
+// Actions
 
-        case UNLOCKED_DOOROPEN:
-        	// Do:
-            gOutputStatus.solenoid = SOLENOID_UNLOCKED;
-            gOutputStatus.ledRed = LED_OFF;
-            gOutputStatus.ledGreen = LED_ON;
-            // gOutputStatus.buzzer = BUZZER_OFF;
-            // Transitions:
-            // 1. Door Closes -> WaitClose
-            if (gInputState.doorSensor == 1)
-            {
-                gSystemState.currentState = UNLOCKED_WAITCLOSE;
-                setTimer(UNLOCK_WINDOW_ID, TIMEOUT_10S_CYCLES);
-            }
-            // 2. Indoor Button Long Press -> Always Open
-            else if (gInputState.indoorButtonLong)
-            {
-                gSystemState.currentState = UNLOCKED_ALWAYSOPEN;
-                gInputState.indoorButtonLong = 0;
-            }
-            // 3. Timeout 30s -> Alarm
-            else if (timer_flag[UNLOCK_WINDOW_ID] == 1)
-            {
-                gSystemState.currentState = ALARM_FORGOTCLOSE;
-                gSystemTimers.alarmRepeatTick = HAL_GetTick() + ALARM_REPEAT_MS;
-                // Start Buzzer 10s
-                gOutputStatus.buzzer = BUZZER_ON;
-                setTimer(BUZZER_TASK_ID, TIMEOUT_10S_CYCLES);
-            }
-            break;
+static void master_unlock(void) {
+    setTimer(gUnlockWindowTimer, TIMEOUT_10S_CYCLES);
+    // Reset Penalties
+    gSystemTimers.failedAttempts = 0;
+    gSystemTimers.penaltyEndMs = 0;
+    TW_Stop(penaltyTimer);
+}
 
-        case ALARM_FORGOTCLOSE:
-        	// Do:
-            gOutputStatus.solenoid = SOLENOID_UNLOCKED;
-            gOutputStatus.ledRed = LED_OFF;
-            gOutputStatus.ledGreen = LED_ON;
-            // gOutputStatus.buzzer = BUZZER_OFF;
-            // Transitions:
-            // 1. Door Closes -> WaitClose
-            if (gInputState.doorSensor == 1)
-            {
-                gSystemState.currentState = UNLOCKED_WAITCLOSE;
-                setTimer(UNLOCK_WINDOW_ID, TIMEOUT_10S_CYCLES);
-                gOutputStatus.buzzer = BUZZER_OFF; // Stop alarm
-            }
-            // 2. Buzzer Timeout (10s)
-            if (timer_flag[BUZZER_TASK_ID] == 1)
-            {
-                gOutputStatus.buzzer = BUZZER_OFF;
-            }
-            // 3. Repeat Alarm (5 min)
-            if (HAL_GetTick() >= gSystemTimers.alarmRepeatTick)
-            {
-                gSystemTimers.alarmRepeatTick = HAL_GetTick() + ALARM_REPEAT_MS;
-                gOutputStatus.buzzer = BUZZER_ON;
-                setTimer(BUZZER_TASK_ID, TIMEOUT_10S_CYCLES);
-            }
-            // 4. Long press indoor unlock button -> UNLOCK_ALWAYSOPEN
-			if (gInputState.indoorButtonLong)
-			{
-				gSystemState.currentState = UNLOCKED_ALWAYSOPEN;
-				gInputState.indoorButtonLong = 0;
-			}
-            break;
+static void mask_start(void) { setTimer(gMaskTimer, 1000); }
 
-        case UNLOCKED_WAITCLOSE:
-        	// Do:
-            gOutputStatus.solenoid = SOLENOID_UNLOCKED;
-            gOutputStatus.ledRed = LED_OFF;
-            gOutputStatus.ledGreen = LED_ON;
-            gOutputStatus.buzzer = BUZZER_OFF;
-            // Transitions:
-            // 1. Door Opens again -> DoorOpen
-            if (gInputState.doorSensor == 0)
-            {
-                gSystemState.currentState = UNLOCKED_DOOROPEN;
-                setTimer(UNLOCK_WINDOW_ID, TIMEOUT_30S_CYCLES);
-            }
-            // 2. Timeout 10s -> Relock
-            else if (timer_flag[UNLOCK_WINDOW_ID] == 1)
-            {
-            	setTimer(WARNING_TASK_ID, TIMEOUT_3S_CYCLES);
-                gSystemState.currentState = LOCKED_RELOCK;
-            }
-            break;
+static void warning_start(void) { setTimer(gWarningTimer, TIMEOUT_3S_CYCLES); }
 
-        case UNLOCKED_ALWAYSOPEN:
-        	// Do:
-            gOutputStatus.solenoid = SOLENOID_UNLOCKED;
-            gOutputStatus.ledRed = LED_OFF;
-            gOutputStatus.ledGreen = LED_ON;
-            // gOutputStatus.buzzer = BUZZER_OFF;
-            // Transitions:
-            // 1. Door Closes -> WaitClose (As per user logic)
-            if (gInputState.doorSensor == 1)
-            {
-                gSystemState.currentState = UNLOCKED_WAITCLOSE;
-                setTimer(UNLOCK_WINDOW_ID, TIMEOUT_10S_CYCLES);
-            }
-            break;
+static void entry_start(void) { setTimer(gEntryTimeoutTimer, TIMEOUT_30S_CYCLES); }
 
-        case LOCKED_RELOCK:
-        	// Do:
-            gOutputStatus.solenoid = SOLENOID_LOCKED;
-            gOutputStatus.ledRed = LED_ON;
-            gOutputStatus.ledGreen = LED_OFF;
-            gOutputStatus.buzzer = BUZZER_OFF;
-            // Logic: Wait 3s then Sleep
-            // Note: Reuse WARNING timer for 3s delay
-            if (timer_flag[WARNING_TASK_ID] == 1)
-            {
-                gSystemState.currentState = LOCKED_SLEEP;
-            }
-            break;
+static void unlock_start(void) { setTimer(gUnlockWindowTimer, TIMEOUT_10S_CYCLES); }
 
-        default:
-            gSystemState.currentState = LOCKED_SLEEP;
+static void door_open_start(void) { setTimer(gUnlockWindowTimer, TIMEOUT_30S_CYCLES); }
+
+static void entry_restart(void) {
+    input_clear();
+    entry_start();
+}
+
+static void entry_key(void) {
+    input_append(gKeyEvent.keyChar);
+    entry_start();
+}
+
+static void entry_backspace(void) {
+    input_backspace();
+    entry_start();
+}
+
+static void verify_start(void) { isShowingError = false; }
+
+/* Format error: shown for 3s, output processing checks isShowingError */
+static void verify_show_error(void) {
+    isShowingError = true;
+    warning_start();
+}
+
+static void verify_unlock(void) {
+    unlock_start();
+    gSystemTimers.failedAttempts = 0;
+    input_clear();
+}
+
+static void verify_fail(void) {
+    gSystemTimers.failedAttempts++;
+    verify_show_error();
+}
+
+static void verify_lock_out(void) {
+    verify_fail();
+    buzzer_start(); // 10s alarm
+}
+
+static void verify_penalise(void) {
+    verify_fail();
+    activate_penalty(gSystemTimers.failedAttempts / 3);
+    buzzer_start();
+}
+
+static void penalty_stop(void) { TW_Stop(penaltyTimer); }
+
+static void new_password_key(void) {
+    // Only allow input up to 4 chars
+    if (inputLen < PASSWORD_LENGTH) input_append(gKeyEvent.keyChar);
+    entry_start();
+}
+
+static void new_password_save(void) {
+    State_SetPassword(inputBuffer);
+    warning_start();
+}
+
+static void alarm_start(void) {
+    TW_Start(alarmRepeatTimer, ALARM_REPEAT_MS);
+    buzzer_start();
+}
+
+static void alarm_clear(void) {
+    unlock_start();
+    buzzer_off();
+}
+
+static void alarm_stop(void) { TW_Stop(alarmRepeatTimer); }
+
+// Transitions, in priority order
+
+/* Mechanical key or indoor button: master unlock, ahead of every state's rows */
+static const FsmTransition_t rowsGlobal[] = {
+    { EV_MASTER_UNLOCK,   override_allowed,  master_unlock,     UNLOCKED_WAITOPEN,    0 },
+};
+
+static const FsmTransition_t rowsSleep[] = {
+    { EV_KEY,             NULL,              mask_start,        LOCKED_WAKEUP,        0 },
+};
+
+static const FsmTransition_t rowsWakeup[] = {
+    { EV_MASK_TIMEOUT,    battery_low,       warning_start,     BATTERY_WARNING,      0 },
+    { EV_MASK_TIMEOUT,    NULL,              entry_start,       LOCKED_ENTRY,         0 },
+};
+
+static const FsmTransition_t rowsBattery[] = {
+    { EV_WARNING_TIMEOUT, NULL,              entry_start,       LOCKED_ENTRY,         0 },
+};
+
+static const FsmTransition_t rowsEntry[] = {
+    { EV_ENTRY_TIMEOUT,   NULL,              NULL,              LOCKED_SLEEP,         0 },
+    { EV_ENTER,           NULL,              verify_start,      LOCKED_VERIFY,        0 },
+    { EV_BACKSPACE,       NULL,              entry_backspace,   FSM_STAY,             0 },
+    { EV_KEY,             NULL,              entry_key,         FSM_STAY,             0 },
+};
+
+/* Checked on the first step in the state, then the error shows for 3s */
+static const FsmTransition_t rowsVerify[] = {
+    { EV_ALWAYS,          verify_bad_format, verify_show_error, FSM_STAY,             0 },
+    { EV_ALWAYS,          verify_correct,    verify_unlock,     UNLOCKED_WAITOPEN,    0 },
+    { EV_ALWAYS,          verify_lockout,    verify_lock_out,   PERMANENT_LOCKOUT,    0 },
+    { EV_ALWAYS,          verify_penalty,    verify_penalise,   PENALTY_TIMER,        0 },
+    { EV_ALWAYS,          verify_wrong,      verify_fail,       FSM_STAY,             0 },
+    { EV_WARNING_TIMEOUT, showing_error,     entry_restart,     LOCKED_ENTRY,         0 },
+};
+
+/* The 10s alarm pattern ends by itself */
+static const FsmTransition_t rowsPenalty[] = {
+    { EV_PENALTY_END,     NULL,              entry_restart,     LOCKED_ENTRY,         0 },
+};
+
+static const FsmTransition_t rowsWaitOpen[] = {
+    { EV_DOOR_OPEN,       NULL,              door_open_start,   UNLOCKED_DOOROPEN,    0 },
+    { EV_UNLOCK_TIMEOUT,  NULL,              warning_start,     LOCKED_RELOCK,        0 },
+    { EV_ENTER_LONG,      NULL,              entry_restart,     UNLOCKED_SETPASSWORD, 0 },
+};
+
+static const FsmTransition_t rowsSetPassword[] = {
+    { EV_ENTRY_TIMEOUT,   NULL,              unlock_start,      UNLOCKED_WAITOPEN,    0 },
+    { EV_ENTER,           new_password_ok,   new_password_save, LOCKED_RELOCK,        0 },
+    { EV_ENTER,           NULL,              unlock_start,      UNLOCKED_WAITOPEN,    0 },
+    { EV_KEY,             NULL,              new_password_key,  FSM_STAY,             0 },
+    { EV_BACKSPACE,       NULL,              entry_backspace,   FSM_STAY,             0 },
+};
+
+static const FsmTransition_t rowsDoorOpen[] = {
+    { EV_DOOR_CLOSED,     NULL,              unlock_start,      UNLOCKED_WAITCLOSE,   0 },
+    { EV_INDOOR_LONG,     NULL,              NULL,              UNLOCKED_ALWAYSOPEN,  0 },
+    { EV_UNLOCK_TIMEOUT,  NULL,              alarm_start,       ALARM_FORGOTCLOSE,    0 },
+};
+
+/* Independent checks: all of them run every step. The repeat is not re-armed
+ * once the door has closed in the same step.
+ */
+static const FsmTransition_t rowsAlarm[] = {
+    { EV_DOOR_CLOSED,     NULL,              alarm_clear,       UNLOCKED_WAITCLOSE,   FSM_CONTINUE },
+    { EV_ALARM_REPEAT,    alarm_active,      alarm_start,       FSM_STAY,             FSM_CONTINUE },
+    { EV_INDOOR_LONG,     NULL,              NULL,              UNLOCKED_ALWAYSOPEN,  FSM_CONTINUE },
+};
+
+static const FsmTransition_t rowsWaitClose[] = {
+    { EV_DOOR_OPEN,       NULL,              door_open_start,   UNLOCKED_DOOROPEN,    0 },
+    { EV_UNLOCK_TIMEOUT,  NULL,              warning_start,     LOCKED_RELOCK,        0 },
+};
+
+static const FsmTransition_t rowsAlwaysOpen[] = {
+    { EV_DOOR_CLOSED,     NULL,              unlock_start,      UNLOCKED_WAITCLOSE,   0 },
+};
+
+static const FsmTransition_t rowsRelock[] = {
+    { EV_WARNING_TIMEOUT, NULL,              NULL,              LOCKED_SLEEP,         0 },
+};
+
+// States, indexed by state number (0 unused)
+static const FsmState_t fsmStates[LOCKED_RELOCK + 1] = {
+    [LOCKED_SLEEP]         = { SOLENOID_LOCKED,   LED_OFF, LED_OFF, true,  NULL,        NULL,         FSM_ROWS(rowsSleep) },
+    [LOCKED_WAKEUP]        = { SOLENOID_LOCKED,   LED_ON,  LED_OFF, true,  input_clear, NULL,         FSM_ROWS(rowsWakeup) },
+    [BATTERY_WARNING]      = { SOLENOID_LOCKED,   LED_ON,  LED_OFF, true,  NULL,        NULL,         FSM_ROWS(rowsBattery) },
+    [LOCKED_ENTRY]         = { SOLENOID_LOCKED,   LED_ON,  LED_OFF, true,  NULL,        NULL,         FSM_ROWS(rowsEntry) },
+    [LOCKED_VERIFY]        = { SOLENOID_LOCKED,   LED_ON,  LED_OFF, true,  NULL,        NULL,         FSM_ROWS(rowsVerify) },
+    [PENALTY_TIMER]        = { SOLENOID_LOCKED,   LED_ON,  LED_OFF, false, NULL,        penalty_stop, FSM_ROWS(rowsPenalty) },
+    [PERMANENT_LOCKOUT]    = { SOLENOID_LOCKED,   LED_ON,  LED_OFF, false, NULL,        NULL,         NULL, 0 }, // Until the master key
+    [UNLOCKED_WAITOPEN]    = { SOLENOID_UNLOCKED, LED_OFF, LED_ON,  true,  NULL,        NULL,         FSM_ROWS(rowsWaitOpen) },
+    [UNLOCKED_SETPASSWORD] = { SOLENOID_UNLOCKED, LED_OFF, LED_ON,  true,  NULL,        NULL,         FSM_ROWS(rowsSetPassword) },
+    [UNLOCKED_DOOROPEN]    = { SOLENOID_UNLOCKED, LED_OFF, LED_ON,  false, NULL,        NULL,         FSM_ROWS(rowsDoorOpen) },
+    [ALARM_FORGOTCLOSE]    = { SOLENOID_UNLOCKED, LED_OFF, LED_ON,  false, NULL,        alarm_stop,   FSM_ROWS(rowsAlarm) },
+    [UNLOCKED_WAITCLOSE]   = { SOLENOID_UNLOCKED, LED_OFF, LED_ON,  true,  NULL,        NULL,         FSM_ROWS(rowsWaitClose) },
+    [UNLOCKED_ALWAYSOPEN]  = { SOLENOID_UNLOCKED, LED_OFF, LED_ON,  false, NULL,        NULL,         FSM_ROWS(rowsAlwaysOpen) },
+    [LOCKED_RELOCK]        = { SOLENOID_LOCKED,   LED_ON,  LED_OFF, true,  NULL,        NULL,         FSM_ROWS(rowsRelock) },
+};
+
+// --- FSM Engine ---
+
+static bool fsm_event_test(uint8_t event) {
+    switch (event) {
+        case EV_ALWAYS:          return true;
+        case EV_KEY:             return gKeyEvent.keyChar != 0;
+        case EV_ENTER:           return gKeyEvent.isEnter != 0;
+        case EV_ENTER_LONG:      return gKeyEvent.isEnterLong != 0;
+        case EV_BACKSPACE:       return gKeyEvent.isBackspace != 0;
+        case EV_DOOR_OPEN:       return gInputState.doorSensor == 0;
+        case EV_DOOR_CLOSED:     return gInputState.doorSensor == 1;
+        case EV_INDOOR_LONG:     return gInputState.indoorButtonLong != 0;
+        case EV_MASTER_UNLOCK:   return gInputState.keySensor == 1 || gInputState.indoorButton == 1;
+        case EV_MASK_TIMEOUT:    return timerConsume(gMaskTimer);
+        case EV_WARNING_TIMEOUT: return timerConsume(gWarningTimer);
+        case EV_ENTRY_TIMEOUT:   return timerConsume(gEntryTimeoutTimer);
+        case EV_UNLOCK_TIMEOUT:  return timerConsume(gUnlockWindowTimer);
+        case EV_PENALTY_END:     return TW_Consume(penaltyTimer);
+        case EV_ALARM_REPEAT:    return TW_Consume(alarmRepeatTimer);
+        default:                 return false;
+    }
+}
+
+static bool fsm_event(uint8_t event) {
+    uint16_t bit = (uint16_t)(1u << event);
+    if (!(eventTested & bit)) {
+        eventTested |= bit;
+        if (fsm_event_test(event)) eventPresent |= bit;
+    }
+    return (eventPresent & bit) != 0;
+}
+
+/* A row took the event: clear the flag so it is not seen again */
+static void fsm_event_consume(uint8_t event) {
+    switch (event) {
+        case EV_KEY:           gKeyEvent.keyChar = 0; break;
+        case EV_ENTER:         gKeyEvent.isEnter = 0; break;
+        case EV_ENTER_LONG:    gKeyEvent.isEnterLong = 0; break;
+        case EV_BACKSPACE:     gKeyEvent.isBackspace = 0; break;
+        case EV_INDOOR_LONG:   gInputState.indoorButtonLong = 0; break;
+        case EV_MASTER_UNLOCK:
+            gInputState.keySensor = 0;
+            gInputState.indoorButton = 0;
             break;
+        default: return; // Levels and timers (consumed when tested)
+    }
+    eventPresent &= (uint16_t)~(1u << event);
+}
+
+static void fsm_enter(uint8_t state) {
+    const FsmState_t *s = &fsmStates[state];
+    if (s->entry != NULL) s->entry();
+    gOutputStatus.solenoid = s->solenoid;
+    gOutputStatus.ledRed = s->ledRed;
+    gOutputStatus.ledGreen = s->ledGreen;
+    if (s->silence) buzzer_off();
+    entryPending = false;
+}
+
+static void fsm_fire(const FsmTransition_t *t) {
+    uint8_t state = gSystemState.currentState;
+    if (t->next != FSM_STAY && state <= LOCKED_RELOCK && fsmStates[state].exit != NULL)
+        fsmStates[state].exit();
+    if (t->action != NULL) t->action();
+    if (t->next != FSM_STAY) {
+        gSystemState.currentState = t->next;
+        entryPending = true;
+    }
+}
+
+/* Fire the first matching row (every matching one for FSM_CONTINUE rows) */
+static bool fsm_run_rows(const FsmTransition_t *rows, uint8_t count) {
+    bool fired = false;
+    for (uint8_t i = 0; i < count; i++) {
+        const FsmTransition_t *t = &rows[i];
+        if (!fsm_event(t->event)) continue;
+        if (t->guard != NULL && !t->guard()) continue;
+        fsm_fire(t);
+        fsm_event_consume(t->event);
+        fired = true;
+        if (!(t->flags & FSM_CONTINUE)) break;
+    }
+    return fired;
+}
+
+static void state_step(void) {
+    eventTested = 0;
+    eventPresent = 0;
+
+    // --- GLOBAL OVERRIDES (Highest Priority), exit immediately to next cycle ---
+    if (fsm_run_rows(FSM_ROWS(rowsGlobal))) return;
+
+    if (gSystemState.currentState < LOCKED_SLEEP || gSystemState.currentState > LOCKED_RELOCK) {
+        gSystemState.currentState = LOCKED_SLEEP;
+        entryPending = true;
+        return;
     }
+
+    uint8_t state = gSystemState.currentState;
+    if (entryPending) fsm_enter(state);
+    fsm_run_rows(fsmStates[state].rows, fsmStates[state].rowCount);
 }
 
 // --- API Implementation ---
+
+/* Producer side of the event queue: Input_Process context only */
+static void state_post(uint8_t type, char key, uint32_t timeMs) {
+    KeyQueueEvent_t ev;
+    ev.type = type;
+    ev.key = key;
+    ev.timeMs = timeMs;
+    (void)KeyQueue_Push(&ev); // Full queue: dropped and counted
+}
+
+void State_Event_KeypadChar(char c, uint32_t timeMs) { state_post(KEY_EV_CHAR, c, timeMs); }
+void State_Event_Enter(uint32_t timeMs) { state_post(KEY_EV_ENTER, 0, timeMs); }
+void State_Event_Enter_Long(uint32_t timeMs) { state_post(KEY_EV_ENTER_LONG, 0, timeMs); }
+void State_Event_Backspace(uint32_t timeMs) { state_post(KEY_EV_BACKSPACE, 0, timeMs); }
+void State_Event_IndoorButton(uint32_t timeMs) { state_post(KEY_EV_INDOOR, 0, timeMs); }
+void State_Event_IndoorButton_Long(uint32_t timeMs) { state_post(KEY_EV_INDOOR_LONG, 0, timeMs); }
+void State_Event_KeySensor(uint32_t timeMs) { state_post(KEY_EV_KEY_SENSOR, 0, timeMs); }
+void State_Event_DoorSensor_Open(uint32_t timeMs) { state_post(KEY_EV_DOOR_OPEN, 0, timeMs); }
+void State_Event_DoorSensor_Close(uint32_t timeMs) { state_post(KEY_EV_DOOR_CLOSE, 0, timeMs); }
+void State_Event_Battery(void) { state_post(KEY_EV_BATTERY, 0, HAL_GetTick()); }
+
+void State_Event_Timer(void) {
+    Atomic_Set_Bits(&stateWake, STATE_WAKE_TIMER);
+}
+
 bool State_SetPassword(const char *newPass) {
     if (strlen(newPass) != PASSWORD_LENGTH) return false;
     strcpy(gPassword, newPass);
     return true;
 }
+
+const char* State_GetPassword(void) {
+    return gPassword;
+}
+
+uint8_t State_GetState(void) {
+    return gSystemState.currentState;
+}
+
+void State_ForceUnlock(void) {
+    static const FsmTransition_t forceUnlock =
+        { EV_ALWAYS,          NULL,              unlock_start,      UNLOCKED_WAITOPEN,    0 };
+
+    fsm_fire(&forceUnlock); // Exit actions of the old state, entry on the next run
+    deferredHead = 0;
+    deferredCount = 0;
+    Atomic_Set_Bits(&stateWake, STATE_WAKE_TIMER);
+}
@@ -0,0 +1,140 @@
+/*
+ * task_profiler.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: Per-task min/max/mean execution time, start jitter and
+ * overrun counters, sampled around every run in SCH_Dispatch_Tasks.
+ */
+#include "task_profiler.h"
+
+#if SCH_PROFILING
+
+#include <stdio.h>
+#include <string.h>
+
+#if SCH_STATIC_TASKS
+#include "task_table.h"
+#define PROF_SLOTS				(SCH_MAX_TASKS + SCH_STATIC_TASK_COUNT)
+#else
+#define PROF_SLOTS				SCH_MAX_TASKS
+#endif
+
+#if defined(__arm__)
+#include "main.h"
+
+#define PROF_NOW()				(DWT->CYCCNT)
+#define PROF_UNITS_PER_TICK		(SystemCoreClock / 100)		// 10 ms tick
+#define PROF_UNIT				"cyc"
+#define PROF_UNITS_PER_US		(SystemCoreClock / 1000000)
+
+static void prof_clock_init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+#else
+#include <time.h>
+
+#define PROF_NOW()				prof_host_now()
+#define PROF_UNITS_PER_TICK		10000000UL					// 10 ms in ns
+#define PROF_UNIT				"ns"
+#define PROF_UNITS_PER_US		1000UL
+
+static uint32_t prof_host_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+static void prof_clock_init(void)
+{
+}
+#endif
+
+static TaskProfile_t profTable[PROF_SLOTS];
+static uint32_t profReleaseStamp[PROF_SLOTS];
+static volatile uint32_t profTickStamp = 0;
+
+void Prof_Init(void)
+{
+    prof_clock_init();
+    memset(profTable, 0, sizeof(profTable));
+    memset(profReleaseStamp, 0, sizeof(profReleaseStamp));
+}
+
+void Prof_Tick(void)
+{
+    profTickStamp = PROF_NOW();
+}
+
+void Prof_Release(uint8_t slot, uint32_t lag)
+{
+    // Ticks drained late happened 'lag' periods before the latest ISR stamp
+    profReleaseStamp[slot] = profTickStamp - lag * PROF_UNITS_PER_TICK;
+}
+
+uint32_t Prof_Begin(void)
+{
+    return PROF_NOW();
+}
+
+void Prof_End(uint8_t slot, void (*pTask)(void), uint32_t period, uint32_t start)
+{
+    uint32_t cycles = PROF_NOW() - start;
+    uint32_t jitter = start - profReleaseStamp[slot];
+    TaskProfile_t *p = &profTable[slot];
+
+    // New task in this slot: start over
+    if (p->pTask != pTask)
+    {
+        memset(p, 0, sizeof(TaskProfile_t));
+        p->pTask = pTask;
+        p->minCycles = 0xFFFFFFFF;
+    }
+
+    p->runs++;
+    p->totalCycles += cycles;
+    p->totalJitter += jitter;
+    if (cycles < p->minCycles) p->minCycles = cycles;
+    if (cycles > p->maxCycles) p->maxCycles = cycles;
+    if (jitter > p->maxJitter) p->maxJitter = jitter;
+    if (period > 0 && cycles > period * PROF_UNITS_PER_TICK) p->overruns++;
+}
+
+const TaskProfile_t* Prof_Get(uint8_t slot)
+{
+    if (slot >= PROF_SLOTS || profTable[slot].runs == 0) return NULL;
+    return &profTable[slot];
+}
+
+uint32_t Prof_Mean_Us(uint8_t slot)
+{
+    const TaskProfile_t *p = Prof_Get(slot);
+    if (p == NULL) return 0;
+    return (uint32_t)(p->totalCycles / p->runs / PROF_UNITS_PER_US);
+}
+
+void Prof_Dump(void (*print)(const char *line))
+{
+    char line[96];
+
+    for (uint8_t i = 0; i < PROF_SLOTS; i++)
+    {
+        const TaskProfile_t *p = Prof_Get(i);
+        if (p == NULL) continue;
+
+        snprintf(line, sizeof(line),
+                 "#%u %p n=%lu min=%lu max=%lu avg=%lu jit=%lu/%lu ovr=%lu " PROF_UNIT,
+                 (unsigned)i, (void*)p->pTask, (unsigned long)p->runs,
+                 (unsigned long)p->minCycles, (unsigned long)p->maxCycles,
+                 (unsigned long)(p->totalCycles / p->runs),
+                 (unsigned long)(p->totalJitter / p->runs), (unsigned long)p->maxJitter,
+                 (unsigned long)p->overruns);
+        print(line);
+    }
+}
+
+#endif /* SCH_PROFILING */
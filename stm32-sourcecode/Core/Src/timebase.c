@@ -0,0 +1,65 @@
+/*
+ * timebase.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: 64-bit millisecond clock built from the TIM2 update count and
+ * the TIM2 counter, and the HAL tick functions on top of it.
+ */
+#include "timebase.h"
+#include "main.h"
+
+/* Milliseconds up to the start of the current TIM2 period. Written by the
+ * TIM2 interrupt only; read with interrupts masked since it is two words.
+ */
+static volatile uint64_t tbBaseMs = TIMEBASE_START_MS;
+
+void Timebase_Advance(uint32_t ms)
+{
+	tbBaseMs += ms;
+}
+
+/* Interrupts that preempt TIM2 may read the clock between the update and
+ * Timebase_Advance and see the old period: keep TIM2 at the highest priority
+ * of the interrupts that need time.
+ */
+uint64_t Timebase_Now_Ms(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uint64_t base = tbBaseMs;
+	uint32_t cnt = TIM2->CNT;
+
+	// Period ended but its interrupt did not run yet (masked or pending)
+	if (TIM2->SR & TIM_SR_UIF) {
+		cnt = TIM2->CNT;
+		base += TIM2->ARR + 1;
+	}
+
+	if (!primask) __enable_irq();
+	return base + cnt;
+}
+
+/* HAL time base: no SysTick, TIM2 is started by main. HAL_GetTick reads 0
+ * until HAL_TIM_Base_Start_IT(&htim2): HAL_Delay must not be used before
+ * that, it would never return (the LCD driver only runs from the pipeline).
+ */
+HAL_StatusTypeDef HAL_InitTick(uint32_t TickPriority)
+{
+	(void)TickPriority;
+	return HAL_OK;
+}
+
+uint32_t HAL_GetTick(void)
+{
+	return (uint32_t)Timebase_Now_Ms();
+}
+
+void HAL_SuspendTick(void)
+{
+}
+
+void HAL_ResumeTick(void)
+{
+}
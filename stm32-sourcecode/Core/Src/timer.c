@@ -5,29 +5,215 @@
  *      Author: nguye
  */
 #include "timer.h"
+#include "global.h"
+#include "scheduler.h"
+#include "atomic_bits.h"
 
+#define TIMER_NO_LINK	0xFF
 
-void setTimer(int task_id, int duration)
+typedef struct {
+	void (*callback)(void);
+	uint32_t signals;		// SCH_Signal bits posted on expiry
+	uint32_t delta;			// Ticks after the previous timer in the list
+	uint32_t period;		// Reload in ticks, 0 = one-shot
+	uint8_t next;
+	uint8_t inUse;
+	uint8_t running;
+} SoftTimer_t;
+
+#define TIMER_BIT_WORDS	((MAX_SOFT_TIMERS + 31) / 32)
+#define TIMER_BIT_WORD(id)	(&timerExpiredBits[(id) >> 5])
+#define TIMER_BIT(id)		(1u << ((id) & 31))
+
+_Static_assert(MAX_SOFT_TIMERS < TIMER_NO_LINK, "ids must fit in a link");
+
+static SoftTimer_t timers[MAX_SOFT_TIMERS];
+static uint8_t timerHead = TIMER_NO_LINK;
+static atomic_bits_t timerExpiredBits[TIMER_BIT_WORDS];	// Bit id set by the ISR on expiry
+
+/* The list is also walked by the TIM2 ISR */
+#define TIMER_LOCK()	uint32_t primask = __get_PRIMASK(); __disable_irq()
+#define TIMER_UNLOCK()	if (!primask) __enable_irq()
+
+
+static int timer_valid(int id)
+{
+	return id >= 0 && id < MAX_SOFT_TIMERS && timers[id].inUse;
+}
+
+static void timer_insert(uint8_t id, uint32_t ticks)
 {
-	if (task_id >= 0 && task_id < NUM_TASKS)
+	uint8_t prev = TIMER_NO_LINK;
+	uint8_t cur = timerHead;
+
+	while (cur != TIMER_NO_LINK && ticks >= timers[cur].delta)
 	{
-		timer_counter[task_id] = duration/TIMER_CYCLE;
-		timer_flag[task_id] = 0;
+		ticks -= timers[cur].delta;
+		prev = cur;
+		cur = timers[cur].next;
 	}
+
+	timers[id].delta = ticks;
+	timers[id].next = cur;
+	timers[id].running = 1;
+	if (prev != TIMER_NO_LINK)
+		timers[prev].next = id;
+	else
+		timerHead = id;
+	if (cur != TIMER_NO_LINK)
+		timers[cur].delta -= ticks;
+}
+
+static void timer_unlink(uint8_t id)
+{
+	if (!timers[id].running) return;
+
+	uint8_t *link = &timerHead;
+	while (*link != id)
+		link = &timers[*link].next;
+	*link = timers[id].next;
+
+	if (timers[id].next != TIMER_NO_LINK)
+		timers[timers[id].next].delta += timers[id].delta;
+	timers[id].next = TIMER_NO_LINK;
+	timers[id].running = 0;
+}
+
+static void timer_start(int id, int duration, int periodic)
+{
+	if (!timer_valid(id)) return;
+
+	uint32_t ticks = (duration > 0) ? duration / TIMER_CYCLE : 0;
+
+	TIMER_LOCK();
+	timer_unlink(id);
+	Atomic_Consume_Bits(TIMER_BIT_WORD(id), TIMER_BIT(id));
+	timers[id].period = periodic ? ticks : 0;
+	if (ticks > 0)
+		timer_insert(id, ticks);
+	else
+		Atomic_Set_Bits(TIMER_BIT_WORD(id), TIMER_BIT(id));
+	TIMER_UNLOCK();
+}
+
+
+/* Takes a free timer from the pool, TIMER_NONE if the pool is empty.
+ * callback and signals may be NULL / 0 when the owner polls timerExpired.
+ */
+int timerCreate(void (*callback)(void), uint32_t signals)
+{
+	int id = TIMER_NONE;
+
+	TIMER_LOCK();
+	for (int i = 0; i < MAX_SOFT_TIMERS; i++)
+	{
+		if (!timers[i].inUse)
+		{
+			timers[i].callback = callback;
+			timers[i].signals = signals;
+			timers[i].period = 0;
+			timers[i].next = TIMER_NO_LINK;
+			timers[i].running = 0;
+			timers[i].inUse = 1;
+			Atomic_Consume_Bits(TIMER_BIT_WORD(i), TIMER_BIT(i));
+			id = i;
+			break;
+		}
+	}
+	TIMER_UNLOCK();
+	return id;
+}
+
+void timerDelete(int id)
+{
+	if (!timer_valid(id)) return;
+
+	TIMER_LOCK();
+	timer_unlink(id);
+	timers[id].inUse = 0;
+	TIMER_UNLOCK();
+}
+
+void setTimer(int id, int duration)
+{
+	timer_start(id, duration, 0);
+}
+
+void setTimerPeriodic(int id, int period)
+{
+	timer_start(id, period, 1);
+}
+
+void stopTimer(int id)
+{
+	if (!timer_valid(id)) return;
+
+	TIMER_LOCK();
+	timer_unlink(id);
+	Atomic_Consume_Bits(TIMER_BIT_WORD(id), TIMER_BIT(id));
+	TIMER_UNLOCK();
+}
+
+int timerRunning(int id)
+{
+	return timer_valid(id) && timers[id].running;
+}
+
+int timerExpired(int id)
+{
+	return timer_valid(id) && (*TIMER_BIT_WORD(id) & TIMER_BIT(id)) != 0;
+}
+
+/* Returns 1 once per expiry: the bit is cleared as it is read */
+int timerConsume(int id)
+{
+	return timer_valid(id) && Atomic_Consume_Bits(TIMER_BIT_WORD(id), TIMER_BIT(id)) != 0;
 }
 
 
 void timerRun()
 {
-	for (int i = 0; i < NUM_TASKS; i++)
+	timerAdvance(1);
+}
+
+
+uint32_t timerNextDue(void)
+{
+	return (timerHead != TIMER_NO_LINK) ? timers[timerHead].delta : SCH_IDLE_FOREVER;
+}
+
+
+/* Account for several ticks at once (TIM2 period stretched by tickless idle).
+ * Only the head is decremented; every timer whose deadline falls inside the
+ * advanced span expires, in deadline order.
+ */
+void timerAdvance(int ticks)
+{
+	uint32_t left = (ticks > 0) ? ticks : 0;
+
+	while (left > 0 && timerHead != TIMER_NO_LINK)
 	{
-		if (timer_counter[i] > 0)
+		SoftTimer_t *t = &timers[timerHead];
+		if (t->delta > left)
 		{
-			timer_counter[i]--;
-			if (timer_counter[i] <= 0)
-			{
-				timer_flag[i] = 1;
-			}
+			t->delta -= left;
+			return;
 		}
+		left -= t->delta;
+
+		// Expire the head and every timer due on the same tick
+		do {
+			uint8_t id = timerHead;
+			t = &timers[id];
+			timerHead = t->next;
+			t->next = TIMER_NO_LINK;
+			t->running = 0;
+			if (t->period > 0)
+				timer_insert(id, t->period);
+
+			Atomic_Set_Bits(TIMER_BIT_WORD(id), TIMER_BIT(id));
+			if (t->signals) SCH_Signal(t->signals);
+			if (t->callback) t->callback();
+		} while (timerHead != TIMER_NO_LINK && timers[timerHead].delta == 0);
 	}
 }
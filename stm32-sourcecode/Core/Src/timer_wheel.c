@@ -0,0 +1,282 @@
+/*
+ * timer_wheel.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: Three-level timing wheel (10 ms / 1 s / 1 min) used for the
+ * penalty lockout and forgot-close alarm deadlines.
+ */
+#include "timer_wheel.h"
+#include "main.h"
+#include "scheduler.h"
+#include "atomic_bits.h"
+
+#define TW_L0_SLOTS			100		// 10 ms ticks in a second
+#define TW_L1_SLOTS			60		// Seconds in a minute
+#define TW_L2_SLOTS			64		// Minutes, horizon of the wheel
+#define TW_TICKS_PER_S		TW_L0_SLOTS
+#define TW_NO_LINK			0xFF
+
+typedef struct {
+	void (*callback)(void);
+	uint32_t expire;		// Absolute tick
+	uint32_t signals;		// SCH_Signal bits posted on expiry
+	uint8_t next;
+	uint8_t *slot;			// Head of the slot the timer is linked in
+	uint8_t inUse;
+} WheelTimer_t;
+
+#define TW_BIT_WORDS		((TW_MAX_TIMERS + 31) / 32)
+#define TW_BIT_WORD(id)		(&twExpiredBits[(id) >> 5])
+#define TW_BIT(id)			(1u << ((id) & 31))
+
+_Static_assert(TW_MAX_TIMERS < TW_NO_LINK, "ids must fit in a link");
+
+static WheelTimer_t twTimers[TW_MAX_TIMERS];
+static uint8_t twL0[TW_L0_SLOTS];
+static uint8_t twL1[TW_L1_SLOTS];
+static uint8_t twL2[TW_L2_SLOTS];
+static uint32_t twNow = 0;		// Ticks, only used for differences
+static uint8_t twCur0 = 0;		// Current slot of each level: the time in
+static uint8_t twCur1 = 0;		// ticks / seconds / minutes (mod 64), kept
+static uint8_t twCur2 = 0;		// as digits so the 32-bit wrap is harmless
+static uint8_t twActive = 0;
+static uint8_t twReady = 0;
+static atomic_bits_t twExpiredBits[TW_BIT_WORDS];
+
+/* Shared with the TIM2 interrupt */
+#define TW_LOCK()	uint32_t primask = __get_PRIMASK(); __disable_irq()
+#define TW_UNLOCK()	if (!primask) __enable_irq()
+
+
+static int tw_valid(int id)
+{
+	return id >= 0 && id < TW_MAX_TIMERS && twTimers[id].inUse;
+}
+
+static void tw_init_slots(void)
+{
+	for (uint8_t i = 0; i < TW_L0_SLOTS; i++) twL0[i] = TW_NO_LINK;
+	for (uint8_t i = 0; i < TW_L1_SLOTS; i++) twL1[i] = TW_NO_LINK;
+	for (uint8_t i = 0; i < TW_L2_SLOTS; i++) twL2[i] = TW_NO_LINK;
+	twReady = 1;
+}
+
+static void tw_fire(uint8_t id)
+{
+	Atomic_Set_Bits(TW_BIT_WORD(id), TW_BIT(id));
+	twActive--;
+	if (twTimers[id].signals) SCH_Signal(twTimers[id].signals);
+	if (twTimers[id].callback) twTimers[id].callback();
+}
+
+/* Links a timer into the coarsest level its remaining time allows. A slot
+ * of level 1 / 2 is emptied when its second / minute starts, which is never
+ * after the deadline: the timer then goes one level down.
+ */
+static void tw_insert(uint8_t id)
+{
+	WheelTimer_t *t = &twTimers[id];
+	uint32_t delta = t->expire - twNow;
+	uint8_t *slot;
+
+	if (delta == 0 || delta > 0x7FFFFFFF) {
+		t->slot = 0;
+		tw_fire(id);
+		return;
+	}
+
+	// Deadline as digits: tick in second, seconds / minutes ahead
+	uint32_t ticks = twCur0 + delta;
+	uint32_t secs = twCur1 + ticks / TW_TICKS_PER_S;
+	uint32_t mins = secs / TW_L1_SLOTS;
+
+	if (ticks < TW_TICKS_PER_S)
+		slot = &twL0[ticks];
+	else if (ticks / TW_TICKS_PER_S <= TW_L1_SLOTS)
+		slot = &twL1[secs % TW_L1_SLOTS];
+	else if (mins <= TW_L2_SLOTS)
+		slot = &twL2[(twCur2 + mins) % TW_L2_SLOTS];
+	else
+		slot = &twL2[twCur2]; // Past the horizon: look again in 64 min
+
+	t->slot = slot;
+	t->next = *slot;
+	*slot = id;
+}
+
+static void tw_unlink(uint8_t id)
+{
+	uint8_t *link = twTimers[id].slot;
+	if (link == 0) return;
+
+	while (*link != id)
+		link = &twTimers[*link].next;
+	*link = twTimers[id].next;
+	twTimers[id].slot = 0;
+	twActive--;
+}
+
+/* Empties a slot and re-inserts its timers one level down (or fires them) */
+static void tw_cascade(uint8_t *slot)
+{
+	uint8_t id = *slot;
+	*slot = TW_NO_LINK;
+
+	while (id != TW_NO_LINK)
+	{
+		uint8_t next = twTimers[id].next;
+		tw_insert(id);
+		id = next;
+	}
+}
+
+
+int TW_Create(void (*callback)(void), uint32_t signals)
+{
+	int id = TW_NONE;
+
+	TW_LOCK();
+	if (!twReady) tw_init_slots();
+	for (int i = 0; i < TW_MAX_TIMERS; i++)
+	{
+		if (!twTimers[i].inUse)
+		{
+			twTimers[i].callback = callback;
+			twTimers[i].signals = signals;
+			twTimers[i].slot = 0;
+			twTimers[i].inUse = 1;
+			Atomic_Consume_Bits(TW_BIT_WORD(i), TW_BIT(i));
+			id = i;
+			break;
+		}
+	}
+	TW_UNLOCK();
+	return id;
+}
+
+/* (Re)starts a timer 'ms' from now, rounded up to whole ticks */
+void TW_Start(int id, uint32_t ms)
+{
+	if (!tw_valid(id)) return;
+
+	TW_LOCK();
+	tw_unlink(id);
+	Atomic_Consume_Bits(TW_BIT_WORD(id), TW_BIT(id));
+	twTimers[id].expire = twNow + (ms + SCH_TICK_MS - 1) / SCH_TICK_MS;
+	twActive++;
+	tw_insert(id);
+	TW_UNLOCK();
+}
+
+void TW_Stop(int id)
+{
+	if (!tw_valid(id)) return;
+
+	TW_LOCK();
+	tw_unlink(id);
+	Atomic_Consume_Bits(TW_BIT_WORD(id), TW_BIT(id));
+	TW_UNLOCK();
+}
+
+int TW_Expired(int id)
+{
+	return tw_valid(id) && (*TW_BIT_WORD(id) & TW_BIT(id)) != 0;
+}
+
+/* Returns 1 once per expiry: the bit is cleared as it is read */
+int TW_Consume(int id)
+{
+	return tw_valid(id) && Atomic_Consume_Bits(TW_BIT_WORD(id), TW_BIT(id)) != 0;
+}
+
+int TW_Running(int id)
+{
+	return tw_valid(id) && twTimers[id].slot != 0;
+}
+
+/* One tick: cascades that come up, then the level-0 slot that is due */
+static void tw_tick(void)
+{
+	twNow++;
+	if (++twCur0 == TW_L0_SLOTS)
+	{
+		twCur0 = 0;
+		if (++twCur1 == TW_L1_SLOTS)
+		{
+			twCur1 = 0;
+			twCur2 = (twCur2 + 1) % TW_L2_SLOTS;
+			// Coarse levels first: what they cascade may be due this very tick
+			tw_cascade(&twL2[twCur2]);
+		}
+		tw_cascade(&twL1[twCur1]);
+	}
+
+	uint8_t *slot = &twL0[twCur0];
+	uint8_t id = *slot;
+	*slot = TW_NO_LINK;
+	while (id != TW_NO_LINK)
+	{
+		uint8_t next = twTimers[id].next;
+		twTimers[id].slot = 0;
+		tw_fire(id);
+		id = next;
+	}
+}
+
+/* Moves the clock 'ticks' ahead without visiting a slot: only valid when
+ * none is due and no cascade comes up on the way (or no timer is linked)
+ */
+static void tw_skip(uint32_t ticks)
+{
+	uint32_t total = twCur0 + ticks;
+	uint32_t secs = twCur1 + total / TW_TICKS_PER_S;
+
+	twNow += ticks;
+	twCur0 = (uint8_t)(total % TW_TICKS_PER_S);
+	twCur1 = (uint8_t)(secs % TW_L1_SLOTS);
+	twCur2 = (uint8_t)((twCur2 + secs / TW_L1_SLOTS) % TW_L2_SLOTS);
+}
+
+/* After a long tickless sleep the ticks are not stepped one by one: empty
+ * stretches up to the next due slot or cascade are skipped in one go, so
+ * the cost is per second at most, not per tick.
+ */
+void TW_Advance(uint32_t ticks)
+{
+	if (!twReady) return;
+
+	while (ticks > 0)
+	{
+		if (twActive == 0)
+		{
+			tw_skip(ticks);
+			return;
+		}
+		uint32_t idle = TW_Next_Due() - 1;	// Ticks with nothing to do
+		if (idle > 0)
+		{
+			if (idle > ticks) idle = ticks;
+			tw_skip(idle);
+			ticks -= idle;
+			if (ticks == 0) return;
+		}
+		tw_tick();
+		ticks--;
+	}
+}
+
+/* Up to the next tick with a due level-0 slot or a cascade: the wheel
+ * itself never needs to run before that.
+ */
+uint32_t TW_Next_Due(void)
+{
+	if (twActive == 0) return SCH_IDLE_FOREVER;
+
+	for (uint32_t d = 1; twCur0 + d < TW_L0_SLOTS; d++)
+	{
+		if (twL0[twCur0 + d] != TW_NO_LINK)
+			return d;
+	}
+	return TW_L0_SLOTS - twCur0; // Next cascade
+}
@@ -6,11 +6,15 @@
 # Add inputs and outputs from these tool invocations to the build variables 
 C_SRCS += \
 ../Core/Src/KEYPAD.c \
+../Core/Src/battery_monitor.c \
 ../Core/Src/global.c \
 ../Core/Src/i2c_lcd.c \
 ../Core/Src/input_processing.c \
 ../Core/Src/input_reading.c \
+../Core/Src/key_queue.c \
+../Core/Src/keypad_wake.c \
 ../Core/Src/kmp.c \
+../Core/Src/latency_hist.c \
 ../Core/Src/main.c \
 ../Core/Src/output_processing.c \
 ../Core/Src/scheduler.c \
@@ -20,15 +24,22 @@ C_SRCS += \
 ../Core/Src/syscalls.c \
 ../Core/Src/sysmem.c \
 ../Core/Src/system_stm32f1xx.c \
-../Core/Src/timer.c 
+../Core/Src/task_profiler.c \
+../Core/Src/timebase.c \
+../Core/Src/timer.c \
+../Core/Src/timer_wheel.c 
 
 OBJS += \
 ./Core/Src/KEYPAD.o \
+./Core/Src/battery_monitor.o \
 ./Core/Src/global.o \
 ./Core/Src/i2c_lcd.o \
 ./Core/Src/input_processing.o \
 ./Core/Src/input_reading.o \
+./Core/Src/key_queue.o \
+./Core/Src/keypad_wake.o \
 ./Core/Src/kmp.o \
+./Core/Src/latency_hist.o \
 ./Core/Src/main.o \
 ./Core/Src/output_processing.o \
 ./Core/Src/scheduler.o \
@@ -38,15 +49,22 @@ OBJS += \
 ./Core/Src/syscalls.o \
 ./Core/Src/sysmem.o \
 ./Core/Src/system_stm32f1xx.o \
-./Core/Src/timer.o 
+./Core/Src/task_profiler.o \
+./Core/Src/timebase.o \
+./Core/Src/timer.o \
+./Core/Src/timer_wheel.o 
 
 C_DEPS += \
 ./Core/Src/KEYPAD.d \
+./Core/Src/battery_monitor.d \
 ./Core/Src/global.d \
 ./Core/Src/i2c_lcd.d \
 ./Core/Src/input_processing.d \
 ./Core/Src/input_reading.d \
+./Core/Src/key_queue.d \
+./Core/Src/keypad_wake.d \
 ./Core/Src/kmp.d \
+./Core/Src/latency_hist.d \
 ./Core/Src/main.d \
 ./Core/Src/output_processing.d \
 ./Core/Src/scheduler.d \
@@ -56,7 +74,10 @@ C_DEPS += \
 ./Core/Src/syscalls.d \
 ./Core/Src/sysmem.d \
 ./Core/Src/system_stm32f1xx.d \
-./Core/Src/timer.d 
+./Core/Src/task_profiler.d \
+./Core/Src/timebase.d \
+./Core/Src/timer.d \
+./Core/Src/timer_wheel.d 
 
 
 # Each subdirectory must supply rules for building sources it contributes
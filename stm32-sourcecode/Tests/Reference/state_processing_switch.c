@@ -0,0 +1,725 @@
+/*
+ * state_processing_switch.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: Test-only reference for fsm_trace / test_fsm_diff: the FSM as
+ * a switch statement, the version the transition table in
+ * Core/Src/state_processing.c replaced, behind the same event queue and
+ * run-to-completion engine. Same API, linked instead of state_processing.c.
+ */
+#include "state_processing.h"
+#include "global.h"
+#include "kmp.h"
+#include "timer.h"
+#include "scheduler.h"
+#include "pt.h"
+#include "timebase.h"
+#include "timer_wheel.h"
+#include "key_queue.h"
+#include "latency_hist.h"
+#include "atomic_bits.h"
+#include <string.h>
+
+// --- Constants & Config ---
+static const uint32_t penalty_minutes[] = {1, 5, 25, 125};
+static const uint8_t MAX_PENALTY_LEVEL = 4;
+
+#define TIMEOUT_3S_CYCLES   3000  				// 300
+#define TIMEOUT_10S_CYCLES  10000 				// 1000
+#define TIMEOUT_30S_CYCLES  30000				// 3000
+#define ALARM_REPEAT_MS     (5 * 60 * 1000)     // 5 minutes
+#define ALARM_BEEP_ON_MS    500
+#define ALARM_BEEP_OFF_MS   500
+#define ALARM_BEEPS         (TIMEOUT_10S_CYCLES / (ALARM_BEEP_ON_MS + ALARM_BEEP_OFF_MS))
+#define STATE_MAX_CHAIN     8                   // Steps per event (bound only, no row chain is that long)
+#define STATE_WAKE_TIMER    0x01                // stateWake: an FSM timer expired
+
+// --- Internal Variables ---
+static uint16_t inputLen = 0;
+static bool isShowingError = false; // Flag to hold VERIFY state for 3s error display
+static uint32_t buzzerTaskID = NO_TASK_ID; // Runs the alarm pattern while it plays
+static pt_t buzzerPt;
+static uint8_t buzzerBeeps;
+static int penaltyTimer = TW_NONE;     // Long deadlines on the timing wheel
+static int alarmRepeatTimer = TW_NONE;
+static uint32_t causeMs;       // Input behind the latest transitions (latency_hist.h)
+static bool causeValid;
+static atomic_bits_t stateWake;  // STATE_WAKE_*, set from the TIM2 interrupt
+static KeyQueueEvent_t deferredKeys[KEY_QUEUE_SIZE]; // Keys held back by state_defers_keys
+static uint8_t deferredHead;
+static uint8_t deferredCount;
+
+// --- Helper Functions ---
+
+/* Clear input buffer */
+static void input_clear(void) {
+    inputLen = 0;
+    inputBuffer[0] = '\0';
+}
+
+/* Append char to buffer (limit 20 chars) */
+static void input_append(char c) {
+    if (inputLen < MAX_INPUT_LENGTH) {
+        inputBuffer[inputLen++] = c;
+        inputBuffer[inputLen] = '\0';
+    }
+}
+
+/* Remove last char */
+static void input_backspace(void) {
+    if (inputLen > 0) {
+        inputLen--;
+        inputBuffer[inputLen] = '\0';
+    }
+}
+
+/* Verify password using KMP */
+static bool verify_password(void) {
+    return KMP_FindPassword((const uint8_t*)inputBuffer, (uint16_t)inputLen);
+}
+
+/* Calculate penalty end time based on level */
+static void activate_penalty(uint8_t level) {
+    uint32_t minutes = 0;
+    if (level > 0 && level <= MAX_PENALTY_LEVEL) {
+        minutes = penalty_minutes[level - 1];
+    } else {
+        minutes = penalty_minutes[MAX_PENALTY_LEVEL - 1];
+    }
+    gSystemTimers.penaltyEndMs = Timebase_Now_Ms() + (minutes * 60 * 1000);
+    TW_Start(penaltyTimer, minutes * 60 * 1000);
+}
+
+/* Alarm pattern: 10s of 0.5s beeps */
+static char buzzer_pattern(pt_t *pt) {
+    PT_BEGIN(pt);
+    for (buzzerBeeps = 0; buzzerBeeps < ALARM_BEEPS; buzzerBeeps++) {
+        gOutputStatus.buzzer = BUZZER_ON;
+        PT_SLEEP_MS(pt, ALARM_BEEP_ON_MS);
+        gOutputStatus.buzzer = BUZZER_OFF;
+        PT_SLEEP_MS(pt, ALARM_BEEP_OFF_MS);
+    }
+    PT_END(pt);
+}
+
+/* Scheduler task (every tick) driving the pattern, removes itself at the end */
+static void buzzer_task(void) {
+    if (!PT_SCHEDULE(buzzer_pattern(&buzzerPt))) {
+        SCH_Delete_Task(buzzerTaskID);
+        buzzerTaskID = NO_TASK_ID;
+    }
+}
+
+/* Start the 10s alarm, from the beginning if it is already playing */
+static void buzzer_start(void) {
+    PT_INIT(&buzzerPt);
+    if (buzzerTaskID == NO_TASK_ID) {
+        buzzerTaskID = SCH_Add_Task(buzzer_task, 0, 1);
+    }
+}
+
+/* Silence the buzzer and drop the alarm pattern if one is playing */
+static void buzzer_off(void) {
+    gOutputStatus.buzzer = BUZZER_OFF;
+    if (buzzerTaskID != NO_TASK_ID) {
+        SCH_Delete_Task(buzzerTaskID);
+        buzzerTaskID = NO_TASK_ID;
+    }
+}
+
+/* States that cannot take a key yet but will soon (mask after wakeup,
+ * battery notice, password check / error display): keys typed meanwhile
+ * stay queued and are entered once LOCKED_ENTRY is reached.
+ */
+static bool state_defers_keys(void) {
+    switch (gSystemState.currentState) {
+        case LOCKED_WAKEUP:
+        case BATTERY_WARNING:
+        case LOCKED_VERIFY:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Present one queued event (or none) to the FSM through gKeyEvent and the
+ * button fields of gInputState. Door and battery events only wake the FSM:
+ * the rows read the levels, already updated by Input_Process.
+ */
+static void key_event_load(const KeyQueueEvent_t *ev) {
+    gKeyEvent.keyChar = 0;
+    gKeyEvent.isEnter = 0;
+    gKeyEvent.isEnterLong = 0;
+    gKeyEvent.isBackspace = 0;
+    gInputState.keySensor = 0;
+    gInputState.indoorButton = 0;
+    gInputState.indoorButtonLong = 0;
+    if (ev == NULL) return;
+
+    switch (ev->type) {
+        case KEY_EV_CHAR:        gKeyEvent.keyChar = ev->key; break;
+        case KEY_EV_ENTER:       gKeyEvent.isEnter = 1; break;
+        case KEY_EV_ENTER_LONG:  gKeyEvent.isEnterLong = 1; break;
+        case KEY_EV_BACKSPACE:   gKeyEvent.isBackspace = 1; break;
+        case KEY_EV_INDOOR:      gInputState.indoorButton = 1; break;
+        case KEY_EV_INDOOR_LONG: gInputState.indoorButtonLong = 1; break;
+        case KEY_EV_KEY_SENSOR:  gInputState.keySensor = 1; break;
+        default: break;
+    }
+}
+
+static bool event_is_key(const KeyQueueEvent_t *ev) {
+    return ev->type == KEY_EV_CHAR || ev->type == KEY_EV_ENTER ||
+           ev->type == KEY_EV_ENTER_LONG || ev->type == KEY_EV_BACKSPACE;
+}
+
+/* Next event for the FSM: keys held back come first once the state takes
+ * keys again. Keys arriving in a busy state are set aside (dropped when
+ * the buffer is full, like a full queue), other events go through.
+ */
+static bool event_next(KeyQueueEvent_t *ev) {
+    if (deferredCount > 0 && !state_defers_keys()) {
+        *ev = deferredKeys[deferredHead];
+        deferredHead = (uint8_t)((deferredHead + 1) % KEY_QUEUE_SIZE);
+        deferredCount--;
+        return true;
+    }
+    while (KeyQueue_Pop(ev)) {
+        if (!event_is_key(ev) || !state_defers_keys()) return true;
+        if (deferredCount < KEY_QUEUE_SIZE) {
+            deferredKeys[(deferredHead + deferredCount) % KEY_QUEUE_SIZE] = *ev;
+            deferredCount++;
+        }
+    }
+    return false;
+}
+
+static void state_step(void);
+
+/* One FSM step, 'inputMs' = sampling time of the input presented (NULL if
+ * none). A transition made on an input remembers its time; the solenoid
+ * change it leads to, maybe a few steps later, hands it to Output_Process.
+ */
+static void state_step_traced(const uint32_t *inputMs) {
+    uint8_t prevState = gSystemState.currentState;
+    Solenoid_t prevSolenoid = gOutputStatus.solenoid;
+    bool prevDefers = state_defers_keys();
+
+    state_step();
+
+    if (gSystemState.currentState != prevState)
+    {
+        if (inputMs != NULL)
+        {
+            causeMs = *inputMs;
+            causeValid = true;
+        }
+        else if (!prevDefers)
+        {
+            causeValid = false; // Timeout: no input behind it
+        }
+    }
+    if (gOutputStatus.solenoid != prevSolenoid)
+    {
+        gOutputStatus.solenoidCauseMs = causeMs;
+        gOutputStatus.solenoidCause = causeValid;
+        causeValid = false;
+    }
+}
+
+/* Run to completion: the first step takes the event, the next ones (no
+ * event) run the entry actions and level checks of each state reached.
+ */
+static void state_run(const uint32_t *inputMs) {
+    for (uint8_t n = 0; n < STATE_MAX_CHAIN; n++) {
+        uint8_t prevState = gSystemState.currentState;
+        state_step_traced(inputMs);
+        if (gSystemState.currentState == prevState) break;
+        key_event_load(NULL); // Unused events are dropped
+    }
+}
+
+// --- Main API ---
+
+void State_Init(void) {
+    gSystemState.currentState = LOCKED_SLEEP;
+    gSystemTimers.failedAttempts = 0;
+    gSystemTimers.penaltyLevel = 0;
+    if (penaltyTimer == TW_NONE) penaltyTimer = TW_Create(State_Event_Timer, 0);
+    if (alarmRepeatTimer == TW_NONE) alarmRepeatTimer = TW_Create(State_Event_Timer, 0);
+    input_clear();
+    causeValid = false;
+    deferredHead = 0;
+    deferredCount = 0;
+    Atomic_Set_Bits(&stateWake, STATE_WAKE_TIMER); // First run: LOCKED_SLEEP entry
+}
+
+void State_Process(void) {
+    KeyQueueEvent_t ev;
+    bool timeout = Atomic_Consume_Bits(&stateWake, STATE_WAKE_TIMER) != 0;
+
+    // Nothing posted and no timer expired: the FSM stays idle
+    if (!timeout && KeyQueue_Count() == 0) return;
+
+    if (timeout)
+    {
+        key_event_load(NULL);
+        state_run(NULL);
+    }
+
+    /* One run per event, so a burst typed within a tick is entered
+     * completely and in order. Keys a state does not use are dropped,
+     * except in the busy states (state_defers_keys).
+     */
+    while (event_next(&ev))
+    {
+        Latency_Record(LATENCY_KEY_TO_FSM, HAL_GetTick() - ev.timeMs);
+        key_event_load(&ev);
+        state_run(&ev.timeMs);
+    }
+}
+
+// --- FSM (switch, as replaced by the transition table) ---
+
+static void state_step(void) {
+    // uint64_t now = Timebase_Now_Ms();
+
+    // --- GLOBAL OVERRIDES (Highest Priority) ---
+
+    /* Mechanical Key OR Indoor Button (Short Press)
+     * Acts as Master Unlock in locked states.
+     */
+    if (gInputState.keySensor == 1 || gInputState.indoorButton == 1)
+    {
+        // Override conditions: Not already open logic (to prevent state hopping)
+        if (gSystemState.currentState <= PERMANENT_LOCKOUT ||
+            gSystemState.currentState == LOCKED_RELOCK ||
+            gSystemState.currentState == ALARM_FORGOTCLOSE) // Emergency open even if alarming
+        {
+            gSystemState.currentState = UNLOCKED_WAITOPEN;
+            setTimer(gUnlockWindowTimer, TIMEOUT_10S_CYCLES);
+
+            // Reset Penalties
+            gSystemTimers.failedAttempts = 0;
+            gSystemTimers.penaltyEndMs = 0;
+            TW_Stop(penaltyTimer);
+
+            // Consume events
+            gInputState.keySensor = 0;
+            gInputState.indoorButton = 0;
+            return; // Exit immediately to next cycle
+        }
+    }
+
+    // --- STATE MACHINE LOGIC ---
+
+    switch (gSystemState.currentState) {
+        case LOCKED_SLEEP:
+            gOutputStatus.solenoid = SOLENOID_LOCKED;
+            gOutputStatus.ledRed = LED_OFF;
+            gOutputStatus.ledGreen = LED_OFF;
+            buzzer_off();
+            // Transitions:
+            // Any Key -> Wakeup
+            if (gKeyEvent.keyChar != 0)
+            {
+                gSystemState.currentState = LOCKED_WAKEUP;
+                gKeyEvent.keyChar = 0;
+                setTimer(gMaskTimer, 1000);
+            }
+            break;
+
+        case LOCKED_WAKEUP:
+        	// Ensuring entry safety
+        	input_clear();
+            gOutputStatus.solenoid = SOLENOID_LOCKED;
+            gOutputStatus.ledRed = LED_ON;
+            gOutputStatus.ledGreen = LED_OFF;
+            buzzer_off();
+            // Check Battery
+        	if (timerConsume(gMaskTimer)){
+				if (gInputState.batteryLow)
+				{
+					gSystemState.currentState = BATTERY_WARNING;
+					setTimer(gWarningTimer, TIMEOUT_3S_CYCLES);
+				} else {
+					gSystemState.currentState = LOCKED_ENTRY;
+					setTimer(gEntryTimeoutTimer, TIMEOUT_30S_CYCLES);
+				}
+        	}
+            break;
+
+        case BATTERY_WARNING:
+        	// Do:
+            gOutputStatus.solenoid = SOLENOID_LOCKED;
+            gOutputStatus.ledRed = LED_ON;
+            gOutputStatus.ledGreen = LED_OFF;
+            buzzer_off();
+            // Transitions: After 3s -> Locked Entry
+            if (timerConsume(gWarningTimer))
+            {
+                gSystemState.currentState = LOCKED_ENTRY;
+                setTimer(gEntryTimeoutTimer, TIMEOUT_30S_CYCLES);
+            }
+            break;
+
+        case LOCKED_ENTRY:
+        	// Do:
+            gOutputStatus.solenoid = SOLENOID_LOCKED;
+            gOutputStatus.ledRed = LED_ON;
+            gOutputStatus.ledGreen = LED_OFF;
+            buzzer_off();
+            // Transitions:
+            // 1. Timeout 30s -> Sleep
+            if (timerConsume(gEntryTimeoutTimer))
+            {
+                gSystemState.currentState = LOCKED_SLEEP;
+            }
+            // 2. Enter Pressed -> Verify
+            else if (gKeyEvent.isEnter)
+            {
+                gSystemState.currentState = LOCKED_VERIFY;
+                isShowingError = false; // Reset error flag
+                gKeyEvent.isEnter = 0;
+            }
+            // 3. Input Handling
+            else if (gKeyEvent.isBackspace)
+            {
+                input_backspace();
+                setTimer(gEntryTimeoutTimer, TIMEOUT_30S_CYCLES); // Reset timeout
+                gKeyEvent.isBackspace = 0;
+            }
+            else if (gKeyEvent.keyChar != 0)
+            {
+                input_append(gKeyEvent.keyChar);
+                setTimer(gEntryTimeoutTimer, TIMEOUT_30S_CYCLES); // Reset timeout
+                gKeyEvent.keyChar = 0;
+            }
+            break;
+
+        case LOCKED_VERIFY:
+        	// Do:
+            gOutputStatus.solenoid = SOLENOID_LOCKED;
+            gOutputStatus.ledRed = LED_ON;
+            gOutputStatus.ledGreen = LED_OFF;
+            buzzer_off();
+            // Logic: Check password
+            // If just entered state (isShowingError == false)
+            if (!isShowingError)
+            {
+                bool isCorrect = verify_password();
+
+                // Case A: Format Error (Len < 4 or > 20)
+                if (inputLen < PASSWORD_LENGTH || inputLen > MAX_INPUT_LENGTH)
+                {
+                    isShowingError = true;
+                    setTimer(gWarningTimer, TIMEOUT_3S_CYCLES); // Show error 3s
+                    // Output processing will check "isShowingError" to display text
+                }
+                // Case B: Correct Password
+                else if (isCorrect)
+                {
+                    gSystemState.currentState = UNLOCKED_WAITOPEN;
+                    setTimer(gUnlockWindowTimer, TIMEOUT_10S_CYCLES);
+                    gSystemTimers.failedAttempts = 0;
+                    input_clear();
+                }
+                // Case C: Wrong Password
+                else {
+                    gSystemTimers.failedAttempts++;
+                    isShowingError = true;
+                    setTimer(gWarningTimer, TIMEOUT_3S_CYCLES);
+//                    input_clear();
+
+                    // Check Modulo 3
+                    if ((gSystemTimers.failedAttempts % 3) == 0)
+                    {
+                        // Max attempts reached
+                        if (gSystemTimers.failedAttempts >= 15)
+                        {
+                            gSystemState.currentState = PERMANENT_LOCKOUT;
+                            // Start Buzzer 10s
+                            buzzer_start();
+                        } else { // Penalty Timer
+                            uint8_t level = gSystemTimers.failedAttempts / 3;
+                            activate_penalty(level);
+                            gSystemState.currentState = PENALTY_TIMER;
+                            buzzer_start();
+                        }
+                    } else { // Normal Wrong (Not divisible by 3)
+                        isShowingError = true;
+                        setTimer(gWarningTimer, TIMEOUT_3S_CYCLES); // Show error 3s
+                    }
+                }
+            }
+            // If showing error (Wait for 3s timer)
+            else {
+                if (timerConsume(gWarningTimer))
+                {
+                    gSystemState.currentState = LOCKED_ENTRY;
+                    input_clear();
+                    setTimer(gEntryTimeoutTimer, TIMEOUT_30S_CYCLES);
+                }
+            }
+            break;
+
+        case PENALTY_TIMER:
+        	// Do:
+            gOutputStatus.solenoid = SOLENOID_LOCKED;
+            gOutputStatus.ledRed = LED_ON;
+            gOutputStatus.ledGreen = LED_OFF;
+            // gOutputStatus.buzzer = BUZZER_OFF;
+            // Logic: Wait for penalty end (the 10s alarm pattern ends by itself)
+            // Check Penalty Time
+            if (TW_Consume(penaltyTimer))
+            {
+                gSystemState.currentState = LOCKED_ENTRY;
+                input_clear();
+                setTimer(gEntryTimeoutTimer, TIMEOUT_30S_CYCLES);
+            }
+            break;
+
+        case PERMANENT_LOCKOUT:
+        	// Do:
+            gOutputStatus.solenoid = SOLENOID_LOCKED;
+            gOutputStatus.ledRed = LED_ON;
+            gOutputStatus.ledGreen = LED_OFF;
+            // gOutputStatus.buzzer = BUZZER_OFF;
+            // Logic: Infinite loop until Master Key (Handled in Global Overrides)
+            // Buzzer timeout is handled by the alarm pattern
+            break;
+
+        case UNLOCKED_WAITOPEN:
+        	// Do:
+            gOutputStatus.solenoid = SOLENOID_UNLOCKED;
+            gOutputStatus.ledRed = LED_OFF;
+            gOutputStatus.ledGreen = LED_ON;
+            buzzer_off();
+            // Transitions:
+            // 1. Door Opens -> DoorOpen
+            if (gInputState.doorSensor == 0)
+            {
+                gSystemState.currentState = UNLOCKED_DOOROPEN;
+                setTimer(gUnlockWindowTimer, TIMEOUT_30S_CYCLES);
+            }
+            // 2. Timeout 10s (Door never opened) -> Relock
+            else if (timerConsume(gUnlockWindowTimer))
+            {
+                gSystemState.currentState = LOCKED_RELOCK;
+                setTimer(gWarningTimer, TIMEOUT_3S_CYCLES);
+            }
+            // 3. Enter Long Press -> Set Password
+            else if (gKeyEvent.isEnterLong)
+            {
+                gSystemState.currentState = UNLOCKED_SETPASSWORD;
+                input_clear();
+                setTimer(gEntryTimeoutTimer, TIMEOUT_30S_CYCLES);
+                gKeyEvent.isEnterLong = 0;
+            }
+            break;
+
+        case UNLOCKED_SETPASSWORD:
+        	// Do:
+            gOutputStatus.solenoid = SOLENOID_UNLOCKED;
+            gOutputStatus.ledRed = LED_OFF;
+            gOutputStatus.ledGreen = LED_ON;
+            buzzer_off();
+            // Logic: Input new password
+            // 1. Timeout 30s -> WaitOpen
+            if (timerConsume(gEntryTimeoutTimer))
+            {
+                gSystemState.currentState = UNLOCKED_WAITOPEN;
+                setTimer(gUnlockWindowTimer, TIMEOUT_10S_CYCLES);
+            }
+            // 2. Enter Pressed -> Save
+            else if (gKeyEvent.isEnter)
+            {
+                if (inputLen == PASSWORD_LENGTH)
+                {
+                    State_SetPassword(inputBuffer); // Update global password
+                    gSystemState.currentState = LOCKED_RELOCK;
+                    setTimer(gWarningTimer, TIMEOUT_3S_CYCLES);
+                } else {
+                    gSystemState.currentState = UNLOCKED_WAITOPEN;
+                    setTimer(gUnlockWindowTimer, TIMEOUT_10S_CYCLES);
+                }
+                gKeyEvent.isEnter = 0;
+            }
+            // 3. Input
+            else if (gKeyEvent.keyChar != 0)
+            {
+                // Only allow input up to 4 chars
+                if (inputLen < PASSWORD_LENGTH)
+                {
+                    input_append(gKeyEvent.keyChar);
+                }
+                setTimer(gEntryTimeoutTimer, TIMEOUT_30S_CYCLES);
+                gKeyEvent.keyChar = 0;
+            }
+            else if (gKeyEvent.isBackspace)
+            {
+                input_backspace();
+                setTimer(gEntryTimeoutTimer, TIMEOUT_30S_CYCLES);
+                gKeyEvent.isBackspace = 0;
+            }
+            break;
+
+        case UNLOCKED_DOOROPEN:
+        	// Do:
+            gOutputStatus.solenoid = SOLENOID_UNLOCKED;
+            gOutputStatus.ledRed = LED_OFF;
+            gOutputStatus.ledGreen = LED_ON;
+            // gOutputStatus.buzzer = BUZZER_OFF;
+            // Transitions:
+            // 1. Door Closes -> WaitClose
+            if (gInputState.doorSensor == 1)
+            {
+                gSystemState.currentState = UNLOCKED_WAITCLOSE;
+                setTimer(gUnlockWindowTimer, TIMEOUT_10S_CYCLES);
+            }
+            // 2. Indoor Button Long Press -> Always Open
+            else if (gInputState.indoorButtonLong)
+            {
+                gSystemState.currentState = UNLOCKED_ALWAYSOPEN;
+                gInputState.indoorButtonLong = 0;
+            }
+            // 3. Timeout 30s -> Alarm
+            else if (timerConsume(gUnlockWindowTimer))
+            {
+                gSystemState.currentState = ALARM_FORGOTCLOSE;
+                TW_Start(alarmRepeatTimer, ALARM_REPEAT_MS);
+                // Start Buzzer 10s
+                buzzer_start();
+            }
+            break;
+
+        case ALARM_FORGOTCLOSE:
+        	// Do:
+            gOutputStatus.solenoid = SOLENOID_UNLOCKED;
+            gOutputStatus.ledRed = LED_OFF;
+            gOutputStatus.ledGreen = LED_ON;
+            // gOutputStatus.buzzer = BUZZER_OFF;
+            // Transitions:
+            // 1. Door Closes -> WaitClose
+            if (gInputState.doorSensor == 1)
+            {
+                gSystemState.currentState = UNLOCKED_WAITCLOSE;
+                setTimer(gUnlockWindowTimer, TIMEOUT_10S_CYCLES);
+                buzzer_off(); // Stop alarm
+            }
+            // 2. Repeat Alarm (5 min), each burst is a 10s alarm pattern
+            if (TW_Consume(alarmRepeatTimer))
+            {
+                TW_Start(alarmRepeatTimer, ALARM_REPEAT_MS);
+                buzzer_start();
+            }
+            // 3. Long press indoor unlock button -> UNLOCK_ALWAYSOPEN
+			if (gInputState.indoorButtonLong)
+			{
+				gSystemState.currentState = UNLOCKED_ALWAYSOPEN;
+				gInputState.indoorButtonLong = 0;
+			}
+            break;
+
+        case UNLOCKED_WAITCLOSE:
+        	// Do:
+            gOutputStatus.solenoid = SOLENOID_UNLOCKED;
+            gOutputStatus.ledRed = LED_OFF;
+            gOutputStatus.ledGreen = LED_ON;
+            buzzer_off();
+            // Transitions:
+            // 1. Door Opens again -> DoorOpen
+            if (gInputState.doorSensor == 0)
+            {
+                gSystemState.currentState = UNLOCKED_DOOROPEN;
+                setTimer(gUnlockWindowTimer, TIMEOUT_30S_CYCLES);
+            }
+            // 2. Timeout 10s -> Relock
+            else if (timerConsume(gUnlockWindowTimer))
+            {
+            	setTimer(gWarningTimer, TIMEOUT_3S_CYCLES);
+                gSystemState.currentState = LOCKED_RELOCK;
+            }
+            break;
+
+        case UNLOCKED_ALWAYSOPEN:
+        	// Do:
+            gOutputStatus.solenoid = SOLENOID_UNLOCKED;
+            gOutputStatus.ledRed = LED_OFF;
+            gOutputStatus.ledGreen = LED_ON;
+            // gOutputStatus.buzzer = BUZZER_OFF;
+            // Transitions:
+            // 1. Door Closes -> WaitClose (As per user logic)
+            if (gInputState.doorSensor == 1)
+            {
+                gSystemState.currentState = UNLOCKED_WAITCLOSE;
+                setTimer(gUnlockWindowTimer, TIMEOUT_10S_CYCLES);
+            }
+            break;
+
+        case LOCKED_RELOCK:
+        	// Do:
+            gOutputStatus.solenoid = SOLENOID_LOCKED;
+            gOutputStatus.ledRed = LED_ON;
+            gOutputStatus.ledGreen = LED_OFF;
+            buzzer_off();
+            // Logic: Wait 3s then Sleep
+            // Note: Reuse WARNING timer for 3s delay
+            if (timerConsume(gWarningTimer))
+            {
+                gSystemState.currentState = LOCKED_SLEEP;
+            }
+            break;
+
+        default:
+            gSystemState.currentState = LOCKED_SLEEP;
+            break;
+    }
+}
+
+// --- API Implementation ---
+
+/* Producer side of the event queue: Input_Process context only */
+static void state_post(uint8_t type, char key, uint32_t timeMs) {
+    KeyQueueEvent_t ev;
+    ev.type = type;
+    ev.key = key;
+    ev.timeMs = timeMs;
+    (void)KeyQueue_Push(&ev); // Full queue: dropped and counted
+}
+
+void State_Event_KeypadChar(char c, uint32_t timeMs) { state_post(KEY_EV_CHAR, c, timeMs); }
+void State_Event_Enter(uint32_t timeMs) { state_post(KEY_EV_ENTER, 0, timeMs); }
+void State_Event_Enter_Long(uint32_t timeMs) { state_post(KEY_EV_ENTER_LONG, 0, timeMs); }
+void State_Event_Backspace(uint32_t timeMs) { state_post(KEY_EV_BACKSPACE, 0, timeMs); }
+void State_Event_IndoorButton(uint32_t timeMs) { state_post(KEY_EV_INDOOR, 0, timeMs); }
+void State_Event_IndoorButton_Long(uint32_t timeMs) { state_post(KEY_EV_INDOOR_LONG, 0, timeMs); }
+void State_Event_KeySensor(uint32_t timeMs) { state_post(KEY_EV_KEY_SENSOR, 0, timeMs); }
+void State_Event_DoorSensor_Open(uint32_t timeMs) { state_post(KEY_EV_DOOR_OPEN, 0, timeMs); }
+void State_Event_DoorSensor_Close(uint32_t timeMs) { state_post(KEY_EV_DOOR_CLOSE, 0, timeMs); }
+void State_Event_Battery(void) { state_post(KEY_EV_BATTERY, 0, HAL_GetTick()); }
+
+void State_Event_Timer(void) {
+    Atomic_Set_Bits(&stateWake, STATE_WAKE_TIMER);
+}
+
+bool State_SetPassword(const char *newPass) {
+    if (strlen(newPass) != PASSWORD_LENGTH) return false;
+    strcpy(gPassword, newPass);
+    return true;
+}
+
+const char* State_GetPassword(void) {
+    return gPassword;
+}
+
+uint8_t State_GetState(void) {
+    return gSystemState.currentState;
+}
+
+void State_ForceUnlock(void) {
+    gSystemState.currentState = UNLOCKED_WAITOPEN;
+    setTimer(gUnlockWindowTimer, TIMEOUT_10S_CYCLES);
+    Atomic_Set_Bits(&stateWake, STATE_WAKE_TIMER);
+}
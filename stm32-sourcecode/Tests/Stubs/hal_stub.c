@@ -0,0 +1,100 @@
+/*
+ * hal_stub.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: Host peripherals for the tests: registers in RAM, GPIO
+ * reads and writes on them.
+ */
+#include "main.h"
+
+GPIO_TypeDef hostGPIO[3];
+DMA_Channel_TypeDef hostDMA1_Channel1, hostDMA1_Channel4, hostDMA1_Channel7;
+TIM_TypeDef hostTIM2, hostTIM3, hostTIM4;
+ADC_TypeDef hostADC1;
+RCC_TypeDef hostRCC;
+AFIO_TypeDef hostAFIO;
+EXTI_TypeDef hostEXTI;
+uint32_t SystemCoreClock = 8000000;
+uint32_t hostPrimask;
+void (*hostGpioSettle)(GPIO_TypeDef *GPIOx);
+uint32_t hostGpioCalls;
+static uint32_t idrSeen[3];		// IDR at the previous settle, per port
+
+/* A BSRR write has no effect until the port settles: applied here, before
+ * the next HAL access or from the KEYPAD_SETTLE hook. Set bits win over
+ * reset bits, as on the target.
+ */
+static void gpio_apply_bsrr(GPIO_TypeDef *GPIOx)
+{
+	uint32_t bsrr = GPIOx->BSRR;
+
+	GPIOx->ODR = (GPIOx->ODR & ~(bsrr >> 16)) | (bsrr & 0xFFFFu);
+	GPIOx->BSRR = 0;
+}
+
+/* Falling edges since the previous settle on the armed lines of this port,
+ * each handled as HAL_GPIO_EXTI_IRQHandler does
+ */
+static void gpio_exti(GPIO_TypeDef *GPIOx)
+{
+	uint32_t port = (uint32_t)(GPIOx - hostGPIO);
+	uint32_t falling = idrSeen[port] & ~GPIOx->IDR & EXTI->FTSR & 0xFFFFu;
+
+	idrSeen[port] = GPIOx->IDR;
+	for (uint32_t line = 0; falling != 0; line++, falling >>= 1)
+	{
+		if (!(falling & 1u) || ((AFIO->EXTICR[line >> 2] >> ((line & 3u) * 4u)) & 0xFu) != port)
+			continue;
+		EXTI->PR |= 1u << line;
+		if (!(EXTI->IMR & (1u << line))) continue;
+		EXTI->PR = 1u << line;
+		HAL_GPIO_EXTI_Callback((uint16_t)(1u << line));
+	}
+}
+
+static void gpio_inputs(GPIO_TypeDef *GPIOx)
+{
+	if (hostGpioSettle) hostGpioSettle(GPIOx);
+	gpio_exti(GPIOx);
+}
+
+void hostGPIO_Settle(GPIO_TypeDef *GPIOx)
+{
+	gpio_apply_bsrr(GPIOx);
+	gpio_inputs(GPIOx);
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+	hostGpioCalls++;
+	gpio_apply_bsrr(GPIOx);
+	if (PinState == GPIO_PIN_SET)
+		GPIOx->ODR |= GPIO_Pin;
+	else
+		GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+	gpio_inputs(GPIOx);
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+	hostGpioCalls++;
+	if (GPIOx->BSRR) hostGPIO_Settle(GPIOx);
+	return (GPIOx->IDR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+}
+
+__attribute__((weak)) void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+}
+
+void Error_Handler(void)
+{
+}
@@ -0,0 +1,4 @@
+/* Core sources include "keypad.h", the header is KEYPAD.h (case-insensitive
+ * target file system). Forward to it on case-sensitive hosts.
+ */
+#include "../../Core/Inc/KEYPAD.h"
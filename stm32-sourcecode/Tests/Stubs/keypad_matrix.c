@@ -0,0 +1,62 @@
+/*
+ * keypad_matrix.c (host stub)
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: 4x4 key matrix without diodes on the simulated GPIOA.
+ */
+#include "keypad_matrix.h"
+#include "main.h"
+
+#define MATRIX_ROWS		4
+#define MATRIX_COLS		4
+#define MATRIX_ROW_MASK	0x000Fu		// PA0..PA3
+#define MATRIX_COL_SHIFT	4		// PA4..PA7
+
+static uint16_t pressed;
+
+static void matrix_settle(GPIO_TypeDef *port)
+{
+	if (port != GPIOA) return;
+
+	uint32_t lowCols = ~(port->ODR >> MATRIX_COL_SHIFT) & 0xFu;
+	uint32_t lowRows = 0;
+	uint32_t before;
+
+	// Spread the low level through pressed keys until nothing changes
+	do {
+		before = lowRows | (lowCols << MATRIX_ROWS);
+		for (int row = 0; row < MATRIX_ROWS; row++)
+		{
+			for (int col = 0; col < MATRIX_COLS; col++)
+			{
+				if (!(pressed & (1u << (row * MATRIX_COLS + col)))) continue;
+				if (lowCols & (1u << col)) lowRows |= 1u << row;
+				if (lowRows & (1u << row)) lowCols |= 1u << col;
+			}
+		}
+	} while (before != (lowRows | (lowCols << MATRIX_ROWS)));
+
+	port->IDR = (port->IDR & ~MATRIX_ROW_MASK) | (~lowRows & MATRIX_ROW_MASK);
+}
+
+void HostKeypad_Attach(void)
+{
+	GPIOA->ODR = 0;
+	GPIOA->BSRR = 0;
+	GPIOA->IDR = MATRIX_ROW_MASK;	// Pull-ups
+	pressed = 0;
+	hostGpioSettle = matrix_settle;
+	matrix_settle(GPIOA);
+}
+
+void HostKeypad_Press(uint16_t keys)
+{
+	pressed = keys;
+	hostGPIO_Settle(GPIOA);		// Row edges reach EXTI
+}
+
+uint16_t HostKeypad_Pressed(void)
+{
+	return pressed;
+}
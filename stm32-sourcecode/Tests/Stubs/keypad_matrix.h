@@ -0,0 +1,34 @@
+/*
+ * keypad_matrix.h (host stub)
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ */
+
+#ifndef TESTS_STUBS_KEYPAD_MATRIX_H_
+#define TESTS_STUBS_KEYPAD_MATRIX_H_
+
+/**
+ * @file keypad_matrix.h
+ * @brief The board's 4x4 keypad wired to the simulated GPIOA.
+ *
+ * Notes:
+ * - Rows on PA0..PA3 (inputs, pull-up), columns on PA4..PA7 (outputs), as
+ *   in main.h. The row bits of GPIOA->IDR follow the column bits of ODR and
+ *   the keys held down whenever the port settles (hostGPIO_Settle, every
+ *   HAL_GPIO_WritePin).
+ * - No diodes: a low column pulls down every row and column it reaches
+ *   through pressed keys, so three keys on the corners of a rectangle make
+ *   the fourth read as pressed. Columns driven high lose that fight, which
+ *   is the worst case for ghosting.
+ * - Build KEYPAD.c with -D'KEYPAD_SETTLE(port)=hostGPIO_Settle(port)' so
+ *   the fast scan sees its BSRR writes.
+ */
+
+#include <stdint.h>
+
+void HostKeypad_Attach(void);			// Resets GPIOA and installs the matrix
+void HostKeypad_Press(uint16_t keys);	// KEYPAD_KEY_BIT bits held down from now on
+uint16_t HostKeypad_Pressed(void);
+
+#endif /* TESTS_STUBS_KEYPAD_MATRIX_H_ */
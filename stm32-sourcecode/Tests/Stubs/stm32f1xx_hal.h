@@ -0,0 +1,152 @@
+/*
+ * stm32f1xx_hal.h (host stub)
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ */
+
+#ifndef TESTS_STUBS_STM32F1XX_HAL_H_
+#define TESTS_STUBS_STM32F1XX_HAL_H_
+
+/**
+ * @file stm32f1xx_hal.h
+ * @brief Host stand-in for the parts of the HAL / CMSIS the Core modules use.
+ *
+ * Notes:
+ * - Peripherals are plain structs in RAM (hal_stub.c), the tests write the
+ *   registers a module reads (GPIOx->IDR, TIM2->CNT, DMA CNDTR, ...).
+ * - Interrupt masking is a flag: the host has no interrupts, only threads
+ *   in the stress tests, which use the lock-free paths, and the EXTI edges
+ *   run inline from the GPIO settle (below).
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum { HAL_OK = 0, HAL_ERROR, HAL_BUSY, HAL_TIMEOUT } HAL_StatusTypeDef;
+typedef enum { GPIO_PIN_RESET = 0, GPIO_PIN_SET } GPIO_PinState;
+
+typedef struct { volatile uint32_t CRL, CRH, IDR, ODR, BSRR, BRR, LCKR; } GPIO_TypeDef;
+typedef struct { volatile uint32_t CCR, CNDTR, CPAR, CMAR; } DMA_Channel_TypeDef;
+typedef struct {
+	volatile uint32_t CR1, CR2, SMCR, DIER, SR, EGR, CCMR1, CCMR2, CCER, CNT, PSC, ARR;
+	volatile uint32_t RCR, CCR1, CCR2, CCR3, CCR4;
+} TIM_TypeDef;
+typedef struct {
+	volatile uint32_t SR, CR1, CR2, SMPR1, SMPR2, JOFR1, JOFR2, JOFR3, JOFR4, HTR, LTR;
+	volatile uint32_t SQR1, SQR2, SQR3, JSQR, JDR1, JDR2, JDR3, JDR4, DR;
+} ADC_TypeDef;
+typedef struct { volatile uint32_t CR, CFGR, CIR, APB2RSTR, APB1RSTR, AHBENR, APB2ENR, APB1ENR; } RCC_TypeDef;
+typedef struct { volatile uint32_t EVCR, MAPR, EXTICR[4], RESERVED0, MAPR2; } AFIO_TypeDef;
+typedef struct { volatile uint32_t IMR, EMR, RTSR, FTSR, SWIER, PR; } EXTI_TypeDef;
+typedef struct { TIM_TypeDef *Instance; } TIM_HandleTypeDef;
+typedef struct { int unused; } I2C_HandleTypeDef;
+
+extern GPIO_TypeDef hostGPIO[3];		// A, B, C: contiguous like the APB2 ports
+extern DMA_Channel_TypeDef hostDMA1_Channel1, hostDMA1_Channel4, hostDMA1_Channel7;
+extern TIM_TypeDef hostTIM2, hostTIM3, hostTIM4;
+extern ADC_TypeDef hostADC1;
+extern RCC_TypeDef hostRCC;
+extern AFIO_TypeDef hostAFIO;
+extern EXTI_TypeDef hostEXTI;
+extern uint32_t SystemCoreClock;
+
+#define GPIOA			(&hostGPIO[0])
+#define GPIOB			(&hostGPIO[1])
+#define GPIOC			(&hostGPIO[2])
+#define GPIOA_BASE		((uintptr_t)GPIOA)
+#define GPIOB_BASE		((uintptr_t)GPIOB)
+#define DMA1_Channel1	(&hostDMA1_Channel1)
+#define DMA1_Channel4	(&hostDMA1_Channel4)
+#define DMA1_Channel7	(&hostDMA1_Channel7)
+#define TIM2			(&hostTIM2)
+#define TIM3			(&hostTIM3)
+#define TIM4			(&hostTIM4)
+#define ADC1			(&hostADC1)
+#define RCC				(&hostRCC)
+#define AFIO			(&hostAFIO)
+#define EXTI			(&hostEXTI)
+
+#define GPIO_PIN_0		((uint16_t)0x0001)
+#define GPIO_PIN_1		((uint16_t)0x0002)
+#define GPIO_PIN_2		((uint16_t)0x0004)
+#define GPIO_PIN_3		((uint16_t)0x0008)
+#define GPIO_PIN_4		((uint16_t)0x0010)
+#define GPIO_PIN_5		((uint16_t)0x0020)
+#define GPIO_PIN_6		((uint16_t)0x0040)
+#define GPIO_PIN_7		((uint16_t)0x0080)
+#define GPIO_PIN_12		((uint16_t)0x1000)
+#define GPIO_PIN_13		((uint16_t)0x2000)
+#define GPIO_PIN_14		((uint16_t)0x4000)
+#define GPIO_PIN_15		((uint16_t)0x8000)
+
+#define DMA_CCR_EN		0x0001u
+#define DMA_CCR_CIRC	0x0020u
+#define DMA_CCR_MINC	0x0080u
+#define DMA_CCR_PSIZE_0	0x0100u
+#define DMA_CCR_PSIZE_1	0x0200u
+#define DMA_CCR_MSIZE_0	0x0400u
+#define DMA_CCR_PL_0	0x1000u
+#define TIM_CR1_CEN		0x0001u
+#define TIM_SR_UIF		0x0001u
+#define TIM_EGR_UG		0x0001u
+#define TIM_DIER_UDE	0x0100u
+#define TIM_DIER_CC2DE	0x0400u
+#define TIM_CR2_MMS_1	0x0020u
+
+#define ADC_CR1_SCAN		0x00000100u
+#define ADC_CR2_ADON		0x00000001u
+#define ADC_CR2_CAL			0x00000004u
+#define ADC_CR2_RSTCAL		0x00000008u
+#define ADC_CR2_DMA			0x00000100u
+#define ADC_CR2_EXTSEL_2	0x00080000u
+#define ADC_CR2_EXTTRIG		0x00100000u
+#define ADC_CR2_TSVREFE		0x00800000u
+#define ADC_SQR1_L_Pos		20u
+#define ADC_SQR3_SQ2_Pos	5u
+#define RCC_CFGR_ADCPRE		0x0000C000u
+#define RCC_CFGR_ADCPRE_DIV2	0x00000000u
+
+#define POSITION_VAL(VAL)	((uint32_t)__builtin_ctz(VAL))
+#define MODIFY_REG(REG, CLEARMASK, SETMASK)	((REG) = (((REG) & ~(CLEARMASK)) | (SETMASK)))
+
+#define __HAL_RCC_DMA1_CLK_ENABLE()
+#define __HAL_RCC_TIM4_CLK_ENABLE()
+#define __HAL_RCC_TIM3_CLK_ENABLE()
+#define __HAL_RCC_ADC1_CLK_ENABLE()
+
+typedef enum { EXTI0_IRQn = 6, EXTI9_5_IRQn = 23, EXTI15_10_IRQn = 40 } IRQn_Type;
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+/* Weak no-op in hal_stub.c, tests that arm EXTI lines define their own */
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin);
+
+extern uint32_t hostPrimask;
+#define __get_PRIMASK()		(hostPrimask)
+#define __disable_irq()		(hostPrimask = 1)
+#define __enable_irq()		(hostPrimask = 0)
+
+uint32_t HAL_GetTick(void);			// timebase.c, tests move it with Timebase_Advance
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+/* Not in hal_stub.c: tests that link i2c_lcd.c define them, with the time
+ * the bus and the delay take on their simulated clock
+ */
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t DevAddress,
+										  uint8_t *pData, uint16_t Size, uint32_t Timeout);
+void HAL_Delay(uint32_t Delay);
+
+/* Inputs that follow the outputs (keypad_matrix.c): called after every
+ * HAL_GPIO_WritePin and from hostGPIO_Settle. NULL = IDR only changes when
+ * a test writes it.
+ * EXTI: every settle compares IDR with the previous settle of the port.
+ * A falling edge on a line routed to the port (AFIO->EXTICR), with FTSR and
+ * IMR set, runs the interrupt at once: PR cleared, HAL_GPIO_EXTI_Callback.
+ * Tests that write IDR directly call hostGPIO_Settle for the edge.
+ */
+extern void (*hostGpioSettle)(GPIO_TypeDef *GPIOx);
+/* Applies a pending BSRR write to ODR, then lets the inputs follow */
+void hostGPIO_Settle(GPIO_TypeDef *GPIOx);
+extern uint32_t hostGpioCalls;		// HAL_GPIO_WritePin / ReadPin calls so far
+
+#endif /* TESTS_STUBS_STM32F1XX_HAL_H_ */
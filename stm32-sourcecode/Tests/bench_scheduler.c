@@ -0,0 +1,125 @@
+/*
+ * bench_scheduler.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: Host benchmark of scheduler.c from 4 to SCH_MAX_TASKS
+ * periodic tasks, built once per backend (SCH_BACKEND). Prints the cost
+ * of one 10 ms tick (post + dispatch) and of one add + delete pair, and
+ * checks that every task ran as often as its period says.
+ */
+#include "scheduler.h"
+#include "test.h"
+#include <time.h>
+
+#define BENCH_TICKS		200000	// 33 min of 10 ms ticks per task count
+#define BENCH_CHURN		200000	// Add + delete pairs per task count
+
+#if SCH_BACKEND == SCH_BACKEND_DELTA_LIST
+#define BENCH_NAME		"delta list"
+#else
+#define BENCH_NAME		"timing wheel"
+#endif
+
+/* Task periods in ticks, a mix like the firmware table: scan, display,
+ * battery, slow housekeeping. Cycled over the tasks so every count gets
+ * the same mix.
+ */
+static const uint32_t benchPeriod[] = { 1, 2, 5, 10, 20, 50, 100, 3, 7, 25 };
+#define BENCH_PERIODS	(sizeof benchPeriod / sizeof benchPeriod[0])
+
+static uint32_t runs[SCH_MAX_TASKS];
+
+#define TASK(n)	static void task##n(void) { runs[n]++; }
+TASK(0)  TASK(1)  TASK(2)  TASK(3)  TASK(4)  TASK(5)  TASK(6)  TASK(7)
+TASK(8)  TASK(9)  TASK(10) TASK(11) TASK(12) TASK(13) TASK(14) TASK(15)
+TASK(16) TASK(17) TASK(18) TASK(19) TASK(20) TASK(21) TASK(22) TASK(23)
+TASK(24) TASK(25) TASK(26) TASK(27) TASK(28) TASK(29) TASK(30) TASK(31)
+TASK(32) TASK(33) TASK(34) TASK(35) TASK(36) TASK(37) TASK(38) TASK(39)
+
+static void (*const taskFn[SCH_MAX_TASKS])(void) = {
+	task0,  task1,  task2,  task3,  task4,  task5,  task6,  task7,
+	task8,  task9,  task10, task11, task12, task13, task14, task15,
+	task16, task17, task18, task19, task20, task21, task22, task23,
+	task24, task25, task26, task27, task28, task29, task30, task31,
+	task32, task33, task34, task35, task36, task37, task38, task39,
+};
+
+static void churn(void) { }
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* First run on tick DELAY + 1, then every PERIOD ticks (test_scheduler.c) */
+static uint32_t expected_runs(uint32_t delay, uint32_t period, uint32_t ticks)
+{
+	return (ticks > delay) ? (ticks - delay - 1) / period + 1 : 0;
+}
+
+/* N periodic tasks, spread over the phases of their period */
+static void add_tasks(int n)
+{
+	SCH_Init();
+	for (int i = 0; i < n; i++) {
+		uint32_t period = benchPeriod[i % BENCH_PERIODS];
+		runs[i] = 0;
+		CHECK(SCH_Add_Task(taskFn[i], i % period, period) != NO_TASK_ID);
+	}
+}
+
+/* One main loop pass per ISR tick, as in main.c */
+static double bench_ticks(int n)
+{
+	add_tasks(n);
+	double start = now_ns();
+	for (uint32_t t = 0; t < BENCH_TICKS; t++) {
+		SCH_Update();
+		while (SCH_Idle_Ticks() == 0)
+			SCH_Dispatch_Tasks();
+	}
+	double ns = now_ns() - start;
+
+	for (int i = 0; i < n; i++) {
+		uint32_t period = benchPeriod[i % BENCH_PERIODS];
+		CHECK_EQ(runs[i], expected_runs(i % period, period, BENCH_TICKS));
+	}
+	return ns / BENCH_TICKS;
+}
+
+/* One-shot add + delete with the N tasks in place: the delta list walks
+ * the list to insert, the wheel only hashes into a bucket. At a full
+ * table one task makes room for the one-shot.
+ */
+static double bench_churn(int n)
+{
+	if (n == SCH_MAX_TASKS) n--;
+	add_tasks(n);
+	double start = now_ns();
+	for (uint32_t i = 0; i < BENCH_CHURN; i++) {
+		uint32_t id = SCH_Add_Task(churn, 1 + i % 97, 0);
+		SCH_Delete_Task(id);
+	}
+	double ns = now_ns() - start;
+
+	CHECK_EQ(SCH_task_count, n);
+	return ns / BENCH_CHURN;
+}
+
+int main(void)
+{
+	static const int counts[] = { 4, 8, 16, 24, 32, SCH_MAX_TASKS };
+
+	printf("%s backend, %d ticks per count\n", BENCH_NAME, BENCH_TICKS);
+	printf("%6s %14s %18s\n", "tasks", "ns/tick", "ns/add+delete");
+	for (unsigned c = 0; c < sizeof counts / sizeof counts[0]; c++) {
+		int n = counts[c];
+		double tick = bench_ticks(n);
+		double pair = bench_churn(n);
+		printf("%6d %14.1f %18.1f\n", n, tick, pair);
+	}
+	return test_summary("scheduler bench (" BENCH_NAME ")");
+}
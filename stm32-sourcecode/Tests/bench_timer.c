@@ -0,0 +1,207 @@
+/*
+ * bench_timer.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: Host benchmark of the soft timers (timer.c, delta list)
+ * against the timing wheel (timer_wheel.c) from 6 to 64 active timers,
+ * with the per-tick counter scan timer.c replaced as a reference. Both
+ * pools are built with 64 entries (BENCH_TIMERS).
+ */
+#include "timer.h"
+#include "timer_wheel.h"
+#include "scheduler.h"
+#include "test.h"
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_TIMERS	64
+#define BENCH_TICKS		1000000	// Idle run, ~2.8 h of 10 ms ticks
+#define BENCH_STARTS	200000	// Restarts of a running timer
+#define BENCH_ROUNDS	2000	// Expiry bursts
+#define BENCH_BURST_MS	10000	// Burst deadlines: 10 ms to 10 s
+
+_Static_assert(MAX_SOFT_TIMERS >= BENCH_TIMERS && TW_MAX_TIMERS >= BENCH_TIMERS,
+			   "build with -DMAX_SOFT_TIMERS=64 -DTW_MAX_TIMERS=64");
+
+int TIMER_CYCLE = 10; // global.c
+
+void SCH_Signal(uint32_t SIGNALS)
+{
+}
+
+static int softIds[BENCH_TIMERS];
+static int wheelIds[BENCH_TIMERS];
+static uint32_t softFired, wheelFired;
+
+static void soft_fired(void) { softFired++; }
+static void wheel_fired(void) { wheelFired++; }
+
+/* Reference: timerRun before the delta list, one counter per slot */
+static int scanCounter[BENCH_TIMERS];
+static int scanFlag[BENCH_TIMERS];
+
+static void scan_run(int n)
+{
+	for (int i = 0; i < n; i++)
+	{
+		if (scanCounter[i] > 0)
+		{
+			scanCounter[i]--;
+			if (scanCounter[i] <= 0) scanFlag[i] = 1;
+		}
+	}
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint32_t random_ms(uint32_t lo, uint32_t hi)
+{
+	return lo + (uint32_t)rand() % (hi - lo + 1);
+}
+
+static void stop_all(void)
+{
+	for (int i = 0; i < BENCH_TIMERS; i++)
+	{
+		stopTimer(softIds[i]);
+		TW_Stop(wheelIds[i]);
+		scanCounter[i] = 0;
+		scanFlag[i] = 0;
+	}
+	CHECK_EQ(timerNextDue(), SCH_IDLE_FOREVER);
+	CHECK_EQ(TW_Next_Due(), SCH_IDLE_FOREVER);
+}
+
+/* N timers 6 - 12 h away, none expires: the cost of a plain tick */
+static void bench_idle(int n, double ns[3])
+{
+	stop_all();
+	for (int i = 0; i < n; i++)
+	{
+		uint32_t ms = random_ms(6 * 3600000, 12 * 3600000);
+		setTimer(softIds[i], (int)ms);
+		TW_Start(wheelIds[i], ms);
+		scanCounter[i] = (int)(ms / 10);
+	}
+
+	double start = now_ns();
+	for (int t = 0; t < BENCH_TICKS; t++) scan_run(n);
+	ns[0] = (now_ns() - start) / BENCH_TICKS;
+
+	start = now_ns();
+	for (int t = 0; t < BENCH_TICKS; t++) timerAdvance(1);
+	ns[1] = (now_ns() - start) / BENCH_TICKS;
+
+	start = now_ns();
+	for (int t = 0; t < BENCH_TICKS; t++) TW_Advance(1);
+	ns[2] = (now_ns() - start) / BENCH_TICKS;
+
+	for (int i = 0; i < n; i++)
+	{
+		CHECK(timerRunning(softIds[i]));
+		CHECK(TW_Running(wheelIds[i]));
+	}
+}
+
+/* Restart one of the N running timers at a random deadline */
+static void bench_start(int n, double ns[3])
+{
+	static uint32_t ms[BENCH_STARTS];
+
+	for (int k = 0; k < BENCH_STARTS; k++) ms[k] = random_ms(10, 60 * 60000);
+
+	double start = now_ns();
+	for (int k = 0; k < BENCH_STARTS; k++)
+	{
+		scanCounter[k % n] = (int)(ms[k] / 10);
+		scanFlag[k % n] = 0;
+	}
+	ns[0] = (now_ns() - start) / BENCH_STARTS;
+
+	start = now_ns();
+	for (int k = 0; k < BENCH_STARTS; k++) setTimer(softIds[k % n], (int)ms[k]);
+	ns[1] = (now_ns() - start) / BENCH_STARTS;
+
+	start = now_ns();
+	for (int k = 0; k < BENCH_STARTS; k++) TW_Start(wheelIds[k % n], ms[k]);
+	ns[2] = (now_ns() - start) / BENCH_STARTS;
+}
+
+/* N timers armed at random deadlines up to 10 s, ticked until all have
+ * expired: arming and expiries included, per tick
+ */
+static void bench_burst(int n, double ns[3])
+{
+	static uint32_t ms[BENCH_TIMERS];
+	const int ticks = BENCH_BURST_MS / 10;
+	double spent[3] = { 0, 0, 0 };
+
+	softFired = wheelFired = 0;
+	for (int r = 0; r < BENCH_ROUNDS; r++)
+	{
+		stop_all();
+		for (int i = 0; i < n; i++) ms[i] = random_ms(10, BENCH_BURST_MS) / 10 * 10;
+
+		double start = now_ns();
+		for (int i = 0; i < n; i++) scanCounter[i] = (int)(ms[i] / 10);
+		for (int t = 0; t < ticks; t++) scan_run(n);
+		spent[0] += now_ns() - start;
+
+		start = now_ns();
+		for (int i = 0; i < n; i++) setTimer(softIds[i], (int)ms[i]);
+		for (int t = 0; t < ticks; t++) timerAdvance(1);
+		spent[1] += now_ns() - start;
+
+		start = now_ns();
+		for (int i = 0; i < n; i++) TW_Start(wheelIds[i], ms[i]);
+		for (int t = 0; t < ticks; t++) TW_Advance(1);
+		spent[2] += now_ns() - start;
+
+		for (int i = 0; i < n; i++)
+		{
+			CHECK_EQ(scanFlag[i], 1);
+			CHECK(timerConsume(softIds[i]));
+			CHECK(TW_Consume(wheelIds[i]));
+		}
+	}
+	CHECK_EQ(softFired, (uint32_t)n * BENCH_ROUNDS);
+	CHECK_EQ(wheelFired, (uint32_t)n * BENCH_ROUNDS);
+	for (int k = 0; k < 3; k++) ns[k] = spent[k] / ((double)ticks * BENCH_ROUNDS);
+}
+
+int main(void)
+{
+	static const int counts[] = { 6, 8, 16, 32, 48, 64 };
+
+	srand(1);
+	for (int i = 0; i < BENCH_TIMERS; i++)
+	{
+		softIds[i] = timerCreate(soft_fired, 0);
+		wheelIds[i] = TW_Create(wheel_fired, 0);
+		CHECK(softIds[i] != TIMER_NONE);
+		CHECK(wheelIds[i] != TW_NONE);
+	}
+
+	printf("ns per idle tick / per restart / per tick of a 10 s expiry burst\n");
+	printf("%6s   %20s   %20s   %20s\n", "timers", "scan   list  wheel", "scan   list  wheel",
+		   "scan   list  wheel");
+	for (unsigned c = 0; c < sizeof counts / sizeof counts[0]; c++)
+	{
+		int n = counts[c];
+		double idle[3], restart[3], burst[3];
+
+		bench_idle(n, idle);
+		bench_start(n, restart);
+		bench_burst(n, burst);
+		printf("%6d   %6.1f %6.1f %6.1f   %6.1f %6.1f %6.1f   %6.1f %6.1f %6.1f\n", n,
+			   idle[0], idle[1], idle[2], restart[0], restart[1], restart[2],
+			   burst[0], burst[1], burst[2]);
+	}
+	return test_summary("timer bench");
+}
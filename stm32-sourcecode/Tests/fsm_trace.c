@@ -0,0 +1,216 @@
+/*
+ * fsm_trace.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: Random input driver for the FSM differential test. Built
+ * twice, against Core/Src/state_processing.c (table) and against
+ * Reference/state_processing_switch.c (switch); test_fsm_diff runs both
+ * with the same seed and compares their output.
+ *
+ * Usage: fsm_trace <seed> <ticks>
+ * Time moves as in Tickless_Idle, up to the next scheduler / timer deadline
+ * at most, so both builds must also agree on their deadlines. Prints one
+ * line whenever the observable FSM state changes: tick, state, outputs,
+ * input buffer, attempts, penalty end, password, latency cause, queue depth
+ * and the FSM timer flags.
+ */
+#include "state_processing.h"
+#include "scheduler.h"
+#include "timebase.h"
+#include "timer_wheel.h"
+#include "key_queue.h"
+#include "latency_hist.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PENALTY_WHEEL_ID	0	// First TW_Create, in State_Init
+
+static uint32_t ticksRun;
+
+/* TIM2 interrupt for 'ticks' ticks (stretched period), then the main loop:
+ * due tasks (buzzer pattern), then the FSM slot of the pipeline
+ */
+static void advance(uint32_t ticks)
+{
+	Timebase_Advance(ticks * SCH_TICK_MS);
+	SCH_Update_Ticks(ticks);
+	timerAdvance((int)ticks);
+	TW_Advance(ticks);
+	while (SCH_Idle_Ticks() == 0) SCH_Dispatch_Tasks();
+	State_Process();
+	ticksRun += ticks;
+}
+
+/* Ticks the firmware would sleep for (Tickless_Idle), at most 'limit' */
+static uint32_t idle_ticks(uint32_t limit)
+{
+	uint32_t ticks = SCH_Idle_Ticks();
+	if (timerNextDue() < ticks) ticks = timerNextDue();
+	if (TW_Next_Due() < ticks) ticks = TW_Next_Due();
+	if (ticks > limit) ticks = limit;
+	return ticks ? ticks : 1;
+}
+
+/* The alarm-repeat wheel timer is left out: the table stops it on leaving
+ * ALARM_FORGOTCLOSE, the switch let it run (see test_fsm_diff.c)
+ */
+static void snapshot(char *line, size_t size)
+{
+	const int timers[] = { gWarningTimer, gEntryTimeoutTimer, gUnlockWindowTimer, gMaskTimer };
+	char flags[2 * 4 + 3];
+	int n = 0;
+
+	for (int i = 0; i < 4; i++)
+	{
+		flags[n++] = (char)('0' + timerRunning(timers[i]));
+		flags[n++] = (char)('0' + timerExpired(timers[i]));
+	}
+	flags[n++] = (char)('0' + TW_Running(PENALTY_WHEEL_ID));
+	flags[n++] = (char)('0' + TW_Expired(PENALTY_WHEEL_ID));
+	flags[n] = '\0';
+
+	snprintf(line, size, "s%u sol%d r%d g%d bz%d in'%s' fail%lu pen%llu pw%s cause%d/%lu q%u t%s",
+			 gSystemState.currentState, gOutputStatus.solenoid, gOutputStatus.ledRed,
+			 gOutputStatus.ledGreen, gOutputStatus.buzzer, inputBuffer,
+			 (unsigned long)gSystemTimers.failedAttempts,
+			 (unsigned long long)gSystemTimers.penaltyEndMs, gPassword,
+			 gOutputStatus.solenoidCause, (unsigned long)gOutputStatus.solenoidCauseMs,
+			 KeyQueue_Count(), flags);
+}
+
+static void type_keys(int count)
+{
+	static const char keys[] = "0123456789ABCDEF";
+	for (int k = 0; k < count; k++)
+		State_Event_KeypadChar(keys[rand() % 16], HAL_GetTick());
+}
+
+static void type_password(void)
+{
+	for (int k = 0; k < PASSWORD_LENGTH; k++) State_Event_KeypadChar(gPassword[k], HAL_GetTick());
+}
+
+static void door_set(uint8_t closed)
+{
+	gInputState.doorSensor = closed;
+	if (closed) State_Event_DoorSensor_Close(HAL_GetTick());
+	else State_Event_DoorSensor_Open(HAL_GetTick());
+}
+
+/* Any input at all, even where the state has no use for it */
+static void random_stimulus(void)
+{
+	int r = rand() % 1000;
+	uint32_t now = HAL_GetTick();
+
+	if (r < 250) type_keys(1 + rand() % 6);
+	else if (r < 290) type_password();
+	else if (r < 440) State_Event_Enter(now);
+	else if (r < 490) State_Event_Backspace(now);
+	else if (r < 520) State_Event_Enter_Long(now);
+	else if (r < 620) door_set(!gInputState.doorSensor);
+	else if (r < 625) State_Event_IndoorButton(now);
+	else if (r < 655) State_Event_IndoorButton_Long(now);
+	else if (r < 660) State_Event_KeySensor(now);
+	else if (r < 680)
+	{
+		gInputState.batteryLow = !gInputState.batteryLow;
+		State_Event_Battery();
+	}
+	else if (r < 682)
+	{
+		gSystemState.currentState = (rand() % 2) ? 0 : LOCKED_RELOCK + 1 + rand() % 10;
+		State_Event_Timer();
+	}
+}
+
+/* What a user (or, in attacker phases, someone guessing) would do next */
+static void guided_stimulus(int attacker)
+{
+	int r = rand() % 100;
+	uint32_t now = HAL_GetTick();
+
+	switch (State_GetState())
+	{
+		case LOCKED_ENTRY:
+			if (attacker || r < 40) type_keys(3 + rand() % 4);
+			else type_password();
+			if (r % 4 != 0) State_Event_Enter(now);
+			break;
+		case PERMANENT_LOCKOUT:
+			if (!attacker && r < 30) State_Event_KeySensor(now);
+			else type_keys(2);
+			break;
+		case UNLOCKED_WAITOPEN:
+			if (r < 40) State_Event_Enter_Long(now);
+			else if (r < 90 && gInputState.doorSensor) door_set(0);
+			break;
+		case UNLOCKED_SETPASSWORD:
+			type_keys(r < 70 ? PASSWORD_LENGTH : rand() % 6);
+			if (r % 3 != 0) State_Event_Enter(now);
+			break;
+		case UNLOCKED_DOOROPEN:
+		case ALARM_FORGOTCLOSE:
+		case UNLOCKED_ALWAYSOPEN:
+			if (r < 40 && !gInputState.doorSensor) door_set(1);
+			else if (r < 60) State_Event_IndoorButton_Long(now);
+			break;
+		case UNLOCKED_WAITCLOSE:
+			if (r < 30 && gInputState.doorSensor) door_set(0);
+			break;
+		default:
+			type_keys(1 + rand() % 3);
+			break;
+	}
+}
+
+/* Mostly bursts and pauses of seconds; sleeps long enough for the
+ * penalties to run out are drawn mainly in PENALTY_TIMER
+ */
+static uint32_t quiet_ticks(void)
+{
+	int r = rand() % 1000;
+	int penalty = (State_GetState() == PENALTY_TIMER);
+	if (r < (penalty ? 300 : 1)) return (uint32_t)(rand() % 800000);	// Up to ~133 min
+	if (r < 30) return (uint32_t)(rand() % 40000);		// Up to ~7 min
+	if (r < 200) return (uint32_t)(rand() % 1500);		// Up to 15 s
+	return (uint32_t)(rand() % 4);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned seed = (argc > 1) ? (unsigned)strtoul(argv[1], NULL, 0) : 1;
+	uint32_t limit = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : 1000000;
+	char line[256], last[256] = "";
+
+	srand(seed);
+	SCH_Init();
+	KeyQueue_Init();
+	Latency_Init();
+	init_global_variables();
+	State_Init();
+
+	int attacker = 0;
+	while (ticksRun < limit)
+	{
+		if (rand() % 200 == 0) attacker = !attacker;
+		if (rand() % 2) guided_stimulus(attacker);
+		else random_stimulus();
+		// The stimulus is taken on the next tick (Input_Process runs every tick)
+		for (uint32_t wait = 1 + quiet_ticks(), ticks = 1; wait > 0 && ticksRun < limit; )
+		{
+			advance(ticks);
+			wait -= ticks;
+			snapshot(line, sizeof(line));
+			if (strcmp(line, last) != 0)
+			{
+				printf("%lu %s\n", (unsigned long)ticksRun, line);
+				strcpy(last, line);
+			}
+			ticks = idle_ticks(wait < limit - ticksRun ? wait : limit - ticksRun);
+		}
+	}
+	return 0;
+}
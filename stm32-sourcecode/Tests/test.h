@@ -0,0 +1,58 @@
+/*
+ * test.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ */
+
+#ifndef TESTS_TEST_H_
+#define TESTS_TEST_H_
+
+/**
+ * @file test.h
+ * @brief Minimal checks for the host tests: count failures, keep going.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#define TEST_TIMEOUT_S	30	// A hang (corrupted list, lost wake) fails by SIGALRM
+
+static int testFailures;
+static int testChecks;
+
+#define CHECK(cond) do { \
+		testChecks++; \
+		if (!(cond)) { \
+			testFailures++; \
+			printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+		} \
+	} while (0)
+
+#define CHECK_EQ(a, b) do { \
+		long long va_ = (long long)(a), vb_ = (long long)(b); \
+		testChecks++; \
+		if (va_ != vb_) { \
+			testFailures++; \
+			printf("%s:%d: CHECK_EQ failed: %s = %lld, %s = %lld\n", \
+				   __FILE__, __LINE__, #a, va_, #b, vb_); \
+		} \
+	} while (0)
+
+#define RUN(test) do { \
+		int before_ = testFailures; \
+		printf("%-40s ", #test); \
+		fflush(stdout); \
+		alarm(TEST_TIMEOUT_S); \
+		test(); \
+		alarm(0); \
+		printf("%s\n", testFailures == before_ ? "ok" : "FAILED"); \
+	} while (0)
+
+static inline int test_summary(const char *name)
+{
+	printf("%s: %d checks, %d failed\n", name, testChecks, testFailures);
+	return testFailures != 0;
+}
+
+#endif /* TESTS_TEST_H_ */
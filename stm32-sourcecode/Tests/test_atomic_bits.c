@@ -0,0 +1,93 @@
+/*
+ * test_atomic_bits.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: Multi-threaded host stress test of atomic_bits.h, the
+ * expiry words of timer.c / timer_wheel.c and the scheduler signals.
+ */
+#include "atomic_bits.h"
+#include "test.h"
+#include <pthread.h>
+#include <sched.h>
+
+#define PRODUCERS		4
+#define BITS_EACH		8
+#define ROUNDS			100000
+
+static atomic_bits_t word;
+static uint32_t produced[PRODUCERS * BITS_EACH];
+static uint32_t consumed[PRODUCERS * BITS_EACH];
+static volatile int producersLeft;
+
+/* Each producer owns BITS_EACH bits and sets one again only after it was
+ * consumed, like a timer that cannot expire twice before the FSM reads it.
+ * A lost update (plain read-modify-write) would leave a producer waiting
+ * forever, a duplicate would make the counts differ.
+ */
+static void *producer(void *arg)
+{
+	int first = (int)(intptr_t)arg * BITS_EACH;
+
+	for (int round = 0; round < ROUNDS; round++)
+	{
+		int bit = first + round % BITS_EACH;
+		while (atomic_load(&word) & (1u << bit)) sched_yield();
+		produced[bit]++;
+		Atomic_Set_Bits(&word, 1u << bit);
+	}
+	__atomic_fetch_sub(&producersLeft, 1, __ATOMIC_SEQ_CST);
+	return NULL;
+}
+
+static void test_no_lost_or_duplicate_bits(void)
+{
+	pthread_t threads[PRODUCERS];
+
+	producersLeft = PRODUCERS;
+	for (int i = 0; i < PRODUCERS; i++)
+		pthread_create(&threads[i], NULL, producer, (void *)(intptr_t)i);
+
+	// Consumer: the FSM side, one bit at a time and whole words
+	uint32_t pick = 0;
+	for (;;)
+	{
+		int done = (producersLeft == 0);
+		uint32_t got = (pick++ & 1) ? Atomic_Consume_Bits(&word, 0xFFFFFFFF)
+									: Atomic_Consume_Bits(&word, 0x55555555);
+		if (got == 0) sched_yield();
+		while (got != 0)
+		{
+			consumed[__builtin_ctz(got)]++;
+			got &= got - 1;
+		}
+		if (done && atomic_load(&word) == 0) break;
+	}
+	for (int i = 0; i < PRODUCERS; i++) pthread_join(threads[i], NULL);
+
+	uint32_t total = 0;
+	for (int bit = 0; bit < PRODUCERS * BITS_EACH; bit++)
+	{
+		CHECK_EQ(consumed[bit], produced[bit]);
+		total += consumed[bit];
+	}
+	CHECK_EQ(total, PRODUCERS * ROUNDS);
+}
+
+static void test_consume_returns_only_requested(void)
+{
+	atomic_bits_t w = 0;
+
+	Atomic_Set_Bits(&w, 0x0F);
+	CHECK_EQ(Atomic_Consume_Bits(&w, 0x03), 0x03);
+	CHECK_EQ(Atomic_Consume_Bits(&w, 0x03), 0);
+	CHECK_EQ(Atomic_Consume_Bits(&w, 0xF0), 0);
+	CHECK_EQ(atomic_load(&w), 0x0C);
+}
+
+int main(void)
+{
+	RUN(test_consume_returns_only_requested);
+	RUN(test_no_lost_or_duplicate_bits);
+	return test_summary("atomic bits");
+}
@@ -0,0 +1,260 @@
+/*
+ * test_battery.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: Host tests of the battery_monitor.c filter: decimation of
+ * synthetic ADC buffers, discharge curves with noise, solenoid dips and
+ * the seed from one reading after a long standby.
+ */
+#include "battery_monitor.h"
+#include "global.h"
+#include "test.h"
+#include <stdlib.h>
+
+OutputStatus_t gOutputStatus;
+
+/* +-amplitude, uniform */
+static int noise(int amplitude)
+{
+	return amplitude ? rand() % (2 * amplitude + 1) - amplitude : 0;
+}
+
+/* VREFINT scans as DMA1 channel 1 stores them, board run from the
+ * battery (no BATTERY_DIVIDER_CHANNEL)
+ */
+static void fill_buffer(uint16_t *buffer, uint16_t vddaMv, int lsbNoise)
+{
+	for (int k = 0; k < BATTERY_OVERSAMPLE; k++)
+	{
+		int vref = (BATTERY_VREFINT_MV * 4095 + vddaMv / 2) / vddaMv + noise(lsbNoise);
+		buffer[k] = (uint16_t)vref;
+	}
+}
+
+static int abs_diff(int a, int b) { return a > b ? a - b : b - a; }
+
+// --- Decimation ---
+
+/* 64 scans of a VREFINT reading with a few LSB of noise give back VDDA
+ * to a few mV over the whole supply range
+ */
+static void test_decimate(void)
+{
+	uint16_t buffer[BATTERY_OVERSAMPLE];
+
+	srand(1);
+	for (uint16_t vdda = 2000; vdda <= 3600; vdda += 50)
+	{
+		fill_buffer(buffer, vdda, 3);
+		uint16_t mV = Battery_Decimate_mV(buffer, BATTERY_OVERSAMPLE);
+		CHECK(abs_diff(mV, vdda) <= 8);
+	}
+}
+
+/* The buffer before the first DMA transfer reads 0, not a flat battery */
+static void test_decimate_empty(void)
+{
+	uint16_t buffer[BATTERY_OVERSAMPLE] = { 0 };
+	BatteryFilter_t filter;
+
+	CHECK_EQ(Battery_Decimate_mV(buffer, BATTERY_OVERSAMPLE), 0);
+	Battery_Filter_Init(&filter);
+	for (int i = 0; i < 10; i++)
+		CHECK_EQ(Battery_Filter_Update(&filter, 0, 0), 0);
+	CHECK_EQ(filter.primed, 0);
+	CHECK_EQ(Battery_Filter_Seed(&filter, 0), 0);
+	CHECK_EQ(filter.primed, 0);
+}
+
+// --- Discharge curves ---
+
+/* Linear discharge with reading noise: batteryLow is set once, a few
+ * readings after the true level crosses BATTERY_LOW_MV, never early and
+ * never chattering.
+ */
+static void test_discharge(void)
+{
+	static const int slopes[] = { 1, 5, 20 };	// mV per reading
+
+	srand(2);
+	for (unsigned s = 0; s < sizeof slopes / sizeof slopes[0]; s++)
+	{
+		BatteryFilter_t filter;
+		int setAt = -1, changes = 0;
+		uint8_t low = 0;
+
+		Battery_Filter_Init(&filter);
+		for (int i = 0; 3000 - slopes[s] * i > 2200; i++)
+		{
+			int level = 3000 - slopes[s] * i;
+			uint8_t now = Battery_Filter_Update(&filter, (uint16_t)(level + noise(25)), 0);
+			if (now != low)
+			{
+				changes++;
+				setAt = level;
+			}
+			low = now;
+		}
+		CHECK_EQ(changes, 1);
+		CHECK(setAt < BATTERY_LOW_MV);
+		// Lag: ~3 readings of moving average + BATTERY_CONFIRM_READINGS
+		CHECK(setAt > BATTERY_LOW_MV - 8 * slopes[s] - 25);
+	}
+}
+
+/* A level sitting on the low threshold flips at most once: the noise
+ * never reaches back to BATTERY_OK_MV
+ */
+static void test_threshold_noise(void)
+{
+	BatteryFilter_t filter;
+	int changes = 0;
+	uint8_t low = 0;
+
+	srand(3);
+	Battery_Filter_Init(&filter);
+	for (int i = 0; i < 5000; i++)
+	{
+		uint8_t now = Battery_Filter_Update(&filter, (uint16_t)(BATTERY_LOW_MV + noise(40)), 0);
+		changes += (now != low);
+		low = now;
+	}
+	CHECK(changes <= 1);
+}
+
+/* Fresh battery after a low one: cleared after the average reaches
+ * BATTERY_OK_MV and BATTERY_CONFIRM_READINGS readings agree
+ */
+static void test_recovery(void)
+{
+	BatteryFilter_t filter;
+
+	Battery_Filter_Init(&filter);
+	for (int i = 0; i < 20; i++) Battery_Filter_Update(&filter, 2300, 0);
+	CHECK_EQ(filter.low, 1);
+
+	int readings = 0;
+	while (Battery_Filter_Update(&filter, 3100, 0) && readings < 50) readings++;
+	CHECK(readings >= BATTERY_CONFIRM_READINGS - 1);
+	CHECK(readings <= BATTERY_CONFIRM_READINGS + 3);
+	CHECK(filter.mV >= BATTERY_OK_MV);
+}
+
+// --- Solenoid load ---
+
+/* A healthy battery that sags under every unlock: the loaded reading and
+ * the one after it (buffer still holds the dip) are blanked, so neither
+ * the level nor batteryLow moves.
+ */
+static void test_solenoid_dips(void)
+{
+	BatteryFilter_t filter;
+
+	srand(4);
+	Battery_Filter_Init(&filter);
+	for (int i = 0; i < 2000; i++)
+	{
+		uint16_t before = filter.mV;
+		uint16_t mV;
+		uint8_t loaded = 0;
+
+		if (i % 7 == 3)
+		{
+			mV = 1900 + noise(100);		// Coil on for part of the reading
+			loaded = 1;
+		}
+		else if (i % 7 == 4)
+		{
+			mV = 2300 + noise(100);		// Buffer still partly filled with the dip
+		}
+		else
+		{
+			mV = 2650 + noise(20);
+		}
+		CHECK_EQ(Battery_Filter_Update(&filter, mV, loaded), 0);
+		if (i > 0 && (loaded || i % 7 == 4)) CHECK_EQ(filter.mV, before);
+	}
+	CHECK(abs_diff(filter.mV, 2650) <= 25);
+}
+
+/* The same dips on a battery that really is low still end in batteryLow */
+static void test_solenoid_dips_low(void)
+{
+	BatteryFilter_t filter;
+	int readings = 0;
+
+	Battery_Filter_Init(&filter);
+	for (int i = 0; i < 3; i++) Battery_Filter_Update(&filter, 2700, 0);
+	while (!filter.low && readings < 100)
+	{
+		Battery_Filter_Update(&filter, (readings % 3 == 0) ? 1800 : 2400, readings % 3 == 0);
+		readings++;
+	}
+	CHECK_EQ(filter.low, 1);
+	CHECK(readings < 20);
+}
+
+// --- Standby ---
+
+/* The filter is frozen for a whole standby. A battery that ran down during
+ * the sleep is reported by the seed from the first fresh buffer; one plain
+ * update is not enough (moving average and confirmation).
+ */
+static void test_wake_seed(void)
+{
+	uint16_t buffer[BATTERY_OVERSAMPLE];
+	BatteryFilter_t frozen, seeded;
+
+	srand(5);
+	Battery_Filter_Init(&frozen);
+	for (int i = 0; i < 20; i++) Battery_Filter_Update(&frozen, (uint16_t)(2700 + noise(10)), 0);
+	CHECK_EQ(frozen.low, 0);
+	seeded = frozen;
+
+	fill_buffer(buffer, 2400, 3);	// Ran down while asleep
+	uint16_t mV = Battery_Decimate_mV(buffer, BATTERY_OVERSAMPLE);
+	CHECK_EQ(Battery_Filter_Update(&frozen, mV, 0), 0);
+	CHECK_EQ(Battery_Filter_Seed(&seeded, mV), 1);
+	CHECK(abs_diff(seeded.mV, 2400) <= 8);
+
+	// Filtering goes on from the seed: no confirmation left to do
+	CHECK_EQ(Battery_Filter_Update(&seeded, mV, 0), 1);
+	CHECK_EQ(seeded.confirm, 0);
+}
+
+/* The seed keeps the hysteresis and clears a hold-off from before the sleep */
+static void test_wake_seed_hysteresis(void)
+{
+	BatteryFilter_t filter;
+
+	Battery_Filter_Init(&filter);
+	for (int i = 0; i < 20; i++) Battery_Filter_Update(&filter, 2300, 0);
+	CHECK_EQ(filter.low, 1);
+
+	CHECK_EQ(Battery_Filter_Seed(&filter, (BATTERY_LOW_MV + BATTERY_OK_MV) / 2), 1);
+	CHECK_EQ(Battery_Filter_Seed(&filter, BATTERY_OK_MV), 0);
+	CHECK_EQ(Battery_Filter_Seed(&filter, (BATTERY_LOW_MV + BATTERY_OK_MV) / 2), 0);
+	CHECK_EQ(Battery_Filter_Seed(&filter, BATTERY_LOW_MV - 1), 1);
+
+	Battery_Filter_Update(&filter, 1800, 1);
+	CHECK(filter.holdOff > 0);
+	Battery_Filter_Seed(&filter, 2700);
+	CHECK_EQ(filter.holdOff, 0);
+	CHECK_EQ(filter.low, 0);
+	CHECK_EQ(filter.mV, 2700);
+}
+
+int main(void)
+{
+	RUN(test_decimate);
+	RUN(test_decimate_empty);
+	RUN(test_discharge);
+	RUN(test_threshold_noise);
+	RUN(test_recovery);
+	RUN(test_solenoid_dips);
+	RUN(test_solenoid_dips_low);
+	RUN(test_wake_seed);
+	RUN(test_wake_seed_hysteresis);
+	return test_summary("battery");
+}
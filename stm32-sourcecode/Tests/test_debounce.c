@@ -0,0 +1,269 @@
+/*
+ * test_debounce.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: Host tests of the input debouncer (input_reading.c, built
+ * with INPUT_DMA_SAMPLING = 1): synthetic 1 ms GPIOB / GPIOC snapshot
+ * buffers fed through button_reading_batch, as the TIM4 / DMA path does.
+ */
+#include "input_reading.h"
+#include "keypad.h"
+#include "test.h"
+#include <stdlib.h>
+
+Keypad_HandleTypeDef hKeypad;	// KEYPAD.c
+SystemState_t gSystemState;		// global.c
+
+static uint16_t scanKeys;
+
+uint16_t Keypad_Scan(Keypad_HandleTypeDef *KEYPAD)
+{
+	return scanKeys;
+}
+
+typedef struct {
+	int portC;			// 1 = GPIOC, 0 = GPIOB
+	uint16_t pin;
+	uint32_t samples;	// debounceMs at 1 ms per sample
+} Input_t;
+
+static const Input_t inputs[N0_OF_BUTTONS] = {
+	[DOOR_SENSOR_INDEX]			= { 1, DOOR_SENSOR_Pin,	30 },
+	[KEY_SENSOR_INDEX]			= { 1, KEY_SENSOR_Pin,	20 },
+	[INDOOR_BUTTON_INDEX]		= { 1, BUTTON_Pin,		20 },
+	[ENTER_BUTTON_INDEX]		= { 0, ENTER_Pin,		20 },
+	[BACKSPACE_BUTTON_INDEX]	= { 0, BACKSPACE_Pin,	20 },
+};
+
+#define MAX_SAMPLES		256
+
+static uint16_t bufB[MAX_SAMPLES];
+static uint16_t bufC[MAX_SAMPLES];
+static uint32_t nowMs;
+
+/* Appends 'count' 1 ms snapshots with 'pressed' (bit per button) held */
+static void feed(uint32_t pressed, uint16_t count)
+{
+	for (uint16_t k = 0; k < count; k++)
+	{
+		bufB[k] = 0xFFFF;	// Released, active low
+		bufC[k] = 0xFFFF;
+		for (int i = 0; i < N0_OF_BUTTONS; i++)
+		{
+			if (!(pressed & (1u << i))) continue;
+			if (inputs[i].portC) bufC[k] &= (uint16_t)~inputs[i].pin;
+			else bufB[k] &= (uint16_t)~inputs[i].pin;
+		}
+	}
+	nowMs += count;
+	button_reading_batch(bufB, bufC, count, nowMs);
+}
+
+static void reset(void)
+{
+	input_reading_init();
+	scanKeys = 0;
+	nowMs = 1000;
+}
+
+// --- Thresholds and edge times ---
+
+static void test_thresholds(void)
+{
+	reset();
+	uint32_t down = nowMs + 1; // Time of the first pressed snapshot
+
+	feed((1u << DOOR_SENSOR_INDEX) | (1u << ENTER_BUTTON_INDEX), 19);
+	CHECK(!is_button_pressed(ENTER_BUTTON_INDEX));
+	feed((1u << DOOR_SENSOR_INDEX) | (1u << ENTER_BUTTON_INDEX), 1);
+	CHECK(is_button_pressed(ENTER_BUTTON_INDEX));	// 20 ms
+	CHECK(!is_button_pressed(DOOR_SENSOR_INDEX));
+	CHECK_EQ(button_edge_ms(ENTER_BUTTON_INDEX), down);
+
+	feed((1u << DOOR_SENSOR_INDEX) | (1u << ENTER_BUTTON_INDEX), 9);
+	CHECK(!is_button_pressed(DOOR_SENSOR_INDEX));
+	feed((1u << DOOR_SENSOR_INDEX) | (1u << ENTER_BUTTON_INDEX), 1);
+	CHECK(is_button_pressed(DOOR_SENSOR_INDEX));	// 30 ms, reed contact
+	CHECK_EQ(button_edge_ms(DOOR_SENSOR_INDEX), down);
+
+	// Release: the same count the other way
+	uint32_t up = nowMs + 1;
+	feed(0, 19);
+	CHECK(is_button_pressed(ENTER_BUTTON_INDEX));
+	feed(0, 1);
+	CHECK(!is_button_pressed(ENTER_BUTTON_INDEX));
+	CHECK_EQ(button_edge_ms(ENTER_BUTTON_INDEX), up);
+	feed(0, 10);
+	CHECK(!is_button_pressed(DOOR_SENSOR_INDEX));
+	CHECK_EQ(button_edge_ms(DOOR_SENSOR_INDEX), up);
+
+	// Out of range
+	CHECK_EQ(is_button_pressed(N0_OF_BUTTONS), 0);
+	CHECK_EQ(button_edge_ms(N0_OF_BUTTONS), 0);
+}
+
+/* Contact bounce: any snapshot back at the debounced level restarts the count */
+static void test_bounce_rejected(void)
+{
+	reset();
+	for (int burst = 0; burst < 20; burst++)
+	{
+		feed(1u << KEY_SENSOR_INDEX, 19);
+		feed(0, 1);
+	}
+	CHECK(!is_button_pressed(KEY_SENSOR_INDEX));
+
+	// Chatter for 15 ms, then a clean press: the edge is where the clean run starts
+	for (int k = 0; k < 15; k++) feed((k & 1) ? 1u << KEY_SENSOR_INDEX : 0, 1);
+	uint32_t down = nowMs + 1;
+	feed(1u << KEY_SENSOR_INDEX, 20);
+	CHECK(is_button_pressed(KEY_SENSOR_INDEX));
+	CHECK_EQ(button_edge_ms(KEY_SENSOR_INDEX), down);
+
+	// A 10 ms dropout while held is ignored
+	feed(0, 10);
+	feed(1u << KEY_SENSOR_INDEX, 5);
+	CHECK(is_button_pressed(KEY_SENSOR_INDEX));
+	CHECK_EQ(button_edge_ms(KEY_SENSOR_INDEX), down);
+}
+
+// --- Same result however the snapshots are split into batches ---
+
+typedef struct {
+	int state;
+	uint32_t count;
+	uint32_t runStart;
+	uint32_t edge;
+} ModelInput_t;
+
+static void test_model(void)
+{
+	ModelInput_t model[N0_OF_BUTTONS] = { 0 };
+	uint32_t level = 0;		// Settled contact level per button
+	uint32_t bouncing[N0_OF_BUTTONS] = { 0 };	// ms of chatter left
+	uint32_t changes = 0;
+	int mismatch = 0;
+
+	reset();
+	srand(5);
+	for (int batch = 0; batch < 40000 && !mismatch; batch++)
+	{
+		uint16_t count = 1 + (uint16_t)(rand() % 20);
+		uint32_t first = nowMs + 1;
+		for (uint16_t k = 0; k < count; k++)
+		{
+			uint32_t t = first + k;
+			bufB[k] = 0xFFFF;
+			bufC[k] = 0xFFFF;
+			for (int i = 0; i < N0_OF_BUTTONS; i++)
+			{
+				if (rand() % 200 == 0)
+				{
+					level ^= 1u << i;
+					bouncing[i] = (uint32_t)(rand() % 40);
+				}
+				int pressed = (level >> i) & 1;
+				if (bouncing[i] > 0)
+				{
+					bouncing[i]--;
+					if (rand() % 3 == 0) pressed = !pressed;
+				}
+				if (pressed)
+				{
+					if (inputs[i].portC) bufC[k] &= (uint16_t)~inputs[i].pin;
+					else bufB[k] &= (uint16_t)~inputs[i].pin;
+				}
+
+				// Reference: 'samples' consecutive snapshots away from the state
+				ModelInput_t *m = &model[i];
+				if (pressed == m->state)
+				{
+					m->count = 0;
+					continue;
+				}
+				if (m->count++ == 0) m->runStart = t;
+				if (m->count == inputs[i].samples)
+				{
+					m->state = pressed;
+					m->count = 0;
+					m->edge = m->runStart;
+					changes++;
+				}
+			}
+		}
+		nowMs += count;
+		button_reading_batch(bufB, bufC, count, nowMs);
+
+		for (int i = 0; i < N0_OF_BUTTONS; i++)
+		{
+			if ((int)is_button_pressed(i) != model[i].state ||
+				(model[i].edge && button_edge_ms(i) != model[i].edge))
+			{
+				printf("  batch %d button %d\n", batch, i);
+				mismatch = 1;
+			}
+		}
+	}
+	CHECK(!mismatch);
+	CHECK(changes > 1000);
+}
+
+// --- Long press and keypad, through button_reading once per tick ---
+
+static void test_long_press(void)
+{
+	reset();
+	gSystemState.currentState = LOCKED_ENTRY;
+	feed(1u << INDOOR_BUTTON_INDEX, 20);
+	CHECK(is_button_pressed(INDOOR_BUTTON_INDEX));
+
+	for (int t = 0; t < DURATION_FOR_AUTO_INCREASING - 1; t++) button_reading();
+	CHECK(!is_button_pressed_1s(INDOOR_BUTTON_INDEX));
+	button_reading();
+	CHECK(is_button_pressed_1s(INDOOR_BUTTON_INDEX));
+
+	feed(0, 20);
+	button_reading();
+	CHECK(!is_button_pressed(INDOOR_BUTTON_INDEX));
+	CHECK(!is_button_pressed_1s(INDOOR_BUTTON_INDEX));
+
+	// No long press on buttons that do not use one
+	feed(1u << BACKSPACE_BUTTON_INDEX, 20);
+	for (int t = 0; t < 2 * DURATION_FOR_AUTO_INCREASING; t++) button_reading();
+	CHECK(is_button_pressed(BACKSPACE_BUTTON_INDEX));
+	CHECK(!is_button_pressed_1s(BACKSPACE_BUTTON_INDEX));
+}
+
+/* Keypad keys: 20 ms = 2 scans at the full rate */
+static void test_keypad(void)
+{
+	reset();
+	gSystemState.currentState = LOCKED_ENTRY;
+
+	scanKeys = 1u << 5;
+	button_reading();
+	scanKeys = 0;
+	button_reading();
+	CHECK_EQ(keypad_keys_debounced(), 0);	// One scan: bounce
+
+	scanKeys = 1u << 5;
+	button_reading();
+	button_reading();
+	CHECK_EQ(keypad_keys_debounced(), 1u << 5);
+	scanKeys = 0;
+	button_reading();
+	CHECK_EQ(keypad_keys_debounced(), 1u << 5);
+	button_reading();
+	CHECK_EQ(keypad_keys_debounced(), 0);
+}
+
+int main(void)
+{
+	RUN(test_thresholds);
+	RUN(test_bounce_rejected);
+	RUN(test_model);
+	RUN(test_long_press);
+	RUN(test_keypad);
+	return test_summary("debounce");
+}
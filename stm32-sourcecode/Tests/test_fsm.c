@@ -0,0 +1,511 @@
+/*
+ * test_fsm.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: Host tests of the FSM table (state_processing.c) with the
+ * real timers, timing wheel, event queue and scheduler: events are posted
+ * with State_Event_*, time moves in 10 ms ticks as the TIM2 interrupt
+ * moves it.
+ */
+#include "state_processing.h"
+#include "scheduler.h"
+#include "timebase.h"
+#include "timer_wheel.h"
+#include "key_queue.h"
+#include "latency_hist.h"
+#include "test.h"
+#include <string.h>
+
+#define TICKS(ms)	((ms) / SCH_TICK_MS)
+#define HOUR_MS		3600000u
+
+static uint8_t polled;			// Step the FSM every tick, as before the event queue
+static uint32_t ticks, fsmSteps, activeTicks;
+
+/* STATE_STEP_HOOK (Makefile) */
+void host_fsm_step(void)
+{
+	fsmSteps++;
+}
+
+/* One TIM2 tick (HAL_TIM_PeriodElapsedCallback), then the main loop:
+ * due tasks (buzzer pattern), then the FSM slot of the pipeline
+ */
+static void tick(void)
+{
+	uint32_t steps = fsmSteps;
+
+	Timebase_Advance(SCH_TICK_MS);
+	SCH_Update_Ticks(1);
+	timerAdvance(1);
+	TW_Advance(1);
+	while (SCH_Idle_Ticks() == 0) SCH_Dispatch_Tasks();
+	if (polled) State_Event_Timer();
+	State_Process();
+	ticks++;
+	if (fsmSteps != steps) activeTicks++;
+}
+
+static void run_ms(uint32_t ms)
+{
+	for (uint32_t t = 0; t < TICKS(ms); t++) tick();
+}
+
+/* Ticks until the state changes, at most 'limitMs' */
+static uint32_t ms_in_state(uint32_t limitMs)
+{
+	uint8_t state = State_GetState();
+	uint32_t ms = 0;
+	while (State_GetState() == state && ms < limitMs)
+	{
+		tick();
+		ms += SCH_TICK_MS;
+	}
+	return ms;
+}
+
+static void type(const char *keys)
+{
+	for (; *keys; keys++) State_Event_KeypadChar(*keys, HAL_GetTick());
+}
+
+static void enter(void)
+{
+	State_Event_Enter(HAL_GetTick());
+	tick();
+}
+
+static void door(uint8_t closed)
+{
+	gInputState.doorSensor = closed;
+	if (closed) State_Event_DoorSensor_Close(HAL_GetTick());
+	else State_Event_DoorSensor_Open(HAL_GetTick());
+	tick();
+}
+
+/* Boot as main() does, settled in LOCKED_SLEEP */
+static void boot(void)
+{
+	SCH_Init();
+	KeyQueue_Init();
+	Latency_Init();
+	init_global_variables();
+	State_Init();
+	tick();
+}
+
+/* From LOCKED_SLEEP: the first key wakes the lock, keys typed during the
+ * 1s mask are held back and entered in LOCKED_ENTRY
+ */
+static void wake_and_type(const char *keys)
+{
+	State_Event_KeypadChar('0', HAL_GetTick());
+	tick();
+	CHECK_EQ(State_GetState(), LOCKED_WAKEUP);
+	type(keys);
+	tick();
+	CHECK_EQ(State_GetState(), LOCKED_WAKEUP);
+	CHECK_EQ(ms_in_state(2000), 1000 - SCH_TICK_MS);
+	CHECK_EQ(State_GetState(), LOCKED_ENTRY);
+	CHECK(strcmp(inputBuffer, keys) == 0);
+}
+
+// --- Password entry ---
+
+static void test_correct_password(void)
+{
+	boot();
+	CHECK_EQ(State_GetState(), LOCKED_SLEEP);
+	CHECK_EQ(gOutputStatus.solenoid, SOLENOID_LOCKED);
+
+	wake_and_type("1234");
+	enter();
+	CHECK_EQ(State_GetState(), UNLOCKED_WAITOPEN);
+	CHECK_EQ(gOutputStatus.solenoid, SOLENOID_UNLOCKED);
+	CHECK_EQ(gOutputStatus.ledGreen, LED_ON);
+	CHECK_EQ(gSystemTimers.failedAttempts, 0);
+
+	// Door never opened: relock after 10s, sleep after the 3s notice
+	CHECK_EQ(ms_in_state(20000), 10000);
+	CHECK_EQ(State_GetState(), LOCKED_RELOCK);
+	CHECK_EQ(gOutputStatus.solenoid, SOLENOID_LOCKED);
+	CHECK_EQ(ms_in_state(20000), 3000);
+	CHECK_EQ(State_GetState(), LOCKED_SLEEP);
+}
+
+/* The password may be anywhere in the input (KMP), backspace edits it */
+static void test_password_in_input(void)
+{
+	boot();
+	wake_and_type("9912");
+	State_Event_Backspace(HAL_GetTick());
+	type("234");
+	tick();
+	CHECK(strcmp(inputBuffer, "991234") == 0);
+	enter();
+	CHECK_EQ(State_GetState(), UNLOCKED_WAITOPEN);
+}
+
+static void test_format_error(void)
+{
+	boot();
+	wake_and_type("12");
+	enter();
+	CHECK_EQ(State_GetState(), LOCKED_VERIFY);
+	CHECK_EQ(ms_in_state(10000), 3000);
+	CHECK_EQ(State_GetState(), LOCKED_ENTRY);
+	CHECK_EQ(gSystemTimers.failedAttempts, 0); // Not an attempt
+	CHECK_EQ(inputBuffer[0], '\0');
+}
+
+/* Three wrong passwords in LOCKED_ENTRY, the last one penalised */
+static void wrong_three_times(void)
+{
+	for (int k = 0; k < 3; k++)
+	{
+		type("5555");
+		enter();
+		if (k < 2)
+		{
+			CHECK_EQ(State_GetState(), LOCKED_VERIFY);
+			CHECK_EQ(ms_in_state(10000), 3000);
+			CHECK_EQ(State_GetState(), LOCKED_ENTRY);
+		}
+	}
+}
+
+/* Every third wrong password locks the keypad for 1, 5, 25, 125 minutes,
+ * the fifteenth for good (until the mechanical key)
+ */
+static void test_penalties(void)
+{
+	static const uint32_t minutes[] = { 1, 5, 25, 125 };
+
+	boot();
+	wake_and_type("");
+	for (int level = 0; level < 4; level++)
+	{
+		wrong_three_times();
+		CHECK_EQ(State_GetState(), PENALTY_TIMER);
+		CHECK_EQ(gSystemTimers.failedAttempts, 3u * (level + 1));
+
+		// Keys typed meanwhile are dropped, the alarm task runs from the next tick
+		type("1234");
+		tick();
+		CHECK_EQ(gOutputStatus.buzzer, BUZZER_ON);
+		CHECK_EQ(ms_in_state(200u * 60000), minutes[level] * 60000 - SCH_TICK_MS);
+		CHECK_EQ(State_GetState(), LOCKED_ENTRY);
+		CHECK_EQ(gOutputStatus.buzzer, BUZZER_OFF);	// The 10s pattern ended long ago
+		CHECK_EQ(TW_Next_Due(), SCH_IDLE_FOREVER);
+	}
+	wrong_three_times();
+	CHECK_EQ(State_GetState(), PERMANENT_LOCKOUT);
+	run_ms(60000);
+	type("1234");
+	enter();
+	CHECK_EQ(State_GetState(), PERMANENT_LOCKOUT);
+
+	State_Event_KeySensor(HAL_GetTick());
+	tick();
+	CHECK_EQ(State_GetState(), UNLOCKED_WAITOPEN);
+	CHECK_EQ(gSystemTimers.failedAttempts, 0);
+}
+
+/* A 125 min penalty that starts an hour before HAL_GetTick wraps (49.7
+ * days after boot): the 64-bit deadline is not reached until the penalty
+ * ends on the wheel, and is reached from then on
+ */
+static void test_penalty_across_wrap(void)
+{
+	boot();
+	wake_and_type("");
+	gSystemTimers.failedAttempts = 9;
+	// Power-on long ago: move the clock to an hour before the wrap
+	uint64_t wrapMs = (Timebase_Now_Ms() | 0xFFFFFFFFull) + 1;
+	Timebase_Advance((uint32_t)(wrapMs - Timebase_Now_Ms() - 60 * 60000));
+	wrong_three_times();
+	CHECK_EQ(State_GetState(), PENALTY_TIMER);
+	CHECK_EQ(gSystemTimers.penaltyEndMs, Timebase_Now_Ms() + 125 * 60000);
+	CHECK(gSystemTimers.penaltyEndMs > wrapMs);
+
+	uint32_t ms = 0, last = HAL_GetTick();
+	int wraps = 0;
+	while (State_GetState() == PENALTY_TIMER && ms < 200 * 60000)
+	{
+		CHECK(!Timebase_Reached(gSystemTimers.penaltyEndMs));
+		tick();
+		ms += SCH_TICK_MS;
+		wraps += HAL_GetTick() < last;
+		last = HAL_GetTick();
+	}
+	CHECK_EQ(ms, 125 * 60000);
+	CHECK_EQ(wraps, 1);
+	CHECK_EQ(State_GetState(), LOCKED_ENTRY);
+	CHECK(Timebase_Reached(gSystemTimers.penaltyEndMs));
+	CHECK(Timebase_Now_Ms() > wrapMs);
+	run_ms(60000);
+	CHECK(Timebase_Reached(gSystemTimers.penaltyEndMs));
+}
+
+/* Leaving PENALTY_TIMER early stops the penalty on the wheel: by the
+ * mechanical key (master_unlock) and by State_ForceUnlock (exit action)
+ */
+static void test_penalty_left_early(void)
+{
+	boot();
+	wake_and_type("");
+	wrong_three_times();
+	CHECK_EQ(State_GetState(), PENALTY_TIMER);
+	CHECK(TW_Next_Due() != SCH_IDLE_FOREVER);
+	State_Event_IndoorButton(HAL_GetTick());
+	tick();
+	CHECK_EQ(State_GetState(), UNLOCKED_WAITOPEN);
+	CHECK_EQ(TW_Next_Due(), SCH_IDLE_FOREVER);
+
+	boot();
+	wake_and_type("");
+	wrong_three_times();
+	CHECK_EQ(State_GetState(), PENALTY_TIMER);
+	type("77");	// Queued, dropped by the forced transition
+	State_ForceUnlock();
+	CHECK_EQ(TW_Next_Due(), SCH_IDLE_FOREVER);
+	tick();
+	CHECK_EQ(State_GetState(), UNLOCKED_WAITOPEN);
+	CHECK_EQ(gOutputStatus.solenoid, SOLENOID_UNLOCKED);
+	CHECK_EQ(ms_in_state(20000), 10000 - SCH_TICK_MS);	// Window armed by the call
+	CHECK_EQ(State_GetState(), LOCKED_RELOCK);
+}
+
+/* Keys held back in LOCKED_WAKEUP are not entered after a forced unlock */
+static void test_force_unlock_drops_deferred(void)
+{
+	boot();
+	State_Event_KeypadChar('0', HAL_GetTick());
+	tick();
+	CHECK_EQ(State_GetState(), LOCKED_WAKEUP);
+	type("4321");
+	tick();
+	uint32_t taken = Latency_Get(LATENCY_KEY_TO_FSM)->count;
+	State_ForceUnlock();
+	tick();
+	CHECK_EQ(State_GetState(), UNLOCKED_WAITOPEN);
+	CHECK_EQ(Latency_Get(LATENCY_KEY_TO_FSM)->count, taken);	// Never handed to the FSM
+
+	// Long Enter: set password starts from an empty buffer, then 3 keys
+	State_Event_Enter_Long(HAL_GetTick());
+	tick();
+	CHECK_EQ(State_GetState(), UNLOCKED_SETPASSWORD);
+	type("567");
+	tick();
+	CHECK(strcmp(inputBuffer, "567") == 0);
+}
+
+// --- Door and alarm ---
+
+static void test_forgot_close_alarm(void)
+{
+	boot();
+	wake_and_type("1234");
+	enter();
+	door(0);
+	CHECK_EQ(State_GetState(), UNLOCKED_DOOROPEN);
+	CHECK_EQ(ms_in_state(60000), 30000);
+	CHECK_EQ(State_GetState(), ALARM_FORGOTCLOSE);
+	CHECK(TW_Next_Due() != SCH_IDLE_FOREVER);
+	tick();
+	CHECK_EQ(gOutputStatus.buzzer, BUZZER_ON);
+
+	// The 10s pattern ends, the alarm repeats 5 min after it started
+	run_ms(10000);
+	CHECK_EQ(gOutputStatus.buzzer, BUZZER_OFF);
+	run_ms(5 * 60000 - 10000 - SCH_TICK_MS);
+	CHECK_EQ(gOutputStatus.buzzer, BUZZER_OFF);
+	tick();
+	CHECK_EQ(gOutputStatus.buzzer, BUZZER_ON);
+	CHECK_EQ(State_GetState(), ALARM_FORGOTCLOSE);
+
+	// Closing the door silences it and stops the repeat timer
+	run_ms(2000);
+	door(1);
+	CHECK_EQ(State_GetState(), UNLOCKED_WAITCLOSE);
+	CHECK_EQ(gOutputStatus.buzzer, BUZZER_OFF);
+	CHECK_EQ(TW_Next_Due(), SCH_IDLE_FOREVER);
+	CHECK_EQ(ms_in_state(60000), 10000);
+	CHECK_EQ(State_GetState(), LOCKED_RELOCK);
+	run_ms(10 * 60000);
+	CHECK_EQ(State_GetState(), LOCKED_SLEEP);
+	CHECK_EQ(gOutputStatus.buzzer, BUZZER_OFF);
+}
+
+/* Held indoor button while alarming: stays open, alarm stopped */
+static void test_always_open(void)
+{
+	boot();
+	wake_and_type("1234");
+	enter();
+	door(0);
+	run_ms(30000);
+	CHECK_EQ(State_GetState(), ALARM_FORGOTCLOSE);
+	State_Event_IndoorButton_Long(HAL_GetTick());
+	tick();
+	CHECK_EQ(State_GetState(), UNLOCKED_ALWAYSOPEN);
+	CHECK_EQ(TW_Next_Due(), SCH_IDLE_FOREVER);
+	run_ms(10 * 60000);
+	CHECK_EQ(State_GetState(), UNLOCKED_ALWAYSOPEN);
+	CHECK_EQ(gOutputStatus.solenoid, SOLENOID_UNLOCKED);
+	door(1);
+	CHECK_EQ(State_GetState(), UNLOCKED_WAITCLOSE);
+}
+
+/* The display's mask timer is its own: restarting it on every key does not
+ * move the FSM's 1s LOCKED_WAKEUP timeout
+ */
+static void test_display_mask_timer(void)
+{
+	boot();
+	CHECK(gCharMaskTimer != gMaskTimer);
+	State_Event_KeypadChar('0', HAL_GetTick());
+	tick();
+	CHECK_EQ(State_GetState(), LOCKED_WAKEUP);
+	for (int k = 0; k < 90; k++)
+	{
+		setTimer(gCharMaskTimer, 1000);	// Output_Process on a masked char
+		tick();
+	}
+	CHECK_EQ(ms_in_state(2000), 100);
+	CHECK_EQ(State_GetState(), LOCKED_ENTRY);
+}
+
+/* Battery low on wake: 3s notice before entry */
+static void test_battery_warning(void)
+{
+	boot();
+	gInputState.batteryLow = 1;
+	State_Event_Battery();
+	tick();
+	CHECK_EQ(State_GetState(), LOCKED_SLEEP);
+	State_Event_KeypadChar('0', HAL_GetTick());
+	tick();
+	CHECK_EQ(ms_in_state(2000), 1000);
+	CHECK_EQ(State_GetState(), BATTERY_WARNING);
+	CHECK_EQ(ms_in_state(10000), 3000);
+	CHECK_EQ(State_GetState(), LOCKED_ENTRY);
+	gInputState.batteryLow = 0;
+}
+
+// --- Invocations per day ---
+
+static uint32_t unlocks;
+
+static void to_sleep(void)
+{
+	for (uint32_t ms = 0; State_GetState() != LOCKED_SLEEP && ms < 60000; ms += SCH_TICK_MS) tick();
+	CHECK_EQ(State_GetState(), LOCKED_SLEEP);
+}
+
+/* Through the door and closed behind, then relock and sleep */
+static void walk_through(void)
+{
+	CHECK_EQ(State_GetState(), UNLOCKED_WAITOPEN);
+	unlocks++;
+	run_ms(2000);
+	door(0);
+	run_ms(5000);
+	door(1);
+	to_sleep();
+}
+
+/* 24 h: in by password every hour from 7:00 to 22:00, out by the indoor
+ * button every other hour, a typo at 19:00. Asleep the rest of the time.
+ */
+static void run_day(void)
+{
+	for (int h = 0; h < 24; h++)
+	{
+		uint32_t hourStart = ticks;
+
+		if (h >= 7 && h < 22)
+		{
+			wake_and_type(h == 19 ? "1243" : "1234");
+			enter();
+			if (h == 19)
+			{
+				CHECK_EQ(ms_in_state(10000), 3000);
+				type("1234");
+				enter();
+			}
+			walk_through();
+			if (h % 2)
+			{
+				run_ms(20 * 60000);
+				State_Event_IndoorButton(HAL_GetTick());
+				tick();
+				walk_through();
+			}
+		}
+		run_ms(HOUR_MS - (ticks - hourStart) * SCH_TICK_MS);
+	}
+}
+
+typedef struct {
+	uint32_t steps, activeTicks, nightSteps;
+} DayCount_t;
+
+static DayCount_t count_day(uint8_t pollEveryTick)
+{
+	DayCount_t d;
+
+	boot();
+	polled = pollEveryTick;
+	unlocks = 0;
+	ticks = fsmSteps = activeTicks = 0;
+	run_ms(7 * HOUR_MS);
+	d.nightSteps = fsmSteps;
+	run_ms(17 * HOUR_MS);
+	ticks = fsmSteps = activeTicks = 0;
+	run_day();
+	d.steps = fsmSteps;
+	d.activeTicks = activeTicks;
+	polled = 0;
+
+	CHECK_EQ(ticks, 24 * HOUR_MS / SCH_TICK_MS);
+	CHECK_EQ(unlocks, 15 + 8);
+	CHECK_EQ(State_GetState(), LOCKED_SLEEP);
+	return d;
+}
+
+/* The same day stepped every tick and on events only: every unlock in
+ * both, and the event-driven FSM never runs on an idle tick
+ */
+static void test_invocations_per_day(void)
+{
+	DayCount_t before = count_day(1);
+	DayCount_t after = count_day(0);
+
+	printf("\n%-16s %9s %11s %14s\n", "FSM", "steps", "busy ticks", "steps asleep");
+	printf("%-16s %9u %11u %14u\n", "every tick", before.steps, before.activeTicks, before.nightSteps);
+	printf("%-16s %9u %11u %14u\n", "on events", after.steps, after.activeTicks, after.nightSteps);
+
+	CHECK(before.steps >= ticks);
+	CHECK_EQ(after.nightSteps, 0);
+	CHECK(after.steps < ticks / 1000);
+	CHECK(after.activeTicks <= after.steps);
+}
+
+int main(void)
+{
+	RUN(test_correct_password);
+	RUN(test_password_in_input);
+	RUN(test_format_error);
+	RUN(test_penalties);
+	RUN(test_penalty_across_wrap);
+	RUN(test_penalty_left_early);
+	RUN(test_force_unlock_drops_deferred);
+	RUN(test_forgot_close_alarm);
+	RUN(test_always_open);
+	RUN(test_display_mask_timer);
+	RUN(test_battery_warning);
+	RUN(test_invocations_per_day);
+	return test_summary("fsm");
+}
@@ -0,0 +1,96 @@
+/*
+ * test_fsm_diff.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: Differential test of the FSM transition table against the
+ * switch it replaced (Reference/state_processing_switch.c): fsm_trace is
+ * run for each seed against both and the traces must match line for line.
+ *
+ * Compared: state, outputs, input buffer, attempts, penalty end, password,
+ * latency cause, queue depth, soft timer and penalty timer flags, tick by
+ * tick. Not compared: the alarm-repeat wheel timer, which the table stops on
+ * leaving ALARM_FORGOTCLOSE (intended); a later expiry of the switch's timer
+ * only wakes the FSM for a step with no event, which must change nothing
+ * else, and the traces check that.
+ *
+ * Usage: test_fsm_diff [seeds] [ticks per seed]
+ */
+#include "global.h"
+#include "test.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define DIFF_SEEDS		16
+#define DIFF_TICKS		20000000	// ~55 h per seed
+
+static char dir[256];
+static unsigned long visits[256];
+
+static FILE *trace(const char *name, unsigned seed, unsigned long ticks)
+{
+	char cmd[600];
+	snprintf(cmd, sizeof(cmd), "%s/%s %u %lu", dir, name, seed, ticks);
+	return popen(cmd, "r");
+}
+
+static void diff_seed(unsigned seed, unsigned long ticks)
+{
+	FILE *table = trace("fsm_trace_table", seed, ticks);
+	FILE *ref = trace("fsm_trace_switch", seed, ticks);
+	char a[300], b[300], prev[300] = "";
+	unsigned long lines = 0;
+
+	CHECK(table != NULL && ref != NULL);
+	if (table == NULL || ref == NULL) return;
+	for (;;)
+	{
+		char *ra = fgets(a, sizeof(a), table);
+		char *rb = fgets(b, sizeof(b), ref);
+		if (ra == NULL || rb == NULL)
+		{
+			CHECK(ra == NULL && rb == NULL);	// Same length
+			break;
+		}
+		if (strcmp(a, b) != 0)
+		{
+			CHECK(0);
+			printf("  seed %u after %s  table:  %s  switch: %s", seed, prev, a, b);
+			break;
+		}
+		unsigned long t;
+		unsigned state;
+		if (sscanf(a, "%lu s%u", &t, &state) == 2 && state < 256) visits[state]++;
+		strcpy(prev, a);
+		lines++;
+	}
+	CHECK(lines > 500);
+	pclose(table);
+	pclose(ref);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned seeds = (argc > 1) ? (unsigned)strtoul(argv[1], NULL, 0) : DIFF_SEEDS;
+	unsigned long ticks = (argc > 2) ? strtoul(argv[2], NULL, 0) : DIFF_TICKS;
+
+	strncpy(dir, argv[0], sizeof(dir) - 1);
+	char *slash = strrchr(dir, '/');
+	if (slash) *slash = '\0';
+	else strcpy(dir, ".");
+
+	printf("%-40s ", "test_traces_match");
+	fflush(stdout);
+	int before = testFailures;
+	for (unsigned seed = 1; seed <= seeds && testFailures == before; seed++)
+		diff_seed(seed, ticks);
+	printf("%s\n", testFailures == before ? "ok" : "FAILED");
+
+	// Every state reached, with enough random input
+	for (unsigned s = LOCKED_SLEEP; s <= LOCKED_RELOCK; s++)
+	{
+		if (visits[s] == 0) printf("  state %u never reached\n", s);
+		CHECK(visits[s] > 0);
+	}
+	return test_summary("fsm table vs switch");
+}
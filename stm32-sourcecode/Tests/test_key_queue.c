@@ -0,0 +1,150 @@
+/*
+ * test_key_queue.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: Host tests of the SPSC key event queue (key_queue.c).
+ */
+#include "key_queue.h"
+#include "test.h"
+#include <pthread.h>
+#include <sched.h>
+
+static KeyQueueEvent_t key_event(uint32_t n)
+{
+	KeyQueueEvent_t ev;
+	ev.type = KEY_EV_CHAR;
+	ev.key = (char)('0' + n % 10);
+	ev.timeMs = n;
+	return ev;
+}
+
+/* 50 keys within 200 ms: Input_Process posts 2 or 3 per 10 ms tick and
+ * State_Process drains the queue on the same tick
+ */
+static void test_burst_50_keys(void)
+{
+	KeyQueueStats_t stats;
+	KeyQueueEvent_t ev;
+	uint32_t sent = 0, received = 0;
+	int inOrder = 1;
+
+	KeyQueue_Init();
+	for (int tick = 0; tick < 20; tick++)
+	{
+		for (int k = 0; k < ((tick & 1) ? 3 : 2); k++)
+		{
+			KeyQueueEvent_t key = key_event(sent++);
+			CHECK(KeyQueue_Push(&key));
+		}
+		while (KeyQueue_Pop(&ev))
+		{
+			if (ev.timeMs != received || ev.key != (char)('0' + received % 10)) inOrder = 0;
+			received++;
+		}
+	}
+	CHECK_EQ(sent, 50);
+	CHECK_EQ(received, 50);
+	CHECK(inOrder);
+	KeyQueue_Get_Stats(&stats);
+	CHECK_EQ(stats.pushed, 50);
+	CHECK_EQ(stats.dropped, 0);
+	CHECK_EQ(stats.highWater, 3);
+}
+
+/* Consumer stalled for the whole burst: the first KEY_QUEUE_SIZE keys come
+ * out in order, the rest are dropped and counted
+ */
+static void test_overflow(void)
+{
+	KeyQueueStats_t stats;
+	KeyQueueEvent_t ev;
+
+	KeyQueue_Init();
+	for (uint32_t n = 0; n < 50; n++)
+	{
+		KeyQueueEvent_t key = key_event(n);
+		CHECK_EQ(KeyQueue_Push(&key), n < KEY_QUEUE_SIZE);
+	}
+	CHECK_EQ(KeyQueue_Count(), KEY_QUEUE_SIZE);
+	KeyQueue_Get_Stats(&stats);
+	CHECK_EQ(stats.pushed, KEY_QUEUE_SIZE);
+	CHECK_EQ(stats.dropped, 50 - KEY_QUEUE_SIZE);
+	CHECK_EQ(stats.highWater, KEY_QUEUE_SIZE);
+
+	for (uint32_t n = 0; n < KEY_QUEUE_SIZE; n++)
+	{
+		CHECK(KeyQueue_Pop(&ev));
+		CHECK_EQ(ev.timeMs, n);
+	}
+	CHECK(!KeyQueue_Pop(&ev));
+	CHECK_EQ(KeyQueue_Count(), 0);
+}
+
+/* Indices run free over many wraps of the uint8_t counters */
+static void test_wrap(void)
+{
+	KeyQueueEvent_t ev;
+	uint32_t next = 0;
+
+	KeyQueue_Init();
+	for (uint32_t n = 0; n < 10000; n++)
+	{
+		KeyQueueEvent_t key = key_event(n);
+		CHECK(KeyQueue_Push(&key));
+		if (n % 7 != 0 || KeyQueue_Count() >= KEY_QUEUE_SIZE - 1)
+		{
+			while (KeyQueue_Pop(&ev)) CHECK_EQ(ev.timeMs, next++);
+		}
+	}
+	while (KeyQueue_Pop(&ev)) CHECK_EQ(ev.timeMs, next++);
+	CHECK_EQ(next, 10000);
+}
+
+// --- Producer and consumer on separate threads ---
+
+#define SPSC_EVENTS		1000000
+
+static void *spsc_producer(void *arg)
+{
+	(void)arg;
+	for (uint32_t n = 0; n < SPSC_EVENTS; n++)
+	{
+		KeyQueueEvent_t key = key_event(n);
+		while (!KeyQueue_Push(&key)) sched_yield(); // Full: retry, not a test of drops
+	}
+	return NULL;
+}
+
+static void test_threads(void)
+{
+	pthread_t producer;
+	KeyQueueEvent_t ev;
+	uint32_t next = 0;
+	uint32_t bad = 0;
+
+	KeyQueue_Init();
+	pthread_create(&producer, NULL, spsc_producer, NULL);
+	while (next < SPSC_EVENTS)
+	{
+		if (!KeyQueue_Pop(&ev))
+		{
+			sched_yield();
+			continue;
+		}
+		if (ev.timeMs != next || ev.type != KEY_EV_CHAR || ev.key != (char)('0' + next % 10)) bad++;
+		next++;
+	}
+	pthread_join(producer, NULL);
+	CHECK_EQ(bad, 0);
+	CHECK(!KeyQueue_Pop(&ev));
+}
+
+int main(void)
+{
+	RUN(test_burst_50_keys);
+	RUN(test_overflow);
+	RUN(test_wrap);
+	RUN(test_threads);
+	return test_summary("key queue");
+}
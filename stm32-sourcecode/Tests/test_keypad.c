@@ -0,0 +1,391 @@
+/*
+ * test_keypad.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: Host tests of KEYPAD.c on the simulated GPIOA matrix
+ * (Stubs/keypad_matrix.c): the one-port fast scan against the HAL
+ * pin-by-pin fallback, ghost rejection, replay of fast-typing traces and
+ * the event ring.
+ */
+#include "keypad.h"
+#include "keypad_matrix.h"
+#include "test.h"
+#include <stdlib.h>
+#include <string.h>
+
+char KEYMAP[NUMROWS][NUMCOLS] = {
+	{'1', '2', '3', 'A'},
+	{'4', '5', '6', 'B'},
+	{'7', '8', '9', 'C'},
+	{'F', '0', 'E', 'D'}
+};
+
+static Keypad_HandleTypeDef keypad;
+
+/* The board wiring from main.h */
+static void init_board(Keypad_HandleTypeDef* KEYPAD)
+{
+	HostKeypad_Attach();
+	Keypad_Init(KEYPAD, KEYMAP,
+				COL1_GPIO_Port, COL1_Pin, COL2_GPIO_Port, COL2_Pin,
+				COL3_GPIO_Port, COL3_Pin, COL4_GPIO_Port, COL4_Pin,
+				ROW1_GPIO_Port, ROW1_Pin, ROW2_GPIO_Port, ROW2_Pin,
+				ROW3_GPIO_Port, ROW3_Pin, ROW4_GPIO_Port, ROW4_Pin);
+}
+
+static uint16_t scan_fast(uint16_t pressed)
+{
+	HostKeypad_Press(pressed);
+	keypad.FastPort = GPIOA;
+	return Keypad_Scan(&keypad);
+}
+
+static uint16_t scan_hal(uint16_t pressed)
+{
+	HostKeypad_Press(pressed);
+	keypad.FastPort = NULL;
+	uint16_t keys = Keypad_Scan(&keypad);
+	keypad.FastPort = GPIOA;
+	return keys;
+}
+
+// --- Fast port detection ---
+
+static void test_fast_port(void)
+{
+	Keypad_HandleTypeDef scattered;
+
+	init_board(&keypad);
+	CHECK(keypad.FastPort == GPIOA);
+	CHECK_EQ(keypad.RowShift, 0);
+	CHECK_EQ(keypad.ColShift, 4);
+
+	// One column on another port, then rows out of order: HAL fallback
+	HostKeypad_Attach();
+	Keypad_Init(&scattered, KEYMAP,
+				GPIOA, GPIO_PIN_4, GPIOA, GPIO_PIN_5, GPIOB, GPIO_PIN_6, GPIOA, GPIO_PIN_7,
+				GPIOA, GPIO_PIN_0, GPIOA, GPIO_PIN_1, GPIOA, GPIO_PIN_2, GPIOA, GPIO_PIN_3);
+	CHECK(scattered.FastPort == NULL);
+	Keypad_Init(&scattered, KEYMAP,
+				GPIOA, GPIO_PIN_4, GPIOA, GPIO_PIN_5, GPIOA, GPIO_PIN_6, GPIOA, GPIO_PIN_7,
+				GPIOA, GPIO_PIN_1, GPIOA, GPIO_PIN_0, GPIOA, GPIO_PIN_2, GPIOA, GPIO_PIN_3);
+	CHECK(scattered.FastPort == NULL);
+}
+
+// --- Scan ---
+
+/* Each key on its own: both paths report exactly that key */
+static void test_every_key(void)
+{
+	init_board(&keypad);
+	CHECK_EQ(scan_fast(0), 0);
+	CHECK_EQ(scan_hal(0), 0);
+	for (int row = 0; row < NUMROWS; row++)
+	{
+		for (int col = 0; col < NUMCOLS; col++)
+		{
+			uint16_t key = KEYPAD_KEY_BIT(row, col);
+			CHECK_EQ(scan_fast(key), key);
+			CHECK_EQ(scan_hal(key), key);
+			CHECK_EQ(Keypad_Readkey(&keypad), KEYMAP[row][col]);
+		}
+	}
+}
+
+/* Every one of the 65536 patterns: both paths agree, nothing pressed is
+ * missed, and every phantom key comes with a pattern the ghost check
+ * rejects
+ */
+static void test_all_patterns(void)
+{
+	int phantoms = 0;
+
+	init_board(&keypad);
+	for (uint32_t pressed = 0; pressed <= 0xFFFF; pressed++)
+	{
+		uint16_t fast = scan_fast((uint16_t)pressed);
+		uint16_t hal = scan_hal((uint16_t)pressed);
+
+		if (fast != hal) CHECK_EQ(fast, hal);
+		if ((fast & pressed) != pressed) CHECK_EQ(fast & pressed, pressed);
+		if (fast != pressed)
+		{
+			phantoms++;
+			keypad.State = 0;
+			Keypad_Update_Keys(&keypad, fast);
+			if (!keypad.Ghosting) CHECK_EQ(fast, pressed);
+			keypad.EvHead = keypad.EvTail = 0;
+		}
+	}
+	CHECK(phantoms > 0);
+}
+
+/* Columns go back to high after a scan: no row is held low in between */
+static void test_idle_columns(void)
+{
+	init_board(&keypad);
+	CHECK_EQ(GPIOA->ODR & 0xF0, 0xF0);
+
+	scan_fast(KEYPAD_KEY_BIT(2, 3));
+	hostGPIO_Settle(GPIOA);
+	CHECK_EQ(GPIOA->ODR & 0xF0, 0xF0);
+	CHECK_EQ(GPIOA->IDR & 0x0F, 0x0F);
+
+	scan_hal(KEYPAD_KEY_BIT(1, 1));
+	CHECK_EQ(GPIOA->ODR & 0xF0, 0xF0);
+	CHECK_EQ(GPIOA->IDR & 0x0F, 0x0F);
+}
+
+// --- Ghosting ---
+
+static int key_index(char key)
+{
+	for (int i = 0; i < NUMROWS * NUMCOLS; i++)
+	{
+		if (KEYMAP[i / NUMCOLS][i % NUMCOLS] == key) return i;
+	}
+	return -1;
+}
+
+static uint16_t keys_of(const char *keys)
+{
+	uint16_t bits = 0;
+	for (; *keys; keys++) bits |= 1u << key_index(*keys);
+	return bits;
+}
+
+static int pop_all(KeypadEvent_t *events, int max)
+{
+	int n = 0;
+	while (n < max && Keypad_Get_Event(&keypad, &events[n])) n++;
+	return n;
+}
+
+/* Two rows sharing two or more pressed columns are rejected, sharing one
+ * column is not
+ */
+static void test_ghost_patterns(void)
+{
+	static const struct { const char *keys; uint8_t ghost; } cases[] = {
+		{ "12",   0 }, { "14",   0 }, { "15",   0 }, { "124",  0 },	// Corner of a rectangle
+		{ "1245", 1 }, { "13F",  0 }, { "13FE", 1 }, { "2389", 1 },
+		{ "1A4B", 1 }, { "147F", 0 }, { "1234", 0 }, { "12345", 1 },
+		{ "159D", 0 }, { "1590", 0 }, { "15624", 1 },
+	};
+	KeypadEvent_t events[KEYPAD_EVENT_QUEUE];
+
+	init_board(&keypad);
+	for (unsigned c = 0; c < sizeof cases / sizeof cases[0]; c++)
+	{
+		keypad.State = 0;
+		keypad.EvHead = keypad.EvTail = 0;
+		Keypad_Update_Keys(&keypad, keys_of(cases[c].keys));
+		if (keypad.Ghosting != cases[c].ghost) printf("  %s\n", cases[c].keys);
+		CHECK_EQ(keypad.Ghosting, cases[c].ghost);
+		CHECK_EQ(pop_all(events, KEYPAD_EVENT_QUEUE) == 0, cases[c].ghost);
+	}
+}
+
+/* Three keys on the corners of a rectangle: the matrix shows the fourth
+ * as pressed, nothing is reported until the pattern is unambiguous again,
+ * then only the real keys come out
+ */
+static void test_ghost_on_matrix(void)
+{
+	KeypadEvent_t events[KEYPAD_EVENT_QUEUE];
+
+	init_board(&keypad);
+	HostKeypad_Press(keys_of("1"));
+	Keypad_Update(&keypad);
+	HostKeypad_Press(keys_of("12"));
+	Keypad_Update(&keypad);
+	CHECK_EQ(pop_all(events, KEYPAD_EVENT_QUEUE), 2);
+
+	HostKeypad_Press(keys_of("124"));
+	Keypad_Update(&keypad);
+	CHECK_EQ(keypad.Keys, keys_of("1245"));	// Phantom '5'
+	CHECK_EQ(keypad.Ghosting, 1);
+	CHECK_EQ(pop_all(events, KEYPAD_EVENT_QUEUE), 0);
+	CHECK_EQ(keypad.State, keys_of("12"));
+
+	HostKeypad_Press(keys_of("24"));
+	Keypad_Update(&keypad);
+	CHECK_EQ(keypad.Ghosting, 0);
+	CHECK_EQ(pop_all(events, KEYPAD_EVENT_QUEUE), 2);
+	CHECK_EQ(events[0].key, '1');
+	CHECK_EQ(events[0].pressed, 0);
+	CHECK_EQ(events[1].key, '4');
+	CHECK_EQ(events[1].pressed, 1);
+}
+
+// --- Fast typing ---
+
+#define SCAN_MS		10		// Keypad_Update every tick
+
+typedef struct { char key; uint16_t downMs; uint16_t upMs; } Stroke_t;
+
+/* Replays the strokes on the matrix, one scan every SCAN_MS, and returns
+ * the presses in the order they came out
+ */
+static int replay(const Stroke_t *strokes, int count, char *typed, int max)
+{
+	KeypadEvent_t event;
+	int n = 0, presses = 0, releases = 0;
+	uint32_t endMs = 0;
+
+	for (int i = 0; i < count; i++)
+		if (strokes[i].upMs > endMs) endMs = strokes[i].upMs;
+
+	init_board(&keypad);
+	for (uint32_t t = SCAN_MS; t <= endMs + 2 * SCAN_MS; t += SCAN_MS)
+	{
+		uint16_t held = 0;
+		for (int i = 0; i < count; i++)
+		{
+			if (strokes[i].downMs <= t && t < strokes[i].upMs) held |= 1u << key_index(strokes[i].key);
+		}
+		HostKeypad_Press(held);
+		Keypad_Update(&keypad);
+		while (Keypad_Get_Event(&keypad, &event))
+		{
+			if (event.pressed)
+			{
+				if (n < max) typed[n++] = event.key;
+				presses++;
+			}
+			else
+			{
+				releases++;
+			}
+		}
+	}
+	CHECK_EQ(presses, releases);
+	return n;
+}
+
+/* Recorded on the door keypad: each press lands while the previous key is
+ * still down (n-key rollover), gaps down to 40 ms
+ */
+static const Stroke_t trace1[] = {	// A code down the middle column, two keys down at a time
+	{ '2',   0,  95 }, { '5',  60, 150 }, { '8', 110, 230 }, { '0', 170, 260 },
+	{ 'E', 240, 330 },
+};
+static const Stroke_t trace2[] = {	// Same key twice, then a roll along a row
+	{ '7',   0,  70 }, { '7', 110, 180 }, { '8', 150, 240 }, { '9', 200, 290 },
+	{ 'C', 250, 330 }, { '1', 300, 420 },
+};
+static const Stroke_t trace3[] = {	// Keys of one column, released out of order
+	{ '1',   0, 200 }, { '4',  40,  90 }, { '7',  80, 170 }, { 'F', 130, 260 },
+	{ '3', 220, 300 }, { '6', 270, 350 },
+};
+
+static void check_trace(const Stroke_t *strokes, int count)
+{
+	char typed[64], expect[64];
+
+	for (int i = 0; i < count; i++) expect[i] = strokes[i].key;
+	int n = replay(strokes, count, typed, 64);
+	CHECK_EQ(n, count);
+	CHECK(memcmp(typed, expect, count) == 0);
+}
+
+static void test_typing_traces(void)
+{
+	check_trace(trace1, sizeof trace1 / sizeof trace1[0]);
+	check_trace(trace2, sizeof trace2 / sizeof trace2[0]);
+	check_trace(trace3, sizeof trace3 / sizeof trace3[0]);
+}
+
+/* Random fast typing: presses at least one scan apart, each key held
+ * 30 - 150 ms, up to two keys down at a time (three may ghost)
+ */
+static void test_typing_random(void)
+{
+	Stroke_t strokes[40];
+
+	srand(16);
+	for (int round = 0; round < 500; round++)
+	{
+		int t = 0, count = 0;
+		for (int i = 0; i < 40; i++)
+		{
+			Stroke_t s = { KEYMAP[rand() % NUMROWS][rand() % NUMCOLS], 0, 0 };
+			int earliest = t + SCAN_MS + rand() % 60;
+
+			// A key already down cannot be pressed again; keep at most two down
+			int down = 0;
+			for (int k = 0; k < count; k++)
+			{
+				if (strokes[k].upMs + SCAN_MS > earliest)
+				{
+					down++;
+					if (strokes[k].key == s.key) earliest = strokes[k].upMs + SCAN_MS;
+				}
+			}
+			for (int k = 0; down >= 2 && k < count; k++)
+			{
+				if (strokes[k].upMs + SCAN_MS > earliest) earliest = strokes[k].upMs + SCAN_MS;
+			}
+			s.downMs = (uint16_t)earliest;
+			s.upMs = (uint16_t)(earliest + 30 + rand() % 121);
+			strokes[count++] = s;
+			t = earliest;
+		}
+		check_trace(strokes, count);
+	}
+}
+
+// --- Event ring ---
+
+/* The ring holds KEYPAD_EVENT_QUEUE - 1 events: later ones are dropped,
+ * the oldest are kept in order, and it works again once read
+ */
+static void test_ring_full(void)
+{
+	static const uint8_t order[] = { 0, 1, 2, 3, 4, 8, 12 };
+	KeypadEvent_t events[KEYPAD_EVENT_QUEUE];
+
+	init_board(&keypad);
+	// Row 1-2-3-A, then column 1-4-7-F (one shared key: no ghost), then all up
+	Keypad_Update_Keys(&keypad, 0x000F);
+	Keypad_Update_Keys(&keypad, 0x111F);
+	Keypad_Update_Keys(&keypad, 0);
+	CHECK_EQ(pop_all(events, KEYPAD_EVENT_QUEUE), KEYPAD_EVENT_QUEUE - 1);
+	for (int i = 0; i < KEYPAD_EVENT_QUEUE - 1; i++)
+	{
+		CHECK_EQ(events[i].index, order[i]);
+		CHECK_EQ(events[i].pressed, 1);
+	}
+	CHECK_EQ(keypad.State, 0);
+
+	// Filled one update at a time while nobody reads
+	for (int i = 0; i < 10; i++)
+	{
+		Keypad_Update_Keys(&keypad, KEYPAD_KEY_BIT(0, 0));
+		Keypad_Update_Keys(&keypad, 0);
+	}
+	CHECK_EQ(pop_all(events, KEYPAD_EVENT_QUEUE), KEYPAD_EVENT_QUEUE - 1);
+	for (int i = 0; i < KEYPAD_EVENT_QUEUE - 1; i++) CHECK_EQ(events[i].pressed, (i + 1) & 1);
+	CHECK_EQ(pop_all(events, KEYPAD_EVENT_QUEUE), 0);
+
+	// Empty again: nothing lost from here on
+	Keypad_Update_Keys(&keypad, KEYPAD_KEY_BIT(3, 1));
+	CHECK_EQ(pop_all(events, KEYPAD_EVENT_QUEUE), 1);
+	CHECK_EQ(events[0].key, '0');
+	CHECK_EQ(keypad.State, KEYPAD_KEY_BIT(3, 1));
+}
+
+int main(void)
+{
+	RUN(test_fast_port);
+	RUN(test_every_key);
+	RUN(test_all_patterns);
+	RUN(test_idle_columns);
+	RUN(test_ghost_patterns);
+	RUN(test_ghost_on_matrix);
+	RUN(test_typing_traces);
+	RUN(test_typing_random);
+	RUN(test_ring_full);
+	return test_summary("keypad");
+}
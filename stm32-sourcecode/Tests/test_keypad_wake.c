@@ -0,0 +1,347 @@
+/*
+ * test_keypad_wake.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: Host tests of keypad_wake.c with simulated EXTI and GPIO:
+ * standby entry in LOCKED_SLEEP, and the time from a key or sensor edge in
+ * standby to the debounced press (< 20 ms, wherever the edge falls in the
+ * 10 ms tick). Built with INPUT_DMA_SAMPLING=0: the buttons are read at the
+ * tick with the keypad, the wake path is the same in both builds.
+ */
+#include "keypad_wake.h"
+#include "keypad.h"
+#include "keypad_matrix.h"
+#include "input_reading.h"
+#include "scheduler.h"
+#include "timebase.h"
+#include "timer.h"
+#include "timer_wheel.h"
+#include "global.h"
+#include "test.h"
+#include <stdlib.h>
+
+#define WAKE_LATENCY_MS		20
+#define ROW_LINES			(ROW1_Pin | ROW2_Pin | ROW3_Pin | ROW4_Pin)
+#define SENSOR_LINES		(DOOR_SENSOR_Pin | KEY_SENSOR_Pin | BUTTON_Pin)
+
+char KEYMAP[NUMROWS][NUMCOLS] = {
+	{'1', '2', '3', 'A'},
+	{'4', '5', '6', 'B'},
+	{'7', '8', '9', 'C'},
+	{'F', '0', 'E', 'D'}
+};
+Keypad_HandleTypeDef hKeypad;
+SystemState_t gSystemState;
+int TIMER_CYCLE = 10; // global.c
+
+static uint32_t batteryWakes;
+
+void Battery_Monitor_Wake(void)
+{
+	batteryWakes++;
+}
+
+/* main.c */
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+	Keypad_Wake_Irq(GPIO_Pin);
+}
+
+static void timer_fired(void) { }
+
+/* Main loop pass after WFI: whatever the interrupts made due */
+static void main_loop(void)
+{
+	do SCH_Dispatch_Tasks(); while (SCH_Idle_Ticks() == 0);
+}
+
+/* One millisecond of target time: TIM2 counts, its update ends each tick
+ * (the ISR of main.c), then the main loop. In standby the target stretches
+ * the TIM2 period and an EXTI wake ends it after the current tick: the
+ * ticks fall on the same 10 ms grid.
+ */
+static void run_ms(uint32_t ms)
+{
+	while (ms-- > 0)
+	{
+		if (++TIM2->CNT == SCH_TICK_MS)
+		{
+			TIM2->CNT = 0;
+			Timebase_Advance(SCH_TICK_MS);
+			SCH_Update_Ticks(1);
+			timerAdvance(1);
+			TW_Advance(1);
+		}
+		main_loop();
+	}
+}
+
+/* Keys go down (or up) now: the EXTI interrupt, if armed, then the main loop */
+static void press(uint16_t keys)
+{
+	HostKeypad_Press(keys);
+	main_loop();
+}
+
+static void door_sensor(GPIO_PinState level)
+{
+	if (level == GPIO_PIN_SET)
+		GPIOC->IDR |= DOOR_SENSOR_Pin;
+	else
+		GPIOC->IDR &= ~(uint32_t)DOOR_SENSOR_Pin;
+	hostGPIO_Settle(GPIOC);
+	main_loop();
+}
+
+/* main.c task table, the pipeline tasks between them are not needed here */
+static void init_tasks(void)
+{
+	SCH_Init();
+	SCH_Add_Task_Priority(button_reading, 0, 1, 0);
+	SCH_Add_Task_Priority(Keypad_Wake_Process, 0, 1, 4);
+	Keypad_Wake_Init();
+}
+
+/* Board after reset, awake in LOCKED_SLEEP with nothing pressed */
+static void init_board(void)
+{
+	EXTI->IMR = 0;
+	SCH_Standby(0);
+	HostKeypad_Attach();
+	GPIOB->IDR = ENTER_Pin | BACKSPACE_Pin;		// Pull-ups, released
+	GPIOC->IDR = SENSOR_LINES;
+	hostGPIO_Settle(GPIOB);
+	hostGPIO_Settle(GPIOC);
+	Keypad_Init(&hKeypad, KEYMAP,
+				COL1_GPIO_Port, COL1_Pin, COL2_GPIO_Port, COL2_Pin,
+				COL3_GPIO_Port, COL3_Pin, COL4_GPIO_Port, COL4_Pin,
+				ROW1_GPIO_Port, ROW1_Pin, ROW2_GPIO_Port, ROW2_Pin,
+				ROW3_GPIO_Port, ROW3_Pin, ROW4_GPIO_Port, ROW4_Pin);
+	gSystemState.currentState = LOCKED_SLEEP;
+	input_reading_init();
+	Keypad_Wake_Init();
+	batteryWakes = 0;
+}
+
+/* Runs until standby, at most 'ms', returns the time it took */
+static uint32_t run_to_standby(uint32_t ms)
+{
+	uint32_t spent = 0;
+
+	while (!SCH_In_Standby() && spent < ms)
+	{
+		run_ms(1);
+		spent++;
+	}
+	return spent;
+}
+
+/* Runs until 'pressed' reads true, at most 'ms', returns the time it took */
+static uint32_t run_until(unsigned int (*pressed)(unsigned int), unsigned int index, uint32_t ms)
+{
+	uint32_t spent = 0;
+
+	while (!pressed(index) && spent < ms)
+	{
+		run_ms(1);
+		spent++;
+	}
+	return spent;
+}
+
+static unsigned int key_pressed(unsigned int key)
+{
+	return (keypad_keys_debounced() >> key) & 1u;
+}
+
+static unsigned int key_released(unsigned int key)
+{
+	return !key_pressed(key);
+}
+
+static unsigned int button_released(unsigned int index)
+{
+	return !is_button_pressed(index);
+}
+
+// --- Standby ---
+
+/* KEYPAD_WAKE_QUIET_MS with everything released: columns low, rows and
+ * sensors armed on falling edges
+ */
+static void test_standby_entry(void)
+{
+	init_board();
+	uint32_t spent = run_to_standby(2 * KEYPAD_WAKE_QUIET_MS);
+
+	CHECK(SCH_In_Standby());
+	CHECK(spent >= KEYPAD_WAKE_QUIET_MS - SCH_TICK_MS);
+	CHECK(spent <= KEYPAD_WAKE_QUIET_MS + 2 * SCH_TICK_MS);
+	CHECK_EQ(GPIOA->ODR & (COL1_Pin | COL2_Pin | COL3_Pin | COL4_Pin), 0);
+	CHECK_EQ(EXTI->IMR & (ROW_LINES | SENSOR_LINES), ROW_LINES | SENSOR_LINES);
+	CHECK_EQ(EXTI->FTSR & (ROW_LINES | SENSOR_LINES), ROW_LINES | SENSOR_LINES);
+	CHECK_EQ(SCH_Idle_Ticks(), SCH_IDLE_FOREVER);
+
+	// Time-driven tasks are frozen: nothing changes over an hour
+	run_ms(3600000);
+	CHECK(SCH_In_Standby());
+	CHECK_EQ(batteryWakes, 0);
+}
+
+/* A soft timer or a wheel timer still running keeps the board out of
+ * standby (timerNextDue / TW_Next_Due not SCH_IDLE_FOREVER)
+ */
+static void test_standby_waits_for_timers(void)
+{
+	init_board();
+	int soft = timerCreate(timer_fired, 0);
+	int wheel = TW_Create(timer_fired, 0);
+	CHECK(soft != TIMER_NONE);
+	CHECK(wheel != TW_NONE);
+
+	setTimer(soft, 3000);
+	CHECK_EQ(run_to_standby(2500), 2500);
+	CHECK(!SCH_In_Standby());
+	CHECK(run_to_standby(2000) <= 500 + KEYPAD_WAKE_QUIET_MS + SCH_TICK_MS);
+	CHECK(SCH_In_Standby());
+	CHECK(timerConsume(soft));
+
+	init_board();
+	TW_Start(wheel, 3000);
+	CHECK_EQ(run_to_standby(2500), 2500);
+	CHECK(run_to_standby(2000) <= 500 + KEYPAD_WAKE_QUIET_MS + SCH_TICK_MS);
+	CHECK(SCH_In_Standby());
+	CHECK(TW_Consume(wheel));
+
+	timerDelete(soft);
+}
+
+// --- Wake latency ---
+
+/* Every key, pressed at every millisecond of the tick from standby: the
+ * debounced press follows within WAKE_LATENCY_MS, never inside the
+ * INPUT_WAKE_SETTLE_MS bounce window, dated at the edge. The release puts
+ * the board back in standby.
+ */
+static void test_key_wake_latency(void)
+{
+	uint32_t worst = 0, best = WAKE_LATENCY_MS;
+	uint32_t wakes = 0;
+
+	init_board();
+	for (unsigned int key = 0; key < NUMROWS * NUMCOLS; key++)
+	{
+		for (uint32_t offset = 0; offset < SCH_TICK_MS; offset++)
+		{
+			CHECK(run_to_standby(2 * KEYPAD_WAKE_QUIET_MS + 500) < 2 * KEYPAD_WAKE_QUIET_MS + 500);
+			run_ms((SCH_TICK_MS - TIM2->CNT + offset) % SCH_TICK_MS);
+
+			uint32_t pressMs = HAL_GetTick();
+			press((uint16_t)(1u << key));
+			wakes++;
+			CHECK(!SCH_In_Standby());
+			uint32_t latency = run_until(key_pressed, key, 100);
+			CHECK(latency < WAKE_LATENCY_MS);
+			CHECK(latency >= 5);
+			CHECK_EQ(keypad_keys_debounced(), 1u << key);
+			CHECK_EQ(keypad_edge_ms((uint8_t)key), pressMs);
+			if (latency > worst) worst = latency;
+			if (latency < best) best = latency;
+
+			run_ms(50 + (uint32_t)rand() % 200);
+			press(0);
+			CHECK(run_until(key_released, key, 100) < 100);
+		}
+	}
+	CHECK_EQ(batteryWakes, wakes);
+	// Edges at every phase of the tick: the whole window was covered
+	CHECK(worst >= SCH_TICK_MS);
+	CHECK(best <= SCH_TICK_MS);
+}
+
+/* Contact bounce on the way down: the first edge wakes, the bounces that
+ * follow are masked, one clean press comes out of it
+ */
+static void test_key_wake_bounce(void)
+{
+	init_board();
+	srand(1);
+	for (int round = 0; round < 200; round++)
+	{
+		unsigned int key = (unsigned int)rand() % (NUMROWS * NUMCOLS);
+		uint16_t bit = (uint16_t)(1u << key);
+
+		CHECK(SCH_In_Standby() || run_to_standby(2 * KEYPAD_WAKE_QUIET_MS) < 2 * KEYPAD_WAKE_QUIET_MS);
+		run_ms((uint32_t)rand() % SCH_TICK_MS);
+		uint32_t pressMs = HAL_GetTick();
+		uint32_t spent = 0;
+		for (int b = 0; b < 4; b++, spent++)
+		{
+			press((b & 1) ? 0 : bit);
+			run_ms(1);
+			CHECK_EQ(keypad_keys_debounced(), 0);
+		}
+		press(bit);
+		spent += run_until(key_pressed, key, 100);
+		CHECK(spent < WAKE_LATENCY_MS);
+		CHECK_EQ(keypad_keys_debounced(), bit);
+		CHECK_EQ(keypad_edge_ms((uint8_t)key), pressMs);
+
+		// Held: no second press, no release
+		for (int t = 0; t < 100; t++)
+		{
+			run_ms(1);
+			CHECK_EQ(keypad_keys_debounced(), bit);
+		}
+		press(0);
+		CHECK(run_until(key_released, key, 100) < 100);
+	}
+}
+
+/* A door sensor edge on GPIOC wakes the board the same way */
+static void test_sensor_wake_latency(void)
+{
+	init_board();
+	for (uint32_t offset = 0; offset < SCH_TICK_MS; offset++)
+	{
+		CHECK(run_to_standby(2 * KEYPAD_WAKE_QUIET_MS + 500) < 2 * KEYPAD_WAKE_QUIET_MS + 500);
+		run_ms((SCH_TICK_MS - TIM2->CNT + offset) % SCH_TICK_MS);
+
+		uint32_t openMs = HAL_GetTick();
+		door_sensor(GPIO_PIN_RESET);
+		CHECK(run_until(is_button_pressed, DOOR_SENSOR_INDEX, 100) < WAKE_LATENCY_MS);
+		CHECK_EQ(button_edge_ms(DOOR_SENSOR_INDEX), openMs);
+
+		run_ms(500);
+		door_sensor(GPIO_PIN_SET);
+		CHECK(run_until(button_released, DOOR_SENSOR_INDEX, 100) < 100);
+	}
+}
+
+/* An edge on a line that is not armed (a row outside standby) is ignored */
+static void test_no_wake_outside_standby(void)
+{
+	init_board();
+	run_ms(100);
+	CHECK(!SCH_In_Standby());
+	CHECK_EQ(EXTI->IMR & ROW_LINES, 0);
+
+	press(KEYPAD_KEY_BIT(1, 2));
+	CHECK(run_until(key_pressed, 1 * NUMCOLS + 2, 100) < 100);
+	CHECK_EQ(batteryWakes, 0);
+	press(0);
+	CHECK(run_until(key_released, 1 * NUMCOLS + 2, 100) < 100);
+}
+
+int main(void)
+{
+	init_tasks();
+	RUN(test_standby_entry);
+	RUN(test_standby_waits_for_timers);
+	RUN(test_key_wake_latency);
+	RUN(test_key_wake_bounce);
+	RUN(test_sensor_wake_latency);
+	RUN(test_no_wake_outside_standby);
+	return test_summary("keypad wake");
+}
@@ -0,0 +1,346 @@
+/*
+ * test_latency.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: Host scenario runner for the input -> relay latency
+ * (latency_hist.h). The real pipeline (button_reading, Input_Process,
+ * State_Process, Output_Process) runs on the scheduler with a microsecond
+ * clock: TIM2 ticks every 10 ms, I2C transfers and HAL_Delay take their
+ * time inside the task that makes them. 100 unlocks, by password + Enter
+ * or by the indoor button, are timed from the physical press to the relay
+ * pin and compared with what the firmware histograms record. Each case
+ * changes one thing (bus speed, task order) and bounds the result, so a
+ * change that slows the pipeline fails here with the numbers printed.
+ * Boot to the first keypad scan is timed the same way.
+ */
+#include "battery_monitor.h"
+#include "input_reading.h"
+#include "input_processing.h"
+#include "state_processing.h"
+#include "output_processing.h"
+#include "keypad.h"
+#include "keypad_matrix.h"
+#include "latency_hist.h"
+#include "scheduler.h"
+#include "timebase.h"
+#include "timer.h"
+#include "timer_wheel.h"
+#include "global.h"
+#include "test.h"
+#include <stdlib.h>
+
+#define CYCLES			100
+#define CYCLE_US		40000000LL	// Back to LOCKED_SLEEP well within it
+#define FIRST_US		2000000LL
+#define INPUT_ENTER		16			// Script inputs: 0..15 keypad key, then the buttons
+#define INPUT_INDOOR	17
+
+/* Regression bounds, press -> relay (ms): measured 14.9 / 19.9, a tick
+ * to sample, one to debounce, the relay in the same pass as the FSM
+ */
+#define BASELINE_MEAN_MS	16
+#define BASELINE_WORST_MS	21
+
+I2C_HandleTypeDef hi2c1;
+I2C_LCD_HandleTypeDef lcd1;
+
+/* Battery monitor left out (ADC calibration waits on the hardware) */
+void Battery_Monitor_Init(void)
+{
+}
+
+uint8_t Battery_Monitor_Process(void)
+{
+	return 0;
+}
+
+typedef struct {
+	int64_t atUs, lenUs;
+	int input;
+} Press_t;
+
+static Press_t script[CYCLES * 6];
+static int presses;
+static int64_t causeUs[CYCLES];		// Last press of each unlock
+
+static int64_t nowUs;
+static int64_t scriptBaseUs;		// Script time 0 of the running case
+static uint32_t i2cUsPerByte;
+static int64_t relayUs;				// Last relay rising edge
+static uint32_t relaySeen;
+
+/* The script at 'nowUs' onto the pins: keypad matrix, Enter on GPIOB,
+ * indoor button on GPIOC, active low
+ */
+static void apply_inputs(void)
+{
+	int64_t t = nowUs - scriptBaseUs;
+	uint16_t keys = 0;
+	uint8_t enter = 0, indoor = 0;
+
+	for (int i = 0; i < presses && script[i].atUs <= t; i++)
+	{
+		if (t >= script[i].atUs + script[i].lenUs) continue;
+		if (script[i].input < INPUT_ENTER) keys |= (uint16_t)(1u << script[i].input);
+		else if (script[i].input == INPUT_ENTER) enter = 1;
+		else indoor = 1;
+	}
+	if (keys != HostKeypad_Pressed()) HostKeypad_Press(keys);
+	GPIOB->IDR = ENTER_Pin | BACKSPACE_Pin;
+	if (enter) GPIOB->IDR &= ~(uint32_t)ENTER_Pin;
+	GPIOC->IDR = DOOR_SENSOR_Pin | KEY_SENSOR_Pin | BUTTON_Pin;
+	if (indoor) GPIOC->IDR &= ~(uint32_t)BUTTON_Pin;
+}
+
+/* Relay pin written high since the last look: the edge is 'nowUs', time
+ * only moves in advance_us
+ */
+static void watch_relay(void)
+{
+	static uint32_t last;
+	uint32_t level = GPIOB->ODR & RELAY_Pin;
+
+	if (level && !last)
+	{
+		relayUs = nowUs;
+		relaySeen++;
+	}
+	last = level;
+}
+
+/* 'us' of CPU time or idling; TIM2 interrupts end every 10 ms on the way */
+static void advance_us(int64_t us)
+{
+	int64_t target = nowUs + us;
+
+	watch_relay();
+	while (nowUs < target)
+	{
+		int64_t nextTick = (nowUs / 10000 + 1) * 10000;
+		if (nextTick > target)
+		{
+			nowUs = target;
+			break;
+		}
+		nowUs = nextTick;
+		Timebase_Advance(SCH_TICK_MS);
+		SCH_Update_Ticks(1);
+		timerAdvance(1);
+		TW_Advance(1);
+	}
+	TIM2->CNT = (uint32_t)(nowUs / 1000 % SCH_TICK_MS);
+	apply_inputs();
+}
+
+/* Address + data bytes on the bus, 'i2cUsPerByte' each */
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t DevAddress,
+										  uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	advance_us((int64_t)i2cUsPerByte * (Size + 1));
+	return HAL_OK;
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+	advance_us((int64_t)Delay * 1000);
+}
+
+static int key_index(char c)
+{
+	for (int row = 0; row < NUMROWS; row++)
+		for (int col = 0; col < NUMCOLS; col++)
+			if (KEYMAP[row][col] == c) return row * NUMCOLS + col;
+	return -1;
+}
+
+static void add(int64_t atUs, int64_t lenUs, int input)
+{
+	script[presses++] = (Press_t){ atUs, lenUs, input };
+}
+
+/* Even cycles: wake key, "1234" at typing speed, Enter. Odd cycles: the
+ * indoor button. Same script for every case.
+ */
+static void make_script(void)
+{
+	srand(11);
+	presses = 0;
+	for (int c = 0; c < CYCLES; c++)
+	{
+		int64_t t = FIRST_US + c * CYCLE_US + rand() % 10000;
+		if (c % 2 == 0)
+		{
+			add(t, 100000, key_index('5'));
+			t += 1500000;
+			for (const char *k = "1234"; *k; k++)
+			{
+				add(t, 90000 + rand() % 40000, key_index(*k));
+				t += 200000 + rand() % 100000;
+			}
+			t += rand() % 10000;
+			add(t, 120000, INPUT_ENTER);
+		}
+		else
+		{
+			add(t, 150000, INPUT_INDOOR);
+		}
+		causeUs[c] = t;
+	}
+}
+
+/* main.c boot and task table; 'outputFirst' swaps State_Process and
+ * Output_Process, 'blockingLcd' runs lcd_init in main as before pt.h
+ */
+static void boot(uint8_t outputFirst, uint8_t blockingLcd)
+{
+	if (blockingLcd) lcd_init(&lcd1);
+	SCH_Init();
+	init_global_variables();
+	Latency_Init();
+	HostKeypad_Attach();
+	Keypad_Init(&hKeypad, KEYMAP,
+				COL1_GPIO_Port, COL1_Pin, COL2_GPIO_Port, COL2_Pin,
+				COL3_GPIO_Port, COL3_Pin, COL4_GPIO_Port, COL4_Pin,
+				ROW1_GPIO_Port, ROW1_Pin, ROW2_GPIO_Port, ROW2_Pin,
+				ROW3_GPIO_Port, ROW3_Pin, ROW4_GPIO_Port, ROW4_Pin);
+	apply_inputs();
+	Input_Init();
+	input_reading_init();
+	Output_Init();
+	State_Init();
+	SCH_Add_Task_Priority(button_reading, 0, 1, 0);
+	SCH_Add_Task_Priority(Input_Process,  0, 1, 1);
+	SCH_Add_Task_Priority(State_Process,  0, 1, outputFirst ? 3 : 2);
+	SCH_Add_Task_Priority(Output_Process, 0, 1, outputFirst ? 2 : 3);
+}
+
+/* Main loop to 'endUs': dispatch, then WFI to the next tick */
+static void run_to(int64_t endUs)
+{
+	while (nowUs < endUs)
+	{
+		while (SCH_Idle_Ticks() == 0) SCH_Dispatch_Tasks();
+		watch_relay();
+		advance_us((nowUs / 10000 + 1) * 10000 - nowUs);
+	}
+}
+
+typedef struct {
+	uint32_t unlocks;
+	double meanMs, worstMs;		// Physical press -> relay
+} Result_t;
+
+static Result_t run_case(const char *name, uint32_t usPerByte, uint8_t outputFirst)
+{
+	Result_t r = { 0, 0, 0 };
+	double sum = 0;
+
+	i2cUsPerByte = usPerByte;
+	scriptBaseUs = nowUs;
+	boot(outputFirst, 0);
+	for (int c = 0; c < CYCLES; c++)
+	{
+		uint32_t seen = relaySeen;
+
+		run_to(scriptBaseUs + FIRST_US + (c + 1) * CYCLE_US);
+		CHECK_EQ(State_GetState(), LOCKED_SLEEP);
+		if (relaySeen == seen + 1 && relayUs - scriptBaseUs >= causeUs[c])
+		{
+			double ms = (double)(relayUs - scriptBaseUs - causeUs[c]) / 1000.0;
+			r.unlocks++;
+			sum += ms;
+			if (ms > r.worstMs) r.worstMs = ms;
+		}
+	}
+	r.meanMs = r.unlocks ? sum / r.unlocks : 0;
+
+	printf("\n  %-24s press -> relay: mean %5.1f ms, worst %5.1f ms\n", name, r.meanMs, r.worstMs);
+	for (int id = 0; id < LATENCY_COUNT; id++)
+	{
+		const LatencyHist_t *h = Latency_Get((LatencyId_t)id);
+		printf("  %-24s n=%3u mean %5.1f max %4u ms |", id == LATENCY_KEY_TO_FSM ?
+			   "recorded key -> FSM" : "recorded input -> relay",
+			   h->count, h->count ? (double)h->totalMs / h->count : 0, h->maxMs);
+		for (int b = 0; b < LATENCY_BUCKETS; b++)
+			if (h->bucket[b]) printf(" %u+:%u", Latency_Bucket_Low_Ms((uint8_t)b), h->bucket[b]);
+		printf("\n");
+	}
+
+	// Every unlock recorded, stamped at sampling: at most a tick after the press
+	const LatencyHist_t *relay = Latency_Get(LATENCY_INPUT_TO_RELAY);
+	CHECK_EQ(r.unlocks, CYCLES);
+	CHECK_EQ(relay->count, r.unlocks);
+	double recordedMean = relay->count ? (double)relay->totalMs / relay->count : 0;
+	CHECK(recordedMean <= r.meanMs + 1);
+	CHECK(recordedMean >= r.meanMs - SCH_TICK_MS - 1);
+	CHECK(relay->maxMs <= r.worstMs + 1);
+	return r;
+}
+
+// --- Cases ---
+
+/* The board: 100 kHz bus (~90 us per byte), pipeline order of main.c */
+static void test_baseline(void)
+{
+	Result_t r = run_case("baseline", 90, 0);
+	CHECK(r.meanMs <= BASELINE_MEAN_MS);
+	CHECK(r.worstMs <= BASELINE_WORST_MS);
+}
+
+/* A bus ten times slower (clock stretching, long wires): a line takes
+ * ~70 ms to write, but the relay is written before the LCD and the typed
+ * digits are drawn between presses, so the relay keeps the baseline
+ */
+static void test_slow_i2c(void)
+{
+	Result_t r = run_case("slow I2C (900 us/byte)", 900, 0);
+	CHECK(r.meanMs <= BASELINE_MEAN_MS);
+	CHECK(r.worstMs <= BASELINE_WORST_MS);
+}
+
+/* Output_Process before State_Process: the relay follows a tick later */
+static void test_output_first(void)
+{
+	Result_t r = run_case("output before FSM", 90, 1);
+	CHECK(r.meanMs <= BASELINE_MEAN_MS + SCH_TICK_MS);
+	CHECK(r.worstMs <= BASELINE_WORST_MS + SCH_TICK_MS);
+}
+
+/* Boot to the first keypad scan (input_reading_boot_scan_ms), TIM2
+ * started just before
+ */
+static uint32_t boot_to_scan_ms(uint8_t blockingLcd)
+{
+	uint32_t bootMs = HAL_GetTick();
+
+	i2cUsPerByte = 90;
+	scriptBaseUs = nowUs;	// No press before FIRST_US
+	boot(0, blockingLcd);
+	run_to(nowUs + 1000000);
+	return input_reading_boot_scan_ms() - bootMs;
+}
+
+/* lcd_init in main held the scheduler back for its 81 ms of delays, the
+ * protothread in Output_Process lets the first tick scan the keypad
+ */
+static void test_boot_to_first_scan(void)
+{
+	uint32_t before = boot_to_scan_ms(1);
+	uint32_t after = boot_to_scan_ms(0);
+
+	printf("\n  boot -> first key scan: %u ms with lcd_init in main, %u ms with lcd_init_pt\n",
+		   before, after);
+	CHECK(after <= SCH_TICK_MS);
+	CHECK(before >= 81);	// Not before lcd_init returns
+}
+
+int main(void)
+{
+	make_script();
+	RUN(test_boot_to_first_scan);
+	RUN(test_baseline);
+	RUN(test_slow_i2c);
+	RUN(test_output_first);
+	return test_summary("latency");
+}
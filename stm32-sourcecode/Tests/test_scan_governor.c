@@ -0,0 +1,229 @@
+/*
+ * test_scan_governor.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: Day-trace simulation of the keypad scan-rate governor
+ * (keypadScanTicks in input_reading.c). button_reading runs every 10 ms
+ * tick through a typical day of FSM states and key presses; Keypad_Scan is
+ * replaced by the trace, so every call is one scan. Prints the scans per
+ * state against a fixed 100 Hz scan and checks that no press is lost where
+ * keys are read. Standby (keypad_wake.c) is left out: it stops the
+ * LOCKED_SLEEP scans altogether after a second.
+ */
+#include "input_reading.h"
+#include "keypad.h"
+#include "scheduler.h"
+#include "timebase.h"
+#include "global.h"
+#include "test.h"
+#include <stdlib.h>
+
+#define HOUR_MS			3600000u
+#define KEY_EVERY_MS	400		// Typing: one key every 400 ms ...
+#define KEY_HOLD_MS		120		// ... held 120 ms
+#define PRESS_LATENCY_MS	30	// Press to debounced, where keys are read
+
+Keypad_HandleTypeDef hKeypad;
+SystemState_t gSystemState;
+
+static uint16_t traceKeys;			// Keys held down now
+static uint32_t scans[LOCKED_RELOCK + 1];
+static uint32_t ticks[LOCKED_RELOCK + 1];
+
+static uint32_t pressed, lost, worstLatency;
+
+uint16_t Keypad_Scan(Keypad_HandleTypeDef* KEYPAD)
+{
+	scans[gSystemState.currentState]++;
+	return traceKeys;
+}
+
+static const char *const stateNames[LOCKED_RELOCK + 1] = {
+	[LOCKED_SLEEP] = "LOCKED_SLEEP", [LOCKED_WAKEUP] = "LOCKED_WAKEUP",
+	[BATTERY_WARNING] = "BATTERY_WARNING", [LOCKED_ENTRY] = "LOCKED_ENTRY",
+	[LOCKED_VERIFY] = "LOCKED_VERIFY", [PENALTY_TIMER] = "PENALTY_TIMER",
+	[PERMANENT_LOCKOUT] = "PERMANENT_LOCKOUT", [UNLOCKED_WAITOPEN] = "UNLOCKED_WAITOPEN",
+	[UNLOCKED_SETPASSWORD] = "UNLOCKED_SETPASSWORD", [UNLOCKED_DOOROPEN] = "UNLOCKED_DOOROPEN",
+	[ALARM_FORGOTCLOSE] = "ALARM_FORGOTCLOSE", [UNLOCKED_WAITCLOSE] = "UNLOCKED_WAITCLOSE",
+	[UNLOCKED_ALWAYSOPEN] = "UNLOCKED_ALWAYSOPEN", [LOCKED_RELOCK] = "LOCKED_RELOCK",
+};
+
+/* States whose keys the FSM uses: every press there must come through */
+static int keys_read(uint8_t state)
+{
+	return state == LOCKED_SLEEP || state == LOCKED_ENTRY || state == UNLOCKED_SETPASSWORD;
+}
+
+/* 'ms' in 'state', typing for 'typingMs' from a random start in the first
+ * 300 ms. The TIM2 tick, then the button_reading slot of the pipeline.
+ */
+static void run(uint8_t state, uint32_t ms, uint32_t typingMs)
+{
+	uint32_t start = 200 + (uint32_t)(rand() % 10) * SCH_TICK_MS;
+	uint32_t downMs = 0;
+	uint8_t waiting = 0;
+
+	gSystemState.currentState = state;
+	for (uint32_t t = 0; t < ms; t += SCH_TICK_MS)
+	{
+		Timebase_Advance(SCH_TICK_MS);
+		uint8_t down = t >= start && t < start + typingMs && (t - start) % KEY_EVERY_MS < KEY_HOLD_MS;
+		if (down && traceKeys == 0)
+		{
+			pressed++;
+			downMs = HAL_GetTick();
+			waiting = keys_read(state);
+		}
+		// Released before it was debounced
+		if (!down && waiting)
+		{
+			lost++;
+			waiting = 0;
+		}
+		traceKeys = down ? KEYPAD_KEY_BIT(1, 2) : 0;
+
+		button_reading();
+		ticks[state]++;
+		if (waiting && keypad_keys_debounced() != 0)
+		{
+			uint32_t latency = HAL_GetTick() - downMs;
+			if (latency > worstLatency) worstLatency = latency;
+			waiting = 0;
+		}
+	}
+}
+
+static void unlock_cycle(void)
+{
+	run(LOCKED_SLEEP, 400, KEY_HOLD_MS);	// Wake-up key
+	run(LOCKED_WAKEUP, 1000, 0);
+	run(LOCKED_ENTRY, 3000, 2000);
+	run(LOCKED_VERIFY, 100, 0);
+	run(UNLOCKED_WAITOPEN, 2000, 0);
+	run(UNLOCKED_DOOROPEN, 8000, 0);
+	run(UNLOCKED_WAITCLOSE, 4000, 0);
+	run(LOCKED_RELOCK, 3000, 0);
+}
+
+/* 24 h: two unlocks an hour from 7:00 to 22:00, a new password and two
+ * hours held open at noon, three wrong passwords in the evening, most of an hour
+ * of lockout at night with someone trying keys. Asleep the rest of the time.
+ */
+static void run_day(void)
+{
+	for (int h = 0; h < 24; )
+	{
+		uint32_t hourStart = HAL_GetTick();
+		uint32_t hours = (h == 12) ? 3 : 1;
+
+		if (h >= 7 && h < 22)
+		{
+			unlock_cycle();
+			unlock_cycle();
+		}
+		if (h == 12)
+		{
+			run(UNLOCKED_SETPASSWORD, 15000, 8000);
+			run(UNLOCKED_ALWAYSOPEN, 2 * HOUR_MS, 3000);
+			run(LOCKED_RELOCK, 3000, 0);
+		}
+		if (h == 20)
+		{
+			run(LOCKED_SLEEP, 400, KEY_HOLD_MS);
+			run(LOCKED_ENTRY, 3000, 2000);
+			run(PENALTY_TIMER, 30000, 6000);
+			run(LOCKED_ENTRY, 3000, 2000);
+			run(UNLOCKED_WAITOPEN, 2000, 0);
+			run(LOCKED_RELOCK, 3000, 0);
+		}
+		if (h == 3)
+		{
+			run(PERMANENT_LOCKOUT, HOUR_MS - 60000, 10000);
+			run(LOCKED_RELOCK, 3000, 0);
+		}
+		uint32_t spent = HAL_GetTick() - hourStart;
+		if (spent < hours * HOUR_MS) run(LOCKED_SLEEP, hours * HOUR_MS - spent, 0);
+		h += hours;
+	}
+}
+
+static void test_day_trace(void)
+{
+	uint32_t total = 0, totalTicks = 0;
+
+	input_reading_init();
+	srand(1);
+	run_day();
+
+	printf("\n%-22s %9s %9s %6s\n", "state", "ticks", "scans", "rate");
+	for (int s = 0; s <= LOCKED_RELOCK; s++)
+	{
+		if (ticks[s] == 0) continue;
+		printf("%-22s %9u %9u %5.0f%%\n", stateNames[s], ticks[s], scans[s], 100.0 * scans[s] / ticks[s]);
+		total += scans[s];
+		totalTicks += ticks[s];
+	}
+	printf("%-22s %9u %9u %5.0f%%\n", "day", totalTicks, total, 100.0 * total / totalTicks);
+	printf("%u presses, %u lost where keys are read, worst latency %u ms\n",
+		   pressed, lost, worstLatency);
+
+	// Every tick where keys are typed or wait for later
+	CHECK_EQ(scans[LOCKED_ENTRY], ticks[LOCKED_ENTRY]);
+	CHECK_EQ(scans[UNLOCKED_SETPASSWORD], ticks[UNLOCKED_SETPASSWORD]);
+	CHECK_EQ(scans[LOCKED_WAKEUP], ticks[LOCKED_WAKEUP]);
+	// Never where keys are ignored, nothing was held on entry
+	CHECK_EQ(scans[PERMANENT_LOCKOUT], 0);
+	CHECK_EQ(scans[UNLOCKED_ALWAYSOPEN], 0);
+	// Every other tick asleep, a little more around the wake-up keys
+	CHECK(scans[LOCKED_SLEEP] < ticks[LOCKED_SLEEP] / 2 + ticks[LOCKED_SLEEP] / 100);
+	CHECK(scans[PENALTY_TIMER] < ticks[PENALTY_TIMER] / 2);
+	CHECK_EQ(totalTicks, 24 * HOUR_MS / SCH_TICK_MS);
+	CHECK(total < totalTicks / 2);
+
+	// Ramp-up: the first press in LOCKED_SLEEP is as fast as at full rate
+	CHECK(pressed > 100);
+	CHECK_EQ(lost, 0);
+	CHECK(worstLatency <= PRESS_LATENCY_MS);
+}
+
+/* A key still held when a state that ignores keys is entered is followed
+ * to its release, then scanning stops
+ */
+static void test_held_on_entry(void)
+{
+	input_reading_init();
+	traceKeys = 0;
+	run(LOCKED_ENTRY, 1000, 0);
+	traceKeys = KEYPAD_KEY_BIT(0, 0);
+	button_reading();
+	button_reading();
+	CHECK(keypad_keys_debounced() != 0);
+
+	gSystemState.currentState = UNLOCKED_ALWAYSOPEN;
+	uint32_t before = scans[UNLOCKED_ALWAYSOPEN];
+	for (int t = 0; t < 100; t++) button_reading();
+	CHECK_EQ(scans[UNLOCKED_ALWAYSOPEN] - before, 100);
+
+	traceKeys = 0;
+	for (int t = 0; t < 100; t++) button_reading();
+	CHECK_EQ(keypad_keys_debounced(), 0);
+	CHECK(scans[UNLOCKED_ALWAYSOPEN] - before <= 100 + 3);
+
+	// Pressed after entry: ignored, not scanned
+	before = scans[UNLOCKED_ALWAYSOPEN];
+	traceKeys = KEYPAD_KEY_BIT(2, 1);
+	for (int t = 0; t < 100; t++) button_reading();
+	CHECK_EQ(scans[UNLOCKED_ALWAYSOPEN], before);
+	CHECK_EQ(keypad_keys_debounced(), 0);
+	traceKeys = 0;
+}
+
+int main(void)
+{
+	GPIOB->IDR = ENTER_Pin | BACKSPACE_Pin;		// Buttons released (pull-ups)
+	GPIOC->IDR = DOOR_SENSOR_Pin | KEY_SENSOR_Pin | BUTTON_Pin;
+	RUN(test_day_trace);
+	RUN(test_held_on_entry);
+	return test_summary("scan governor");
+}
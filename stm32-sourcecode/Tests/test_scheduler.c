@@ -0,0 +1,460 @@
+/*
+ * test_scheduler.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: Host tests of scheduler.c, built once per backend
+ * (SCH_BACKEND) with dynamic tasks only (SCH_STATIC_TASKS = 0).
+ */
+#include "scheduler.h"
+#include "test.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+
+/* Runs every pass until nothing is left to run for the posted ticks */
+static void dispatch_all(void)
+{
+	for (int i = 0; i < 64 && SCH_Idle_Ticks() == 0; i++)
+		SCH_Dispatch_Tasks();
+}
+
+static void tick(uint32_t ticks)
+{
+	SCH_Update_Ticks(ticks);
+	dispatch_all();
+}
+
+// --- Periodic and one-shot timing ---
+
+#define LOG_MAX		64
+
+static uint32_t runTick[4][LOG_MAX];
+static int runs[4];
+
+static void log_run(int task)
+{
+	if (runs[task] < LOG_MAX) runTick[task][runs[task]] = SCH_Get_Ticks();
+	runs[task]++;
+}
+
+static void task0(void) { log_run(0); }
+static void task1(void) { log_run(1); }
+static void task2(void) { log_run(2); }
+static void task3(void) { log_run(3); }
+
+static void reset_log(void)
+{
+	for (int i = 0; i < 4; i++) runs[i] = 0;
+}
+
+/* First run on tick DELAY + 1, then every PERIOD ticks; one-shots run once */
+static void test_periodic_timing(void)
+{
+	SCH_Init();
+	reset_log();
+	uint32_t start = SCH_Get_Ticks();
+	SCH_Add_Task(task0, 0, 1);
+	SCH_Add_Task(task1, 4, 10);
+	SCH_Add_Task(task2, 7, 0);
+
+	for (int t = 0; t < 40; t++) tick(1);
+
+	CHECK_EQ(runs[0], 40);
+	CHECK_EQ(runs[1], 4);
+	for (int k = 0; k < 4; k++) CHECK_EQ(runTick[1][k] - start, 5 + 10 * k);
+	CHECK_EQ(runs[2], 1);
+	CHECK_EQ(runTick[2][0] - start, 8);
+	CHECK_EQ(SCH_task_count, 2); // The one-shot deleted itself
+}
+
+// --- Handles ---
+
+static void test_stale_handles(void)
+{
+	SCH_Init();
+	uint32_t a = SCH_Add_Task(task0, 5, 0);
+	CHECK(a != NO_TASK_ID);
+	CHECK_EQ(SCH_Delete_Task(a), RETURN_NORMAL);
+	CHECK_EQ(SCH_Delete_Task(a), RETURN_ERROR);
+
+	// The slot comes back with a new generation, the old handle stays dead
+	uint32_t b = SCH_Add_Task(task0, 5, 0);
+	CHECK_EQ(SCH_HANDLE_SLOT(b), SCH_HANDLE_SLOT(a));
+	CHECK(b != a);
+	CHECK_EQ(SCH_Delete_Task(a), RETURN_ERROR);
+	CHECK_EQ(SCH_Reschedule_Task(a, 1), RETURN_ERROR);
+	CHECK_EQ(SCH_Delete_Task(b), RETURN_NORMAL);
+
+	// Pool exhaustion and release
+	uint32_t ids[SCH_MAX_TASKS];
+	for (int i = 0; i < SCH_MAX_TASKS; i++) ids[i] = SCH_Add_Task(task0, 100, 0);
+	for (int i = 0; i < SCH_MAX_TASKS; i++) CHECK(ids[i] != NO_TASK_ID);
+	CHECK_EQ(SCH_Add_Task(task0, 100, 0), NO_TASK_ID);
+	for (int i = 0; i < SCH_MAX_TASKS; i++) CHECK_EQ(SCH_Delete_Task(ids[i]), RETURN_NORMAL);
+	CHECK_EQ(SCH_task_count, 0);
+}
+
+// --- Priorities and batch dispatch ---
+
+static int order[8];
+static int orderLen;
+
+static void prio_a(void) { if (orderLen < 8) order[orderLen++] = 0; }
+static void prio_b(void) { if (orderLen < 8) order[orderLen++] = 1; }
+static void prio_c(void) { if (orderLen < 8) order[orderLen++] = 2; }
+
+static void test_priority_order(void)
+{
+	SCH_Init();
+	orderLen = 0;
+	SCH_Add_Task_Priority(prio_c, 0, 1, 3);
+	SCH_Add_Task_Priority(prio_a, 0, 1, 0);
+	SCH_Add_Task_Priority(prio_b, 0, 1, 1);
+
+	SCH_Update();
+	SCH_Dispatch_Tasks();
+#if SCH_BATCH_DISPATCH
+	CHECK_EQ(orderLen, 3); // One pass runs every ready task
+#else
+	dispatch_all();
+	CHECK_EQ(orderLen, 3);
+#endif
+	CHECK_EQ(order[0], 0);
+	CHECK_EQ(order[1], 1);
+	CHECK_EQ(order[2], 2);
+}
+
+/* Ticks posted while the main loop was busy: every run is made up */
+static void test_catch_up(void)
+{
+	SCH_Init();
+	reset_log();
+	SCH_Add_Task(task0, 0, 1);
+	SCH_Add_Task(task1, 0, 2);
+	tick(9);
+	CHECK_EQ(runs[0], 9);
+	CHECK_EQ(runs[1], 5);
+}
+
+// --- Deleting a task queued for another run in the same pass ---
+
+static uint32_t victim;
+static uint32_t deleterId;
+
+static void victim_task(void) { log_run(0); }
+
+static void deleter_task(void)
+{
+	if (victim != NO_TASK_ID) SCH_Delete_Task(victim);
+	victim = NO_TASK_ID;
+	SCH_Delete_Task(deleterId);
+}
+
+/* The victim is behind by several runs, so it is held for a re-push at the
+ * end of the pass when a lower priority task deletes it. The slot must be
+ * freed once: a double free shows up as a free list handing out the same
+ * slot twice.
+ */
+static void test_delete_while_requeued(void)
+{
+	SCH_Init();
+	reset_log();
+	victim = SCH_Add_Task_Priority(victim_task, 0, 1, 0);
+	deleterId = SCH_Add_Task_Priority(deleter_task, 2, 0, 1);
+	tick(3);
+	CHECK_EQ(runs[0], 1 + 2 * !SCH_BATCH_DISPATCH);
+	CHECK_EQ(SCH_task_count, 0);
+	tick(3);
+
+	uint32_t ids[SCH_MAX_TASKS];
+	int added = 0;
+	while (added < SCH_MAX_TASKS + 1)
+	{
+		uint32_t id = SCH_Add_Task(task1, 50, 0);
+		if (id == NO_TASK_ID) break;
+		ids[added++] = id;
+	}
+	CHECK_EQ(added, SCH_MAX_TASKS);
+	for (int i = 0; i < added; i++)
+		for (int j = i + 1; j < added; j++)
+			CHECK(SCH_HANDLE_SLOT(ids[i]) != SCH_HANDLE_SLOT(ids[j]));
+	tick(60);
+	CHECK_EQ(SCH_task_count, 0);
+}
+
+// --- Event tasks ---
+
+static void test_event_tasks(void)
+{
+	SCH_Init();
+	reset_log();
+	SCH_Add_Event_Task(task0, 3, 0);
+	SCH_Add_Event_Task(task1, 3, 1);
+	SCH_Add_Event_Task(task2, 9, 0);
+
+	tick(50);
+	CHECK_EQ(runs[0] + runs[1] + runs[2], 0); // Never run by time
+	CHECK_EQ(SCH_Idle_Ticks(), SCH_IDLE_FOREVER);
+
+	// Raised twice before the pass: one run of each task on the bit
+	SCH_Signal(1u << 3);
+	SCH_Signal(1u << 3);
+	CHECK_EQ(SCH_Idle_Ticks(), 0);
+	dispatch_all();
+	CHECK_EQ(runs[0], 1);
+	CHECK_EQ(runs[1], 1);
+	CHECK_EQ(runs[2], 0);
+
+	SCH_Signal((1u << 3) | (1u << 9));
+	dispatch_all();
+	CHECK_EQ(runs[0], 2);
+	CHECK_EQ(runs[2], 1);
+
+	// Standby freezes time-driven tasks only
+	SCH_Add_Task(task3, 0, 1);
+	SCH_Standby(1);
+	tick(20);
+	CHECK_EQ(runs[3], 0);
+	SCH_Signal(1u << 9);
+	dispatch_all();
+	CHECK_EQ(runs[2], 2);
+	SCH_Standby(0);
+	tick(1);
+	CHECK_EQ(runs[3], 1);
+}
+
+// --- Dispatches per simulated hour: polled vs event tasks ---
+
+#define HOUR_TICKS		360000u	// 10 ms ticks
+#define HOUR_EDGES		40		// Key, button and door edges in the hour
+#define SIG_INPUT		4		// EXTI edge
+#define SIG_FSM			5		// Input task posted an event
+
+static uint8_t eventConfig;
+static uint32_t edgesPending, fsmPending;
+static uint32_t inputRuns, fsmRuns, fsmEvents;
+
+/* Input_Process / State_Process stand-ins: work only when something is
+ * pending, like the real ones on an unchanged tick
+ */
+static void input_task(void)
+{
+	inputRuns++;
+	if (edgesPending == 0) return;
+	edgesPending = 0;
+	fsmPending = 1;
+	if (eventConfig) SCH_Signal(1u << SIG_FSM);
+}
+
+static void fsm_task(void)
+{
+	fsmRuns++;
+	if (fsmPending == 0) return;
+	fsmPending = 0;
+	fsmEvents++;
+}
+
+/* One hour with the same edges through the tickless main loop: dispatch
+ * while there is work, then sleep to the next due tick (TIM2 span at
+ * most) or the next edge. Returns the wake-ups.
+ */
+static uint32_t run_hour(uint8_t events, const uint32_t *edgeTick)
+{
+	uint32_t wakes = 0, now = 0;
+	int e = 0;
+
+	SCH_Init();
+	eventConfig = events;
+	edgesPending = fsmPending = 0;
+	inputRuns = fsmRuns = fsmEvents = 0;
+	if (events)
+	{
+		SCH_Add_Event_Task(input_task, SIG_INPUT, 0);
+		SCH_Add_Event_Task(fsm_task, SIG_FSM, 1);
+	}
+	else
+	{
+		SCH_Add_Task_Priority(input_task, 0, 1, 0);
+		SCH_Add_Task_Priority(fsm_task, 0, 1, 1);
+	}
+	for (;;)
+	{
+		uint32_t idle = SCH_Idle_Ticks();
+		if (idle == 0)
+		{
+			SCH_Dispatch_Tasks();
+			continue;
+		}
+		if (now == HOUR_TICKS) break;
+		if (idle > 6553) idle = 6553; // 16-bit TIM2 span
+		uint32_t wake = now + idle;
+		if (e < HOUR_EDGES && edgeTick[e] < wake) wake = edgeTick[e];
+		if (wake > HOUR_TICKS) wake = HOUR_TICKS;
+		SCH_Update_Ticks(wake - now);
+		now = wake;
+		wakes++;
+		if (e < HOUR_EDGES && edgeTick[e] == now)
+		{
+			e++;
+			edgesPending++;
+			if (events) SCH_Signal(1u << SIG_INPUT);	// EXTI callback
+		}
+	}
+	return wakes;
+}
+
+static int cmp_tick(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+	return (x > y) - (x < y);
+}
+
+static void test_dispatch_per_hour(void)
+{
+	uint32_t edgeTick[HOUR_EDGES];
+	uint32_t wakes[2], input[2], fsm[2], handled[2];
+
+	srand(8);
+	for (int i = 0; i < HOUR_EDGES; i++)
+	{
+		edgeTick[i] = 1 + (uint32_t)rand() % (HOUR_TICKS - 1);
+		for (int j = 0; j < i; j++)
+			if (edgeTick[j] == edgeTick[i]) edgeTick[i--] = HOUR_TICKS;	// Draw again
+	}
+	qsort(edgeTick, HOUR_EDGES, sizeof edgeTick[0], cmp_tick);
+
+	for (int c = 0; c < 2; c++)
+	{
+		wakes[c] = run_hour((uint8_t)c, edgeTick);
+		input[c] = inputRuns;
+		fsm[c] = fsmRuns;
+		handled[c] = fsmEvents;
+	}
+	printf("\n  %-10s %10s %10s %10s\n", "per hour", "input", "fsm", "wakes");
+	printf("  %-10s %10u %10u %10u\n", "periodic", input[0], fsm[0], wakes[0]);
+	printf("  %-10s %10u %10u %10u\n", "event", input[1], fsm[1], wakes[1]);
+
+	// Every edge reaches the FSM in both, one run each instead of every tick
+	CHECK_EQ(handled[0], HOUR_EDGES);
+	CHECK_EQ(handled[1], HOUR_EDGES);
+	CHECK_EQ(input[0], HOUR_TICKS);
+	CHECK_EQ(fsm[0], HOUR_TICKS);
+	CHECK_EQ(wakes[0], HOUR_TICKS);
+	CHECK_EQ(input[1], HOUR_EDGES);
+	CHECK_EQ(fsm[1], HOUR_EDGES);
+	// Woken by the edges and the end of each TIM2 span only
+	CHECK(wakes[1] <= HOUR_EDGES + HOUR_TICKS / 6553 + 2);
+}
+
+// --- Tickless idle: sleeping SCH_Idle_Ticks is never late ---
+
+#define TL_TASKS	12
+
+static uint32_t tlDue[TL_TASKS];
+static uint32_t tlPeriod[TL_TASKS];
+static int tlLate;
+static int tlRuns;
+
+#define TL_TASK(n) static void tl##n(void) { \
+		if (SCH_Get_Ticks() != tlDue[n]) tlLate++; \
+		tlDue[n] += tlPeriod[n]; \
+		tlRuns++; \
+	}
+TL_TASK(0) TL_TASK(1) TL_TASK(2) TL_TASK(3) TL_TASK(4) TL_TASK(5)
+TL_TASK(6) TL_TASK(7) TL_TASK(8) TL_TASK(9) TL_TASK(10) TL_TASK(11)
+
+static void (*const tlTask[TL_TASKS])(void) = {
+	tl0, tl1, tl2, tl3, tl4, tl5, tl6, tl7, tl8, tl9, tl10, tl11
+};
+
+/* Simulated clock: the idle loop posts exactly the ticks it slept, like the
+ * stretched TIM2 period; sometimes it wakes early on another interrupt.
+ */
+static void test_tickless_never_late(void)
+{
+	SCH_Init();
+	srand(4);
+	tlLate = 0;
+	tlRuns = 0;
+	uint32_t now = SCH_Get_Ticks();
+	for (int i = 0; i < TL_TASKS; i++)
+	{
+		uint32_t delay = (uint32_t)(rand() % 300);
+		tlPeriod[i] = 1 + (uint32_t)(rand() % 500);
+		tlDue[i] = now + delay + 1;
+		SCH_Add_Task(tlTask[i], delay, tlPeriod[i]);
+	}
+
+	long slept = 0;
+	while (SCH_Get_Ticks() - now < 200000)
+	{
+		uint32_t idle = SCH_Idle_Ticks();
+		if (idle == 0)
+		{
+			SCH_Dispatch_Tasks();
+			continue;
+		}
+		if (idle > 6553) idle = 6553; // 16-bit TIM2 span
+		if (rand() % 4 == 0) idle = 1 + (uint32_t)rand() % idle; // Early wake
+		SCH_Update_Ticks(idle);
+		slept++;
+	}
+	CHECK_EQ(tlLate, 0);
+	CHECK(tlRuns > 4000);
+	CHECK(slept < 200000 / 2); // Far fewer wakes than ticks
+}
+
+// --- ISR / main loop hand-off from another thread ---
+
+#define ISR_TICKS	200000
+
+static volatile int isrDone;
+static uint32_t isrRuns;
+static uint32_t isrBase;
+
+static void count_task(void) { isrRuns++; }
+
+static void *tick_isr(void *arg)
+{
+	(void)arg;
+	for (uint32_t i = 0; i < ISR_TICKS; i++)
+	{
+		// A real tick is 10 ms: stay within RunMe range of the main loop
+		while (isrBase + i - SCH_Get_Ticks() > 100) sched_yield();
+		SCH_Update();
+	}
+	isrDone = 1;
+	return NULL;
+}
+
+static void test_threaded_ticks(void)
+{
+	pthread_t isr;
+
+	SCH_Init();
+	isrRuns = 0;
+	isrDone = 0;
+	isrBase = SCH_Get_Ticks();
+	SCH_Add_Task(count_task, 0, 1);
+	pthread_create(&isr, NULL, tick_isr, NULL);
+	while (!isrDone) SCH_Dispatch_Tasks();
+	pthread_join(isr, NULL);
+	while (SCH_Idle_Ticks() == 0) SCH_Dispatch_Tasks();
+	CHECK_EQ(isrRuns, ISR_TICKS); // No tick lost or counted twice
+}
+
+int main(void)
+{
+	RUN(test_periodic_timing);
+	RUN(test_stale_handles);
+	RUN(test_priority_order);
+	RUN(test_catch_up);
+	RUN(test_delete_while_requeued);
+	RUN(test_event_tasks);
+	RUN(test_dispatch_per_hour);
+	RUN(test_tickless_never_late);
+	RUN(test_threaded_ticks);
+	return test_summary(SCH_BACKEND == SCH_BACKEND_TIMING_WHEEL ?
+						"scheduler (timing wheel)" : "scheduler (delta list)");
+}
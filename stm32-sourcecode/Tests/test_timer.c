@@ -0,0 +1,201 @@
+/*
+ * test_timer.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: Host tests of the soft timer service (timer.c) against a
+ * tick-by-tick reference model.
+ */
+#include "timer.h"
+#include "scheduler.h"
+#include "test.h"
+#include <stdlib.h>
+
+int TIMER_CYCLE = 10; // global.c
+
+static uint32_t signalsPosted;
+
+void SCH_Signal(uint32_t SIGNALS)
+{
+	signalsPosted |= SIGNALS;
+}
+
+static int fired[MAX_SOFT_TIMERS];
+
+#define CB(n) static void cb##n(void) { fired[n]++; }
+CB(0) CB(1) CB(2) CB(3) CB(4) CB(5) CB(6) CB(7)
+
+static void (*const callbacks[MAX_SOFT_TIMERS])(void) = { cb0, cb1, cb2, cb3, cb4, cb5, cb6, cb7 };
+
+static int ids[MAX_SOFT_TIMERS];
+
+static void create_all(void)
+{
+	for (int i = 0; i < MAX_SOFT_TIMERS; i++)
+	{
+		if (ids[i] != TIMER_NONE) timerDelete(ids[i]);
+		ids[i] = timerCreate(callbacks[i], 1u << i);
+		fired[i] = 0;
+	}
+}
+
+// --- Pool ---
+
+static void test_pool(void)
+{
+	for (int i = 0; i < MAX_SOFT_TIMERS; i++) ids[i] = TIMER_NONE;
+	create_all();
+	for (int i = 0; i < MAX_SOFT_TIMERS; i++) CHECK_EQ(ids[i], i);
+	CHECK_EQ(timerCreate(NULL, 0), TIMER_NONE);
+
+	timerDelete(ids[3]);
+	CHECK(!timerRunning(ids[3]));
+	setTimer(ids[3], 100); // Deleted: ignored
+	CHECK(!timerRunning(ids[3]));
+	ids[3] = timerCreate(cb3, 1u << 3);
+	CHECK_EQ(ids[3], 3);
+	CHECK(!timerExpired(ids[3]));
+
+	// Invalid ids are ignored everywhere
+	setTimer(TIMER_NONE, 100);
+	setTimer(MAX_SOFT_TIMERS, 100);
+	CHECK(!timerRunning(TIMER_NONE));
+	CHECK(!timerConsume(MAX_SOFT_TIMERS));
+}
+
+// --- One-shot, periodic, consume ---
+
+static void test_basic(void)
+{
+	create_all();
+	signalsPosted = 0;
+
+	setTimer(ids[0], 30); // 3 ticks
+	timerAdvance(2);
+	CHECK(timerRunning(ids[0]));
+	CHECK(!timerExpired(ids[0]));
+	CHECK_EQ(timerNextDue(), 1);
+	timerAdvance(1);
+	CHECK(!timerRunning(ids[0]));
+	CHECK(timerExpired(ids[0]));
+	CHECK_EQ(fired[0], 1);
+	CHECK_EQ(signalsPosted, 1u << 0);
+	CHECK(timerConsume(ids[0]));
+	CHECK(!timerConsume(ids[0])); // Once per expiry
+	CHECK(!timerExpired(ids[0]));
+
+	// Zero duration: expired at once, never linked
+	setTimer(ids[1], 0);
+	CHECK(timerExpired(ids[1]));
+	CHECK(!timerRunning(ids[1]));
+
+	// Restart and stop clear a pending expiry
+	setTimer(ids[1], 50);
+	CHECK(!timerExpired(ids[1]));
+	stopTimer(ids[1]);
+	timerAdvance(10);
+	CHECK_EQ(fired[1], 0);
+
+	// Periodic: 4 expiries in 8 ticks, one advance of the whole span
+	setTimerPeriodic(ids[2], 20);
+	timerAdvance(8);
+	CHECK_EQ(fired[2], 4);
+	CHECK(timerRunning(ids[2]));
+	CHECK(timerConsume(ids[2])); // The bit merges expiries not yet consumed
+	CHECK(!timerConsume(ids[2]));
+	stopTimer(ids[2]);
+	CHECK_EQ(timerNextDue(), SCH_IDLE_FOREVER);
+}
+
+// --- Random operations against a reference model ---
+
+typedef struct {
+	uint32_t due;		// Absolute tick, 0 = not running
+	uint32_t period;
+	int expired;
+	int fired;
+} ModelTimer_t;
+
+static void test_model(void)
+{
+	ModelTimer_t model[MAX_SOFT_TIMERS] = { 0 };
+	uint32_t now = 1000;
+	long checks = 0;
+
+	create_all();
+	srand(11);
+	for (int step = 0; step < 200000; step++)
+	{
+		int i = rand() % MAX_SOFT_TIMERS;
+		int op = rand() % 16;
+
+		if (op < 3)
+		{
+			uint32_t ticks = (uint32_t)(rand() % (op == 0 ? 5 : 400));
+			setTimer(ids[i], (int)(ticks * TIMER_CYCLE + rand() % TIMER_CYCLE));
+			model[i].period = 0;
+			model[i].due = ticks ? now + ticks : 0;
+			model[i].expired = (ticks == 0);
+		}
+		else if (op == 3)
+		{
+			uint32_t ticks = 1 + (uint32_t)(rand() % 50);
+			setTimerPeriodic(ids[i], (int)(ticks * TIMER_CYCLE));
+			model[i].period = ticks;
+			model[i].due = now + ticks;
+			model[i].expired = 0;
+		}
+		else if (op == 4)
+		{
+			stopTimer(ids[i]);
+			model[i].due = 0;
+			model[i].expired = 0;
+		}
+		else if (op == 5)
+		{
+			CHECK_EQ(timerConsume(ids[i]), model[i].expired);
+			model[i].expired = 0;
+		}
+
+		// Next due as reported for tickless idle
+		uint32_t next = SCH_IDLE_FOREVER;
+		for (int j = 0; j < MAX_SOFT_TIMERS; j++)
+			if (model[j].due && model[j].due - now < next) next = model[j].due - now;
+		CHECK_EQ(timerNextDue(), next);
+
+		uint32_t span = (rand() % 4 == 0) ? 1 + (uint32_t)(rand() % 300) : 1;
+		timerAdvance((int)span);
+		for (uint32_t k = 0; k < span; k++)
+		{
+			now++;
+			for (int j = 0; j < MAX_SOFT_TIMERS; j++)
+			{
+				if (model[j].due != now) continue;
+				model[j].expired = 1;
+				model[j].fired++;
+				model[j].due = model[j].period ? now + model[j].period : 0;
+			}
+		}
+		for (int j = 0; j < MAX_SOFT_TIMERS; j++)
+		{
+			if (timerRunning(ids[j]) != (model[j].due != 0) ||
+				timerExpired(ids[j]) != model[j].expired ||
+				fired[j] != model[j].fired)
+			{
+				CHECK(0);
+				printf("  step %d timer %d\n", step, j);
+				return;
+			}
+			checks++;
+		}
+	}
+	CHECK(checks > 0);
+}
+
+int main(void)
+{
+	RUN(test_pool);
+	RUN(test_basic);
+	RUN(test_model);
+	return test_summary("timer");
+}
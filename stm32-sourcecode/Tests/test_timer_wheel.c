@@ -0,0 +1,217 @@
+/*
+ * test_timer_wheel.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: nguye
+ * Description: Host tests of the hierarchical timing wheel (timer_wheel.c):
+ * random deadlines from ticks to hours against a reference model, advanced
+ * tick by tick or in one jump, and fast-forwarded multi-hour lockouts.
+ */
+#include "timer_wheel.h"
+#include "scheduler.h"
+#include "test.h"
+#include <stdlib.h>
+
+static uint32_t signalsPosted;
+
+void SCH_Signal(uint32_t SIGNALS)
+{
+	signalsPosted |= SIGNALS;
+}
+
+static int fired[TW_MAX_TIMERS];
+
+static void cb0(void) { fired[0]++; }
+static void cb1(void) { fired[1]++; }
+static void cb2(void) { fired[2]++; }
+static void cb3(void) { fired[3]++; }
+
+static void (*const callbacks[TW_MAX_TIMERS])(void) = { cb0, cb1, cb2, cb3 };
+
+static int ids[TW_MAX_TIMERS];
+
+static void test_create(void)
+{
+	for (int i = 0; i < TW_MAX_TIMERS; i++)
+	{
+		ids[i] = TW_Create(callbacks[i], 1u << i);
+		CHECK_EQ(ids[i], i);
+	}
+	CHECK_EQ(TW_Create(NULL, 0), TW_NONE);
+	CHECK_EQ(TW_Next_Due(), SCH_IDLE_FOREVER);
+}
+
+/* 125 min penalty: fires on its tick, fast-forwarded as tickless idle would */
+static void test_long_penalty(void)
+{
+	uint32_t ms = 125u * 60000;
+	uint32_t ticks = 0;
+	uint32_t wakes = 0;
+
+	signalsPosted = 0;
+	fired[0] = 0;
+	TW_Start(ids[0], ms);
+	CHECK(TW_Running(ids[0]));
+
+	// Tickless: jump by TW_Next_Due, capped at the 16-bit TIM2 span
+	while (!TW_Expired(ids[0]) && ticks < ms)
+	{
+		uint32_t step = TW_Next_Due();
+		if (step > 6553) step = 6553;
+		TW_Advance(step);
+		ticks += step;
+		wakes++;
+	}
+	CHECK_EQ(ticks, ms / SCH_TICK_MS);
+	CHECK_EQ(fired[0], 1);
+	CHECK_EQ(signalsPosted, 1u << 0);
+	CHECK(!TW_Running(ids[0]));
+	CHECK(TW_Consume(ids[0]));
+	CHECK(!TW_Consume(ids[0]));
+	CHECK(wakes <= ms / 1000 + 1); // One wake per second (cascade), not per tick
+	CHECK_EQ(TW_Next_Due(), SCH_IDLE_FOREVER);
+}
+
+/* Deadlines round up to whole ticks, 0 ms expires at once */
+static void test_rounding(void)
+{
+	fired[1] = 0;
+	TW_Start(ids[1], 0);
+	CHECK(TW_Expired(ids[1]));
+	CHECK_EQ(fired[1], 1);
+
+	TW_Start(ids[1], 11); // 2 ticks
+	CHECK(!TW_Expired(ids[1]));
+	TW_Advance(1);
+	CHECK(!TW_Expired(ids[1]));
+	TW_Advance(1);
+	CHECK(TW_Expired(ids[1]));
+
+	// Stop and restart clear the expiry
+	TW_Start(ids[1], 1000);
+	TW_Stop(ids[1]);
+	CHECK(!TW_Running(ids[1]));
+	TW_Advance(200);
+	CHECK(!TW_Expired(ids[1]));
+	CHECK_EQ(fired[1], 2);
+}
+
+/* Long sleeps with nothing armed move the clock without stepping it: the
+ * level digits must still be right for the next timer started
+ */
+static void test_idle_skip(void)
+{
+	srand(3);
+	for (int i = 0; i < TW_MAX_TIMERS; i++) TW_Stop(ids[i]);
+	for (int round = 0; round < 2000; round++)
+	{
+		TW_Advance(1 + (uint32_t)(rand() % 400000));	// Up to ~67 min asleep
+		uint32_t ticks = 1 + (uint32_t)(rand() % 400000);
+		fired[2] = 0;
+		TW_Start(ids[2], ticks * SCH_TICK_MS);
+		uint32_t first = 1 + (uint32_t)rand() % ticks;
+		TW_Advance(first - 1);
+		if (TW_Expired(ids[2]))
+		{
+			CHECK(0);
+			printf("  round %d early\n", round);
+			return;
+		}
+		TW_Advance(ticks - first);
+		TW_Advance(1);
+		if (!TW_Consume(ids[2]) || fired[2] != 1)
+		{
+			CHECK(0);
+			printf("  round %d late\n", round);
+			return;
+		}
+	}
+	CHECK_EQ(TW_Next_Due(), SCH_IDLE_FOREVER);
+}
+
+/* Random starts / stops with deadlines up to 200 min, advanced tick by tick
+ * or in jumps no longer than TW_Next_Due (tickless idle)
+ */
+static void test_model(void)
+{
+	uint64_t now = 0;
+	uint64_t due[TW_MAX_TIMERS] = { 0 };
+	int expired[TW_MAX_TIMERS] = { 0 };
+	long checks = 0;
+
+	for (int i = 0; i < TW_MAX_TIMERS; i++)
+	{
+		TW_Stop(ids[i]);
+		fired[i] = 0;
+	}
+	srand(7);
+	for (int step = 0; step < 300000; step++)
+	{
+		int i = rand() % TW_MAX_TIMERS;
+		if (rand() % 8 == 0)
+		{
+			uint32_t ms;
+			switch (rand() % 4)
+			{
+				case 0:  ms = (uint32_t)(rand() % 2000); break;
+				case 1:  ms = (uint32_t)(rand() % 120000); break;
+				case 2:  ms = (uint32_t)(rand() % (130u * 60000)); break;
+				default: ms = (uint32_t)(rand() % (200u * 60000)); break;
+			}
+			int before = fired[i];
+			TW_Start(ids[i], ms);
+			due[i] = now + (ms + SCH_TICK_MS - 1) / SCH_TICK_MS;
+			expired[i] = (due[i] == now);
+			if (expired[i])
+			{
+				CHECK_EQ(fired[i], before + 1);
+				due[i] = 0;
+			}
+		}
+		if (rand() % 50 == 0)
+		{
+			TW_Stop(ids[i]);
+			due[i] = 0;
+			expired[i] = 0;
+		}
+
+		uint32_t nextDue = TW_Next_Due();
+		uint32_t span = (rand() % 3 == 0) ? 1 + (uint32_t)(rand() % 700) : 1;
+		int jump = rand() % 2;	// One TW_Advance for the whole span (ISR after idle)
+		if (jump) TW_Advance(span);
+		for (uint32_t k = 0; k < span; k++)
+		{
+			if (!jump) TW_Advance(1);
+			now++;
+			for (int j = 0; j < TW_MAX_TIMERS; j++)
+			{
+				if (due[j] == now)
+				{
+					expired[j] = 1;
+					due[j] = 0;
+					// Never due before the reported idle time
+					CHECK(k + 1 >= nextDue);
+				}
+				if (jump && k + 1 < span) continue;	// Only the end of a jump is seen
+				if (TW_Expired(ids[j]) != expired[j] || TW_Running(ids[j]) != (due[j] != 0))
+				{
+					CHECK(0);
+					printf("  tick %llu timer %d\n", (unsigned long long)now, j);
+					return;
+				}
+				checks++;
+			}
+		}
+	}
+	CHECK(checks > 1000000);
+}
+
+int main(void)
+{
+	RUN(test_create);
+	RUN(test_long_penalty);
+	RUN(test_rounding);
+	RUN(test_idle_skip);
+	RUN(test_model);
+	return test_summary("timer wheel");
+}